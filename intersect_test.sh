@@ -8,12 +8,23 @@ then
     exit 1
 fi
 
+# IPv4 lines of hex are shorter than IPv6 ones, and the programs give all of
+# IPv4 first. Sort every side the same way before comparing.
+export LC_ALL=C
+
 # The result to test.
 ./ipar_intersect "$2" < "$1" > test_result.txt
 
 diff \
     <(comm -12 \
-        <(./ipar_read -hex < "$1") \
-        <(./ipar_read -hex < "$2") \
+        <(./ipar_read -hex < "$1" | sort) \
+        <(./ipar_read -hex < "$2" | sort) \
     ) \
-    <(./ipar_expand -hex < test_result.txt)
+    <(./ipar_expand -hex < test_result.txt | sort) || exit 1
+
+# The same with file2 as a binary snapshot, which is used in place
+./ipar_read -binary < "$2" > test_snapshot.bin
+./ipar_intersect test_snapshot.bin < "$1" | cmp -s - test_result.txt
+status=$?
+rm -f test_snapshot.bin
+exit $status
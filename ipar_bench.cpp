@@ -0,0 +1,1348 @@
+// Program ipar_bench
+// ------------------
+// Micro-benchmarks for the ipar_iplist software. Not installed.
+// Each benchmark is selected by its first argument:
+//  * batch N: add N intervals one at a time, and with List::add_batch.
+//    Inputs are random, sorted, and heavily overlapping.
+//  * print N: print a list of N intervals with dashes the old way, using
+//    stringstream and std::endl, with IPAR::Writer, and with IPAR::Writer on
+//    one thread per core. Output stays in memory.
+//  * expand N: write N consecutive addresses in hex the old way, with
+//    std::setw and std::endl, and with Writer::expand.
+//  * storage N: add N random intervals one at a time, look up N addresses,
+//    and subtract N/10 intervals, with each storage policy of NumList. Also
+//    reports heap bytes per interval, and the time to free the list.
+//  * setops N: union, intersection, difference and symmetric difference of
+//    lists of N and N intervals, and of N and N/1000 intervals, one interval
+//    at a time as the programs used to, and with the set operations.
+//  * bitmap N: the same set operations on two lists of N short intervals,
+//    packed densely and scattered sparsely, with List and with IPAR::Bitmap.
+//    Bitmap times are given without and with conversion from and to List.
+//  * lookup N: compile a list of N random intervals into an IPAR::Table, and
+//    look up 10N random addresses with List::upper_bound, with the table one
+//    at a time, and with the table in batches.
+//  * rank N: count the addresses in a list of N intervals by walking it, and
+//    with NumList::cardinality, then time N calls each of count, rank and
+//    select.
+//  * frozen N: look up 10N random addresses in a list of N random intervals
+//    with List::upper_bound, and with NumList::freeze on one thread and on
+//    one thread per core, all sharing the same frozen list.
+//  * concurrent N: one reader per core looks up 10N random addresses in an
+//    IPAR::ConcurrentList of N intervals, first alone and then while a
+//    writer keeps changing the list and publishing new versions. Readers
+//    check that every version they see is whole: each batch of changes
+//    moves a marker interval, and there must be exactly one.
+//  * ipv6 N: the inputs of batch N, added one at a time and with add_batch
+//    to a List and to a List6, then 10N lookups in each list frozen. For
+//    IPv6, each address becomes a /32, so that the lists agree.
+//  * sharded N: the set operations of setops on lists of N and N intervals,
+//    with List and with IPAR::ShardedList of 16 and 256 shards on one thread
+//    per core. Also gives the time to convert both lists, and to print the
+//    result with one thread per core.
+//  * load N: write 8 files of N random intervals each, then load them one
+//    after another, merging each in turn, and with FileCache::read_all on
+//    one thread per core. The files are removed afterwards.
+//  * gaps N: the best extension of each interval of a list of N random
+//    intervals, as ipar_gap_analyzer finds it, with IPAR::ExtensionSearch.
+//    The old way, scoring every candidate, is timed on the first 256
+//    intervals only, and gives the time per interval of each. Then the
+//    search on one thread per core, with IPAR::parallel_ranges.
+//  * top N: the best extensions of a list of N random intervals, as for
+//    gaps, put in report order by sorting them all, and the best 100 with
+//    IPAR::TopGaps. Also gives how many of each are kept in memory.
+//  * prefixes N: the aligned prefixes from /8 to /32 of a list of N random
+//    intervals that are at least half covered, the old way, counting each
+//    prefix that holds part of the list with NumList::count, and with
+//    IPAR::dense_prefixes. The old way leaves in the prefixes inside others.
+//  * parse N: run both range parsers, the SSE one used at run time and the
+//    portable one, on a table of odd inputs, and compare them with what the
+//    old parser made of each. Then compare the two on N random inputs, half
+//    of them malformed, including which exception each throws, and time
+//    both on the inputs that parse.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <malloc.h>
+#include <memory>
+#include <random>
+#include <span>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+using namespace std;
+#include "ipar_iplist.h"
+#include "ipar_bitmap.h"
+#include "ipar_cache.h"
+#include "ipar_concurrent.h"
+#include "ipar_gaps.h"
+#include "ipar_list6.h"
+#include "ipar_sharded.h"
+#include "ipar_table.h"
+#include "ipar_threads.h"
+
+using Interval = pair<uint32_t,uint32_t>;
+using Intervals = vector<Interval>;
+
+// Time one call of a function, in seconds
+template<typename FUNC>
+double timed (FUNC func)
+{
+    auto start = chrono::steady_clock::now();
+    func();
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+// Intervals of up to "span" addresses, scattered over "space" addresses
+Intervals make_intervals (size_t count, uint32_t space, uint32_t span,
+                          mt19937& gen)
+{
+    Intervals result;
+    result.reserve(count);
+    uniform_int_distribution<uint32_t> start_dist(0, space - span);
+    uniform_int_distribution<uint32_t> span_dist(0, span - 1);
+    for (size_t index = 0 ; index < count ; ++index)
+    {
+	uint32_t lower = start_dist(gen);
+	result.push_back(make_pair(lower, lower + span_dist(gen)));
+    }
+    return result;
+}
+
+int bench_batch (size_t count)
+{
+    mt19937 gen(1);
+    Intervals random = make_intervals(count, 0xFFFFFFFF, 64, gen);
+    Intervals sorted = random;
+    sort(sorted.begin(), sorted.end());
+    Intervals overlapping = make_intervals(count, 1 << 24, 256, gen);
+
+    cout << setw(12) << "input" << setw(12) << "add" << setw(12) << "add_batch"
+         << setw(12) << "intervals" << endl;
+    for (auto& input : { make_pair("random", &random),
+                         make_pair("sorted", &sorted),
+                         make_pair("overlapping", &overlapping) })
+    {
+	IPAR::List one, many;
+	double t_one = timed([&]()
+	{
+	    for (auto& pr : *input.second)
+		one.add(IPAR::Range(pr.first, pr.second));
+	});
+	Intervals copy = *input.second;
+	double t_many = timed([&]() { many.add_batch(copy); });
+	if (one.size() != many.size())
+	{
+	    cerr << "ERROR: results differ" << endl;
+	    return 1;
+	}
+	cout << setw(12) << input.first << setw(11) << t_one << 's'
+	     << setw(11) << t_many << 's' << setw(12) << one.size() << endl;
+    }
+    return 0;
+}
+
+// How List::print used to format addresses
+string legacy_quad (uint32_t val)
+{
+    string result;
+    for (int shift = 24 ; shift >= 0 ; shift -= 8)
+    {
+	stringstream ss;
+	ss << ((val >> shift) & 0xFF);
+	result += ss.str();
+	if (shift != 0) result += '.';
+    }
+    return result;
+}
+
+int bench_print (size_t count)
+{
+    mt19937 gen(1);
+    Intervals input = make_intervals(count, 0xFFFFFFFF, 4096, gen);
+    IPAR::List list;
+    list.add_batch(input);
+
+    ostringstream legacy;
+    double t_legacy = timed([&]()
+    {
+	for (auto iter = list.cbegin() ; iter != list.cend() ; ++iter)
+	{
+	    legacy << legacy_quad(iter->first);
+	    if (iter->second != iter->first)
+		legacy << '-' << legacy_quad(iter->second);
+	    legacy << endl;
+	}
+    });
+    IPAR::Writer out(list.size() * 32);
+    double t_writer = timed([&]() { list.print(out, true); });
+    unsigned int jobs = max(2u, thread::hardware_concurrency());
+    IPAR::Writer parallel(list.size() * 32);
+    double t_parallel = timed([&]() { list.print(parallel, true, jobs); });
+    if ((legacy.str() != string(out.text(), out.size())) ||
+        (legacy.str() != string(parallel.text(), parallel.size())))
+    {
+	cerr << "ERROR: results differ" << endl;
+	return 1;
+    }
+
+    cout << setw(12) << "legacy" << setw(12) << "Writer"
+         << setw(9) << "-j " << setw(3) << jobs << setw(12) << "bytes" << endl;
+    cout << setw(11) << t_legacy << 's' << setw(11) << t_writer << 's'
+         << setw(11) << t_parallel << 's' << setw(12) << out.size() << endl;
+    return 0;
+}
+
+int bench_expand (size_t count)
+{
+    uint32_t lower = 0x0A000000;
+    uint32_t upper = lower + static_cast<uint32_t>(count - 1);
+
+    ostringstream legacy;
+    double t_legacy = timed([&]()
+    {
+	legacy << hex << setfill('0');
+	for (uint32_t address = lower ; address <= upper ; ++address)
+	    legacy << setw(8) << address << endl;
+    });
+    IPAR::Writer out(count * 9);
+    double t_writer = timed([&]() { out.expand(lower, upper, IPAR::Ehex); });
+    if (legacy.str() != string(out.text(), out.size()))
+    {
+	cerr << "ERROR: results differ" << endl;
+	return 1;
+    }
+
+    cout << setw(12) << "legacy" << setw(12) << "expand" << setw(12) << "bytes"
+         << endl;
+    cout << setw(11) << t_legacy << 's' << setw(11) << t_writer << 's'
+         << setw(12) << out.size() << endl;
+    return 0;
+}
+
+// Bytes allocated from the heap right now
+size_t heap_used()
+{
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+
+template<typename LIST>
+int bench_storage_one (const char* name, const Intervals& input,
+                       const vector<uint32_t>& probes,
+                       const Intervals& removals)
+{
+    size_t before = heap_used();
+    LIST list;
+    double t_add = timed([&]()
+    {
+	for (auto& pr : input)
+	    list.add(IPAR::NumRange<uint32_t>(pr.first, pr.second));
+    });
+    double per_interval = static_cast<double>(heap_used() - before) /
+                          static_cast<double>(list.size());
+
+    uint64_t found = 0;
+    double t_lookup = timed([&]()
+    {
+	for (auto probe : probes)
+	{
+	    auto iter = list.lower_bound(probe);
+	    if (iter != list.cend()) found += iter->first - probe;
+	}
+    });
+
+    double t_subtract = timed([&]()
+    {
+	for (auto& pr : removals)
+	    list.subtract(IPAR::NumRange<uint32_t>(pr.first, pr.second));
+    });
+
+    size_t size = list.size();
+    double t_free = timed([&]() { LIST().swap(list); });
+
+    cout << setw(12) << name << setw(11) << t_add << 's'
+         << setw(11) << t_lookup << 's' << setw(11) << t_subtract << 's'
+         << setw(11) << t_free << 's'
+         << setw(12) << per_interval << setw(12) << size << endl;
+    return (found == 0) ? 1 : 0;
+}
+
+int bench_storage (size_t count)
+{
+    using MapList = IPAR::NumList<uint32_t, numeric_limits<uint32_t>::max(),
+                                  IPAR::MapStorage<uint32_t>>;
+    using PoolList = IPAR::NumList<uint32_t, numeric_limits<uint32_t>::max(),
+                                   IPAR::PoolStorage<uint32_t>>;
+    using FlatList = IPAR::NumList<uint32_t, numeric_limits<uint32_t>::max(),
+                                   IPAR::FlatStorage<uint32_t>>;
+
+    mt19937 gen(1);
+    Intervals input = make_intervals(count, 0xFFFFFFFF, 16, gen);
+    Intervals removals = make_intervals(count / 10, 0xFFFFFFFF, 256, gen);
+    vector<uint32_t> probes(count);
+    for (auto& probe : probes) probe = static_cast<uint32_t>(gen());
+
+    cout << setw(12) << "storage" << setw(12) << "add" << setw(12) << "lookup"
+         << setw(12) << "subtract" << setw(12) << "free"
+         << setw(12) << "bytes each"
+         << setw(12) << "intervals" << endl;
+    int retval = bench_storage_one<MapList>("map", input, probes, removals);
+    retval |= bench_storage_one<PoolList>("pool", input, probes, removals);
+    retval |= bench_storage_one<FlatList>("flat", input, probes, removals);
+    return retval;
+}
+
+IPAR::List make_list (size_t count, mt19937& gen)
+{
+    Intervals input = make_intervals(count, 0xFFFFFFFF, 1024, gen);
+    IPAR::List result;
+    result.add_batch(input);
+    return result;
+}
+
+// Each operation the old way, one interval at a time
+void piecewise_union (IPAR::List& list, const IPAR::List& other)
+{
+    for (auto iter = other.cbegin() ; iter != other.cend() ; ++iter)
+	list.add_from(iter);
+}
+
+void piecewise_difference (IPAR::List& list, const IPAR::List& other)
+{
+    for (auto iter = other.cbegin() ; iter != other.cend() ; ++iter)
+	list.subtract_from(iter);
+}
+
+void piecewise_intersection (IPAR::List& list, const IPAR::List& other)
+{
+    IPAR::List complem;
+    complem.add(IPAR::Range(0, 0xFFFFFFFF));
+    piecewise_difference(complem, other);
+    piecewise_difference(list, complem);
+}
+
+void piecewise_symmetric_difference (IPAR::List& list,
+                                     const IPAR::List& other)
+{
+    IPAR::List extra = other;
+    piecewise_difference(extra, list);
+    piecewise_difference(list, other);
+    piecewise_union(list, extra);
+}
+
+int bench_setops (size_t count)
+{
+    mt19937 gen(1);
+    IPAR::List big = make_list(count, gen);
+    IPAR::List same = make_list(count, gen);
+    IPAR::List small = make_list(max<size_t>(count / 1000, 1), gen);
+
+    using Op = void (IPAR::List::*)(const IPAR::List&);
+    using Piecewise = void (*)(IPAR::List&, const IPAR::List&);
+    struct { const char* name; Piecewise old_way; Op new_way; } ops[] = {
+	{ "union", piecewise_union, &IPAR::List::set_union },
+	{ "intersect", piecewise_intersection, &IPAR::List::set_intersection },
+	{ "difference", piecewise_difference, &IPAR::List::set_difference },
+	{ "symmetric", piecewise_symmetric_difference,
+	  &IPAR::List::set_symmetric_difference }
+    };
+
+    cout << setw(12) << "operation" << setw(12) << "sizes" << setw(12)
+         << "piecewise" << setw(12) << "set op" << setw(12) << "intervals"
+         << endl;
+    for (auto& op : ops)
+    {
+	for (auto other : { &same, &small })
+	{
+	    IPAR::List one = big, many = big;
+	    double t_old = timed([&]() { op.old_way(one, *other); });
+	    double t_new = timed([&]() { (many.*op.new_way)(*other); });
+	    if ((one.size() != many.size()) ||
+	        !equal(one.cbegin(), one.cend(), many.cbegin()))
+	    {
+		cerr << "ERROR: results differ" << endl;
+		return 1;
+	    }
+	    cout << setw(12) << op.name
+	         << setw(12) << ((other == &same) ? "N, N" : "N, N/1000")
+	         << setw(11) << t_old << 's' << setw(11) << t_new << 's'
+	         << setw(12) << many.size() << endl;
+	}
+    }
+    return 0;
+}
+
+int bench_bitmap (size_t count)
+{
+    mt19937 gen(1);
+    using ListOp = void (IPAR::List::*)(const IPAR::List&);
+    using BitmapOp = void (IPAR::Bitmap::*)(const IPAR::Bitmap&);
+    struct { const char* name; ListOp list_op; BitmapOp bitmap_op; } ops[] = {
+	{ "union", &IPAR::List::set_union, &IPAR::Bitmap::set_union },
+	{ "intersect", &IPAR::List::set_intersection,
+	  &IPAR::Bitmap::set_intersection },
+	{ "difference", &IPAR::List::set_difference,
+	  &IPAR::Bitmap::set_difference },
+	{ "symmetric", &IPAR::List::set_symmetric_difference,
+	  &IPAR::Bitmap::set_symmetric_difference }
+    };
+
+    cout << setw(12) << "operation" << setw(12) << "layout" << setw(12)
+         << "list" << setw(12) << "bitmap" << setw(12) << "+convert"
+         << setw(12) << "intervals" << endl;
+    for (bool dense : { true, false })
+    {
+	// Intervals of up to 16 addresses, about one address in three used
+	// when dense
+	uint32_t space = dense ?
+	    static_cast<uint32_t>(min<size_t>(count * 32, 0xFFFFFFFF)) :
+	    0xFFFFFFFF;
+	Intervals left_input = make_intervals(count, space, 16, gen);
+	Intervals right_input = make_intervals(count, space, 16, gen);
+	IPAR::List left, right;
+	left.add_batch(left_input);
+	right.add_batch(right_input);
+
+	for (auto& op : ops)
+	{
+	    IPAR::List by_list = left;
+	    double t_list = timed([&]() { (by_list.*op.list_op)(right); });
+
+	    IPAR::List by_bitmap;
+	    IPAR::Bitmap one(left), other(right);
+	    double t_bitmap = timed([&]() { (one.*op.bitmap_op)(other); });
+	    double t_convert = timed([&]() {
+		IPAR::Bitmap first(left), second(right);
+		(first.*op.bitmap_op)(second);
+		first.add_to(by_bitmap);
+	    });
+	    if ((by_list.size() != by_bitmap.size()) ||
+	        !equal(by_list.cbegin(), by_list.cend(), by_bitmap.cbegin()))
+	    {
+		cerr << "ERROR: results differ" << endl;
+		return 1;
+	    }
+	    cout << setw(12) << op.name << setw(12)
+	         << (dense ? "dense" : "sparse")
+	         << setw(11) << t_list << 's' << setw(11) << t_bitmap << 's'
+	         << setw(11) << t_convert << 's' << setw(12) << by_list.size()
+	         << endl;
+	}
+	IPAR::Bitmap sample(left);
+	cout << setw(24) << "bytes" << setw(24)
+	     << sample.memory_used() << setw(12)
+	     << (IPAR::Bitmap::suits(left) ? "suits" : "") << endl;
+    }
+    return 0;
+}
+
+int bench_lookup (size_t count)
+{
+    mt19937 gen(1);
+    Intervals input = make_intervals(count, 0xFFFFFFFF, 1024, gen);
+    IPAR::List list;
+    list.add_batch(input);
+    vector<uint32_t> probes(count * 10);
+    for (auto& probe : probes) probe = static_cast<uint32_t>(gen());
+
+    unique_ptr<IPAR::Table> table;
+    double t_compile = timed([&]() { table.reset(new IPAR::Table(list)); });
+
+    size_t by_list = 0;
+    double t_list = timed([&]()
+    {
+	for (auto probe : probes)
+	{
+	    auto iter = list.upper_bound(probe);
+	    if ((iter != list.cbegin()) && (probe <= (--iter)->second))
+		++by_list;
+	}
+    });
+
+    size_t by_table = 0;
+    double t_table = timed([&]()
+    {
+	for (auto probe : probes)
+	    if (table->contains(probe)) ++by_table;
+    });
+
+    unique_ptr<bool[]> results(new bool[probes.size()]);
+    double t_batch = timed([&]()
+    {
+	table->contains(probes, span<bool>(results.get(), probes.size()));
+    });
+    size_t by_batch = static_cast<size_t>(
+        count_if(results.get(), results.get() + probes.size(),
+                 [](bool found) { return found; }));
+
+    if ((by_list != by_table) || (by_list != by_batch))
+    {
+	cerr << "ERROR: results differ" << endl;
+	return 1;
+    }
+    double lookups = static_cast<double>(probes.size()) / 1e6;
+    cout << setw(12) << "compile" << setw(11) << t_compile << 's'
+         << setw(12) << table->num_chunks() << " chunks" << endl;
+    cout << setw(12) << "list" << setw(11) << t_list << 's'
+         << setw(12) << lookups / t_list << " M/s" << endl;
+    cout << setw(12) << "table" << setw(11) << t_table << 's'
+         << setw(12) << lookups / t_table << " M/s" << endl;
+    cout << setw(12) << "batch" << setw(11) << t_batch << 's'
+         << setw(12) << lookups / t_batch << " M/s" << endl;
+    return 0;
+}
+
+int bench_rank (size_t count)
+{
+    mt19937 gen(1);
+    IPAR::List list = make_list(count, gen);
+    vector<uint32_t> probes(count);
+    for (auto& probe : probes) probe = static_cast<uint32_t>(gen());
+
+    uint64_t walked = 0;
+    double t_walk = timed([&]()
+    {
+	for (auto iter = list.cbegin() ; iter != list.cend() ; ++iter)
+	    walked += uint64_t(iter->second - iter->first) + 1;
+    });
+    uint64_t total = 0;
+    double t_index = timed([&]() { total = list.cardinality(); });
+    if (total != walked)
+    {
+	cerr << "ERROR: results differ" << endl;
+	return 1;
+    }
+
+    uint64_t sum = 0;
+    double t_count = timed([&]()
+    {
+	for (auto probe : probes)
+	    sum += list.count(probe >> 1, probe);
+    });
+    double t_rank = timed([&]()
+    {
+	for (auto probe : probes) sum += list.rank(probe);
+    });
+    double t_select = timed([&]()
+    {
+	for (auto probe : probes) sum += list.select(probe % total);
+    });
+
+    cout << setw(12) << "walk" << setw(11) << t_walk << 's' << endl;
+    cout << setw(12) << "index" << setw(11) << t_index << 's' << endl;
+    cout << setw(12) << "count" << setw(11) << t_count << 's' << endl;
+    cout << setw(12) << "rank" << setw(11) << t_rank << 's' << endl;
+    cout << setw(12) << "select" << setw(11) << t_select << 's' << endl;
+    return (sum == 0) ? 1 : 0;
+}
+
+int bench_frozen (size_t count)
+{
+    mt19937 gen(1);
+    Intervals input = make_intervals(count, 0xFFFFFFFF, 1024, gen);
+    IPAR::List list;
+    list.add_batch(input);
+    vector<uint32_t> probes(count * 10);
+    for (auto& probe : probes) probe = static_cast<uint32_t>(gen());
+
+    IPAR::FrozenList<uint32_t> frozen;
+    double t_freeze = timed([&]() { frozen = list.freeze(); });
+
+    size_t by_list = 0;
+    double t_list = timed([&]()
+    {
+	for (auto probe : probes)
+	{
+	    auto iter = list.upper_bound(probe);
+	    if ((iter != list.cbegin()) && (probe <= (--iter)->second))
+		++by_list;
+	}
+    });
+
+    size_t by_frozen = 0;
+    double t_frozen = timed([&]()
+    {
+	for (auto probe : probes)
+	    if (frozen.contains(probe)) ++by_frozen;
+    });
+
+    // Each thread takes an equal share of the probes
+    unsigned int jobs = max(2u, thread::hardware_concurrency());
+    vector<size_t> found(jobs, 0);
+    double t_parallel = timed([&]()
+    {
+	IPAR::parallel_for(jobs, jobs, [&](size_t task)
+	{
+	    size_t begin = probes.size() * task / jobs;
+	    size_t end = probes.size() * (task + 1) / jobs;
+	    for (size_t index = begin ; index < end ; ++index)
+		if (frozen.contains(probes[index])) ++found[task];
+	});
+    });
+    size_t by_parallel = 0;
+    for (auto part : found) by_parallel += part;
+
+    if ((by_list != by_frozen) || (by_list != by_parallel))
+    {
+	cerr << "ERROR: results differ" << endl;
+	return 1;
+    }
+    double lookups = static_cast<double>(probes.size()) / 1e6;
+    cout << setw(12) << "freeze" << setw(11) << t_freeze << 's'
+         << setw(12) << frozen.size() << " intervals" << endl;
+    cout << setw(12) << "list" << setw(11) << t_list << 's'
+         << setw(12) << lookups / t_list << " M/s" << endl;
+    cout << setw(12) << "frozen" << setw(11) << t_frozen << 's'
+         << setw(12) << lookups / t_frozen << " M/s" << endl;
+    cout << setw(9) << "-j " << setw(3) << jobs << setw(11) << t_parallel
+         << 's' << setw(12) << lookups / t_parallel << " M/s" << endl;
+    return 0;
+}
+
+// Where bench_concurrent keeps its marker intervals, one address each
+const uint32_t marker_base = 0xF0000000;
+const uint32_t marker_end = 0xF0010000;
+
+uint32_t marker (unsigned long batch)
+{
+    return marker_base + static_cast<uint32_t>((batch % 0x8000) * 2);
+}
+
+// Whether a version of the list holds exactly one marker
+bool one_marker (const IPAR::FrozenList<uint32_t>& frozen)
+{
+    auto iter = frozen.lower_bound(marker_base);
+    if ((iter == frozen.cend()) || (iter->first >= marker_end) ||
+        (iter->first != iter->second))
+	return false;
+    ++iter;
+    return (iter == frozen.cend()) || (iter->first >= marker_end);
+}
+
+int bench_concurrent (size_t count)
+{
+    mt19937 gen(1);
+    Intervals input = make_intervals(count, 0xE0000000, 1024, gen);
+    for (auto& interval : input)
+    {
+	interval.first += 0x01000000;
+	interval.second += 0x01000000;
+    }
+    IPAR::List initial;
+    initial.add_batch(input);
+    initial.add(IPAR::Range(marker(0), marker(0)));
+    initial.add(IPAR::Range(0xFFFFFF00, 0xFFFFFFFF));
+
+    unsigned int jobs = max(2u, thread::hardware_concurrency());
+    IPAR::ConcurrentList list(jobs, initial);
+    vector<uint32_t> probes(count * 10);
+    for (auto& probe : probes) probe = static_cast<uint32_t>(gen());
+
+    // Each reader takes an equal share of the probes. Every 1024 lookups it
+    // checks the current version as a whole.
+    atomic<size_t> errors(0);
+    auto read = [&](unsigned int task, size_t& found)
+    {
+	IPAR::ConcurrentList::Reader reader(list);
+	unsigned long last_version = 0;
+	size_t begin = probes.size() * task / jobs;
+	size_t end = probes.size() * (task + 1) / jobs;
+	for (size_t index = begin ; index < end ; ++index)
+	{
+	    if (reader.contains(probes[index])) ++found;
+	    if ((index & 1023) != 0) continue;
+	    if (!reader.read(one_marker) || !reader.contains(0xFFFFFFFF) ||
+	        reader.contains(0) || (reader.version() < last_version))
+		++errors;
+	    last_version = reader.version();
+	}
+    };
+    auto run_readers = [&](vector<size_t>& found)
+    {
+	vector<thread> threads;
+	for (unsigned int task = 0 ; task < jobs ; ++task)
+	    threads.emplace_back(read, task, ref(found[task]));
+	for (auto& reader : threads) reader.join();
+    };
+
+    vector<size_t> found_alone(jobs, 0);
+    double t_alone = timed([&]() { run_readers(found_alone); });
+
+    // The writer changes about one interval in a hundred per version
+    atomic<bool> done(false);
+    unsigned long versions = 0;
+    size_t most_retired = 0;
+    thread writer([&]()
+    {
+	mt19937 wgen(2);
+	size_t batch_size = max(size_t(1), count / 100);
+	for (unsigned long batch = 1 ; !done.load() ; ++batch)
+	{
+	    Intervals changes =
+	        make_intervals(batch_size, 0xE0000000, 1024, wgen);
+	    for (size_t index = 0 ; index < changes.size() ; ++index)
+	    {
+		IPAR::Range range(changes[index].first + 0x01000000,
+		                  changes[index].second + 0x01000000);
+		if (index & 1)
+		    list.add(range);
+		else
+		    list.subtract(range);
+	    }
+	    list.subtract(IPAR::Range(marker(batch - 1), marker(batch - 1)));
+	    list.add(IPAR::Range(marker(batch), marker(batch)));
+	    versions = list.publish();
+	    most_retired = max(most_retired, list.num_retired());
+	}
+    });
+    vector<size_t> found_busy(jobs, 0);
+    double t_busy = timed([&]() { run_readers(found_busy); });
+    done.store(true);
+    writer.join();
+
+    if (errors.load() != 0)
+    {
+	cerr << "ERROR: " << errors.load() << " bad versions seen" << endl;
+	return 1;
+    }
+    double lookups = static_cast<double>(probes.size()) / 1e6;
+    cout << setw(9) << "-j " << setw(3) << jobs << setw(12) << "alone"
+         << setw(11) << t_alone << 's'
+         << setw(12) << lookups / t_alone << " M/s" << endl;
+    cout << setw(24) << "writing" << setw(11) << t_busy << 's'
+         << setw(12) << lookups / t_busy << " M/s" << endl;
+    cout << setw(24) << "versions" << setw(12) << versions
+         << setw(12) << most_retired << " retired at most" << endl;
+    return 0;
+}
+
+int bench_ipv6 (size_t count)
+{
+    mt19937 gen(1);
+    Intervals random = make_intervals(count, 0xFFFFFFFF, 64, gen);
+    Intervals sorted = random;
+    sort(sorted.begin(), sorted.end());
+    Intervals overlapping = make_intervals(count, 1 << 24, 256, gen);
+    vector<uint32_t> probes(10 * count);
+    for (auto& probe : probes) probe = static_cast<uint32_t>(gen());
+
+    using Interval6 = pair<IPAR::uint128_t,IPAR::uint128_t>;
+    auto widen = [](uint32_t bound) {
+	return static_cast<IPAR::uint128_t>(bound) << 96;
+    };
+    const IPAR::uint128_t low_bits = widen(1) - 1;
+
+    cout << setw(12) << "input" << setw(12) << "add" << setw(12) << "add6"
+         << setw(12) << "add_batch" << setw(12) << "add_batch6"
+         << setw(12) << "lookup" << setw(12) << "lookup6" << endl;
+    for (auto& input : { make_pair("random", &random),
+                         make_pair("sorted", &sorted),
+                         make_pair("overlapping", &overlapping) })
+    {
+	vector<Interval6> input6;
+	input6.reserve(input.second->size());
+	for (auto& pr : *input.second)
+	    input6.push_back(
+	        make_pair(widen(pr.first), widen(pr.second) | low_bits));
+
+	IPAR::List one, many;
+	IPAR::List6 one6, many6;
+	double t_one = timed([&]()
+	{
+	    for (auto& pr : *input.second)
+		one.add(IPAR::Range(pr.first, pr.second));
+	});
+	double t_one6 = timed([&]()
+	{
+	    for (auto& pr : input6)
+		one6.add(IPAR::Range6(pr.first, pr.second));
+	});
+	Intervals copy = *input.second;
+	double t_many = timed([&]() { many.add_batch(copy); });
+	vector<Interval6> copy6 = input6;
+	double t_many6 = timed([&]() { many6.add_batch(copy6); });
+	if ((one.size() != many.size()) || (one6.size() != many6.size()) ||
+	    (one.size() != one6.size()))
+	{
+	    cerr << "ERROR: results differ" << endl;
+	    return 1;
+	}
+
+	auto frozen = many.freeze();
+	auto frozen6 = many6.freeze();
+	size_t found = 0, found6 = 0;
+	double t_lookup = timed([&]()
+	{
+	    for (auto probe : probes) found += frozen.contains(probe);
+	});
+	double t_lookup6 = timed([&]()
+	{
+	    for (auto probe : probes) found6 += frozen6.contains(widen(probe));
+	});
+	if (found != found6)
+	{
+	    cerr << "ERROR: results differ" << endl;
+	    return 1;
+	}
+
+	cout << setw(12) << input.first << setw(11) << t_one << 's'
+	     << setw(11) << t_one6 << 's' << setw(11) << t_many << 's'
+	     << setw(11) << t_many6 << 's' << setw(11) << t_lookup << 's'
+	     << setw(11) << t_lookup6 << 's' << endl;
+    }
+    return 0;
+}
+
+int bench_sharded (size_t count)
+{
+    mt19937 gen(1);
+    IPAR::List big = make_list(count, gen);
+    IPAR::List same = make_list(count, gen);
+    unsigned int jobs = max(2u, thread::hardware_concurrency());
+
+    using ListOp = void (IPAR::List::*)(const IPAR::List&);
+    using ShardedOp = void (IPAR::ShardedList::*)(const IPAR::ShardedList&);
+    struct { const char* name; ListOp on_list; ShardedOp on_shards; } ops[] = {
+	{ "union", &IPAR::List::set_union, &IPAR::ShardedList::set_union },
+	{ "intersect", &IPAR::List::set_intersection,
+	  &IPAR::ShardedList::set_intersection },
+	{ "difference", &IPAR::List::set_difference,
+	  &IPAR::ShardedList::set_difference },
+	{ "symmetric", &IPAR::List::set_symmetric_difference,
+	  &IPAR::ShardedList::set_symmetric_difference }
+    };
+
+    cout << "-j " << jobs << endl;
+    cout << setw(12) << "operation" << setw(8) << "shards" << setw(12)
+         << "list" << setw(12) << "sharded" << setw(12) << "convert"
+         << setw(12) << "print" << endl;
+    for (auto& op : ops)
+    {
+	IPAR::List plain = big;
+	double t_list = timed([&]() { (plain.*op.on_list)(same); });
+	IPAR::Writer expected(static_cast<size_t>(1) << 16);
+	plain.print(expected, true);
+
+	for (unsigned int bits : { 4u, 8u })
+	{
+	    IPAR::ShardedList one(bits, jobs), other(bits, jobs);
+	    double t_convert = timed([&]()
+	    {
+		one = IPAR::ShardedList(big, bits, jobs);
+		other = IPAR::ShardedList(same, bits, jobs);
+	    });
+	    double t_sharded = timed([&]() { (one.*op.on_shards)(other); });
+	    IPAR::Writer actual(expected.size());
+	    double t_print = timed([&]() { one.print(actual, true, jobs); });
+	    if ((actual.size() != expected.size()) ||
+	        !equal(actual.text(), actual.text() + actual.size(),
+	               expected.text()))
+	    {
+		cerr << "ERROR: results differ" << endl;
+		return 1;
+	    }
+	    cout << setw(12) << op.name << setw(8) << (1u << bits)
+	         << setw(11) << t_list << 's' << setw(11) << t_sharded << 's'
+	         << setw(11) << t_convert << 's' << setw(11) << t_print << 's'
+	         << endl;
+	}
+    }
+    return 0;
+}
+
+int bench_load (size_t count)
+{
+    // Write the files, with dashes
+    const size_t num_files = 8;
+    char dir_template[] = "/tmp/ipar_bench.XXXXXX";
+    if (mkdtemp(dir_template) == nullptr)
+    {
+	cerr << "ERROR: could not make a temporary directory" << endl;
+	return 1;
+    }
+    string dir(dir_template);
+    mt19937 gen(1);
+    vector<string> filenames;
+    for (size_t index = 0 ; index < num_files ; ++index)
+    {
+	IPAR::List list;
+	Intervals input = make_intervals(count, 0xFFFFFFFF, 1024, gen);
+	list.add_batch(input);
+	filenames.push_back(dir + "/" + to_string(index) + ".txt");
+	ofstream ofs(filenames.back());
+	list.print(ofs, true);
+    }
+
+    // One after another, as the programs used to
+    IPAR::FileCache cache(false);
+    unsigned int jobs = max(2u, thread::hardware_concurrency());
+    IPAR::List one;
+    IPAR::List6 one6;
+    int retval = 0;
+    double t_one = timed([&]()
+    {
+	for (const auto& filename : filenames)
+	{
+	    IPAR::List otherlist;
+	    IPAR::List6 otherlist6;
+	    retval |= cache.read(filename, otherlist, otherlist6, jobs);
+	    one.set_union(otherlist);
+	    one6.set_union(otherlist6);
+	}
+    });
+
+    // Side by side
+    IPAR::List all;
+    IPAR::List6 all6;
+    double t_all = timed([&]()
+    {
+	retval |= cache.read_all(filenames, all, all6, jobs);
+    });
+
+    for (const auto& filename : filenames) remove(filename.c_str());
+    rmdir(dir.c_str());
+    if ((retval != 0) || (one.size() != all.size()) ||
+        !equal(one.cbegin(), one.cend(), all.cbegin()))
+    {
+	cerr << "ERROR: results differ" << endl;
+	return 1;
+    }
+    cout << "-j " << jobs << endl;
+    cout << setw(12) << "files" << setw(12) << "in turn" << setw(12)
+         << "read_all" << setw(12) << "intervals" << endl;
+    cout << setw(12) << num_files << setw(11) << t_one << 's' << setw(11)
+         << t_all << 's' << setw(12) << all.size() << endl;
+    return 0;
+}
+
+// The best extension of an interval the old way: every candidate in reach,
+// each scored with the order statistics of the list
+IPAR::GapInfo old_best_extension (const IPAR::List& list, uint32_t lower,
+                                  uint32_t upper, uint32_t max_search)
+{
+    IPAR::GapInfo best { make_pair(lower, upper), upper, 0, 0.0 };
+    uint32_t limit = numeric_limits<uint32_t>::max();
+    if (limit - lower >= max_search) limit = lower + max_search;
+    for (auto iter = list.lower_bound(lower) ; iter != list.cend() ; ++iter)
+    {
+	if (iter->first == lower) continue;
+	if (iter->first > limit) break;
+	double score = static_cast<double>(list.count(lower, iter->second)) /
+	    (iter->second - lower + 1);
+	if (score > best.mScore)
+	{
+	    best.mExpandedUpper = iter->second;
+	    best.mNumCovered = static_cast<uint32_t>(
+	        list.count_intervals(lower, iter->second));
+	    best.mScore = score;
+	}
+    }
+    return best;
+}
+
+int bench_gaps (size_t count)
+{
+    // Short intervals, so that few of them merge
+    mt19937 gen(1);
+    Intervals input = make_intervals(count, 0xFFFFFFFF, 64, gen);
+    IPAR::List list;
+    list.add_batch(input);
+
+    // The old way takes too long for more than a few intervals
+    const size_t old_count = min<size_t>(list.size(), 256);
+    vector<IPAR::GapInfo> old_results;
+    double t_old = timed([&]()
+    {
+	for (auto iter = list.cbegin() ; old_results.size() < old_count ;
+	     ++iter)
+	{
+	    old_results.push_back(old_best_extension(list, iter->first,
+	        iter->second, IPAR::default_max_search));
+	}
+    });
+
+    unique_ptr<IPAR::CoverageIndex> index;
+    double t_index = timed([&]()
+        { index = make_unique<IPAR::CoverageIndex>(list); });
+    vector<IPAR::GapInfo> results;
+    results.reserve(index->size());
+    double t_new = timed([&]()
+    {
+	IPAR::ExtensionSearch search(*index);
+	for (size_t interval = 0 ; interval < index->size() ; ++interval)
+	    results.push_back(search.find(interval));
+    });
+
+    // The same on one thread per core, with work stealing
+    unsigned int jobs = max(2u, thread::hardware_concurrency());
+    vector<IPAR::GapInfo> parallel_results(index->size());
+    double t_parallel = timed([&]()
+    {
+	vector<IPAR::ExtensionSearch> searches(jobs,
+	    IPAR::ExtensionSearch(*index));
+	IPAR::parallel_ranges(jobs, index->size(), 4096,
+	    [&](unsigned int job, size_t begin, size_t end)
+	{
+	    for (size_t interval = begin ; interval < end ; ++interval)
+		parallel_results[interval] = searches[job].find(interval);
+	});
+    });
+    for (size_t interval = 0 ; interval < results.size() ; ++interval)
+    {
+	if (results[interval].mExpandedUpper !=
+	    parallel_results[interval].mExpandedUpper)
+	{
+	    cerr << "ERROR: results differ" << endl;
+	    return 1;
+	}
+    }
+
+    for (size_t interval = 0 ; interval < old_count ; ++interval)
+    {
+	const IPAR::GapInfo& one = old_results[interval];
+	const IPAR::GapInfo& other = results[interval];
+	if ((one.mExpandedUpper != other.mExpandedUpper) ||
+	    (one.mNumCovered != other.mNumCovered) ||
+	    (one.mScore != other.mScore))
+	{
+	    cerr << "ERROR: results differ" << endl;
+	    return 1;
+	}
+    }
+    cout << setw(12) << "intervals" << setw(12) << "old each"
+         << setw(12) << "index" << setw(12) << "search" << setw(12)
+         << "new each" << setw(9) << "-j " << setw(3) << jobs << endl;
+    cout << setw(12) << list.size()
+         << setw(10) << t_old * 1e6 / static_cast<double>(old_count) << "us"
+         << setw(11) << t_index << 's' << setw(11) << t_new << 's'
+         << setw(10) << t_new * 1e6 / static_cast<double>(results.size())
+         << "us" << setw(11) << t_parallel << 's' << endl;
+    return 0;
+}
+
+int bench_top (size_t count)
+{
+    mt19937 gen(1);
+    Intervals input = make_intervals(count, 0xFFFFFFFF, 64, gen);
+    IPAR::List list;
+    list.add_batch(input);
+    IPAR::CoverageIndex index(list);
+    IPAR::ExtensionSearch search(index);
+    vector<IPAR::GapInfo> results;
+    results.reserve(index.size());
+    for (size_t interval = 0 ; interval < index.size() ; ++interval)
+	results.push_back(search.find(interval));
+
+    // All of them, as ipar_gap_analyzer does without -top
+    vector<IPAR::GapInfo> all;
+    double t_all = timed([&]()
+    {
+	all = results;
+	sort(all.begin(), all.end(), IPAR::reported_before);
+    });
+
+    const size_t kept = 100;
+    IPAR::TopGaps top(kept);
+    vector<IPAR::GapInfo> best;
+    double t_top = timed([&]()
+    {
+	for (const auto& result : results) top.add(result);
+	best = top.sorted();
+    });
+
+    size_t first = all.size() - min(kept, all.size());
+    for (size_t index_best = 0 ; index_best < best.size() ; ++index_best)
+    {
+	if (best[index_best].mOriginalRange !=
+	    all[first + index_best].mOriginalRange)
+	{
+	    cerr << "ERROR: results differ" << endl;
+	    return 1;
+	}
+    }
+    cout << setw(12) << "intervals" << setw(12) << "sort all" << setw(12)
+         << "top " + to_string(kept) << setw(12) << "kept" << endl;
+    cout << setw(12) << all.size() << setw(11) << t_all << 's' << setw(11)
+         << t_top << 's' << setw(12) << top.size() << endl;
+    return 0;
+}
+
+int bench_prefixes (size_t count)
+{
+    mt19937 gen(1);
+    Intervals input = make_intervals(count, 0xFFFFFFFF, 64, gen);
+    IPAR::List list;
+    list.add_batch(input);
+    const double min_score = 0.5;
+
+    // Each prefix of each length is counted once, when the first interval
+    // in it comes along
+    size_t old_dense = 0;
+    double t_old = timed([&]()
+    {
+	uint64_t last[33];
+	fill(begin(last), end(last), numeric_limits<uint64_t>::max());
+	for (auto iter = list.cbegin() ; iter != list.cend() ; ++iter)
+	{
+	    for (unsigned int length = IPAR::shortest_prefix ; length <= 32 ;
+	         ++length)
+	    {
+		uint64_t size = static_cast<uint64_t>(1) << (32 - length);
+		uint64_t prefix = iter->first & ~(size - 1);
+		if (prefix == last[length]) prefix += size;
+		for ( ; prefix <= iter->second ; prefix += size)
+		{
+		    uint64_t covered = list.count(
+		        static_cast<uint32_t>(prefix),
+		        static_cast<uint32_t>(prefix + size - 1));
+		    if (static_cast<double>(covered) /
+		        static_cast<double>(size) >= min_score)
+			++old_dense;
+		    last[length] = prefix;
+		}
+	    }
+	}
+    });
+
+    vector<IPAR::PrefixInfo> found;
+    double t_new = timed([&]()
+    {
+	IPAR::dense_prefixes(list, min_score,
+	    [&](const IPAR::PrefixInfo& prefix) { found.push_back(prefix); });
+    });
+
+    for (const auto& prefix : found)
+    {
+	uint64_t size = static_cast<uint64_t>(1) << (32 - prefix.mLength);
+	if (prefix.mNumCovered != list.count(prefix.mLower,
+	    static_cast<uint32_t>(prefix.mLower + size - 1)))
+	{
+	    cerr << "ERROR: results differ" << endl;
+	    return 1;
+	}
+    }
+    cout << setw(12) << "intervals" << setw(12) << "old" << setw(12)
+         << "found" << setw(12) << "new" << setw(12) << "reported"
+         << endl;
+    cout << setw(12) << list.size() << setw(11) << t_old << 's' << setw(12)
+         << old_dense << setw(11) << t_new << 's' << setw(12)
+         << found.size() << endl;
+    return 0;
+}
+
+// What the parser made of odd inputs before it was rewritten, with
+// ipar_read -dashes. Only "/0" has changed on purpose: the old code shifted
+// by 32, which is undefined, and on x86 gave the single address.
+struct ParseCase
+{
+    const char* mInput;
+    const char* mOld;
+    const char* mNew;
+};
+const ParseCase parse_cases[] =
+{
+    { "1..2.3",             "1.0.2.3",                 "1.0.2.3" },
+    { ".1.2.3",             "0.1.2.3",                 "0.1.2.3" },
+    { "1.2.3.",             "1.2.3.0",                 "1.2.3.0" },
+    { "...",                "0.0.0.0",                 "0.0.0.0" },
+    { "",                   "domain",                  "domain" },
+    { "01.002.0003.4",      "1.2.3.4",                 "1.2.3.4" },
+    { "1.2.3.0255",         "1.2.3.255",               "1.2.3.255" },
+    { "1.2.3.4294967297",   "1.2.3.1",                 "1.2.3.1" },
+    { "1.2.3.4294967552",   "domain",                  "domain" },
+    { "1.2.3.256",          "domain",                  "domain" },
+    { "1.2.3.4/032",        "1.2.3.4",                 "1.2.3.4" },
+    { "1.2.3.4/33",         "range",                   "range" },
+    { "1.2.3.4/4294967297", "0.0.0.0-127.255.255.255",
+                            "0.0.0.0-127.255.255.255" },
+    { "1.2.3.4/0",          "1.2.3.4",
+                            "0.0.0.0-255.255.255.255" },
+    { "1.2.3.4/",           "1.2.3.4",
+                            "0.0.0.0-255.255.255.255" },
+    { "1.2.3.4-",           "domain",                  "domain" },
+    { "-1.2.3.4",           "domain",                  "domain" },
+    { "1.2.3.4-1.2.3.0",    "1.2.3.4-1.2.3.0",         "1.2.3.4-1.2.3.0" },
+    { "10.0.0.0/8-1.2.3.4", "domain",                  "domain" },
+    { "1.2.3",              "domain",                  "domain" },
+    { "1.2.3.4.5",          "domain",                  "domain" },
+    { "1.2.3.+4",           "domain",                  "domain" },
+};
+
+// One result of a parser as a string: the range with dashes, or which
+// exception it threw
+template<typename FUNC>
+string parse_result (FUNC func, string_view expr)
+{
+    try
+    {
+	pair<uint32_t,uint32_t> range = func(expr);
+	string result = IPAR::int_to_quad(range.first);
+	if (range.second != range.first)
+	    result += "-" + IPAR::int_to_quad(range.second);
+	return result;
+    }
+    catch (const IPAR::ip_domain_error&)
+    {
+	return "domain";
+    }
+    catch (const IPAR::ip_range_error&)
+    {
+	return "range";
+    }
+}
+
+int bench_parse (size_t count)
+{
+    int status = 0;
+    cout << setw(20) << left << "input" << setw(25) << "old" << "new"
+         << right << endl;
+    for (const ParseCase& test : parse_cases)
+    {
+	string fast = parse_result(IPAR::runtime_parse_range, test.mInput);
+	string slow = parse_result(IPAR::scalar_parse_range, test.mInput);
+	bool good = (fast == test.mNew) && (slow == test.mNew);
+	if (!good) status = 1;
+	cout << setw(20) << left << test.mInput << setw(25) << test.mOld
+	     << fast << (good ? "" : "  ERROR") << right << endl;
+    }
+
+    // Half well formed addresses, ranges and prefixes, the rest random
+    // strings of the characters that matter, and a few that do not
+    mt19937 gen(1);
+    uniform_int_distribution<uint32_t> addr_dist;
+    uniform_int_distribution<int> kind_dist(0, 5);
+    uniform_int_distribution<size_t> len_dist(0, 20);
+    const string alphabet = "0123456789012345....--//+ a\xff";
+    uniform_int_distribution<size_t> char_dist(0, alphabet.size() - 1);
+    vector<string> inputs;
+    inputs.reserve(count);
+    for (size_t index = 0 ; index < count ; ++index)
+    {
+	string expr;
+	switch (kind_dist(gen))
+	{
+	case 0:
+	    expr = IPAR::int_to_quad(addr_dist(gen));
+	    break;
+	case 1:
+	    expr = IPAR::int_to_quad(addr_dist(gen)) + "-" +
+	        IPAR::int_to_quad(addr_dist(gen));
+	    break;
+	case 2:
+	    expr = IPAR::int_to_quad(addr_dist(gen)) + "/" +
+	        to_string(addr_dist(gen) % 34);
+	    break;
+	default:
+	    for (size_t len = len_dist(gen) ; len > 0 ; --len)
+		expr += alphabet[char_dist(gen)];
+	    break;
+	}
+	inputs.push_back(move(expr));
+    }
+
+    size_t mismatches = 0;
+    for (const string& expr : inputs)
+    {
+	if (parse_result(IPAR::runtime_parse_range, expr) !=
+	    parse_result(IPAR::scalar_parse_range, expr))
+	{
+	    if (mismatches++ < 10)
+		cerr << "ERROR: parsers differ on \"" << expr << '"' << endl;
+	}
+    }
+    if (mismatches != 0) status = 1;
+
+    // Time only the inputs that parse, so that exceptions do not dominate
+    vector<string> valid;
+    for (const string& expr : inputs)
+    {
+	string result = parse_result(IPAR::scalar_parse_range, expr);
+	if ((result != "domain") && (result != "range"))
+	    valid.push_back(expr);
+    }
+    uint32_t sum_fast = 0, sum_slow = 0;
+    double t_fast = timed([&]()
+    {
+	for (const string& expr : valid)
+	    sum_fast += IPAR::runtime_parse_range(expr).second;
+    });
+    double t_slow = timed([&]()
+    {
+	for (const string& expr : valid)
+	    sum_slow += IPAR::scalar_parse_range(expr).second;
+    });
+    if (sum_fast != sum_slow) status = 1;
+
+    cout << setw(12) << "inputs" << setw(12) << "mismatches" << setw(12)
+         << "parsed" << setw(12) << "scalar" << setw(12) << "runtime"
+         << endl;
+    cout << setw(12) << inputs.size() << setw(12) << mismatches << setw(12)
+         << valid.size() << setw(11) << t_slow << 's' << setw(11) << t_fast
+         << 's' << endl;
+    return status;
+}
+
+void usage()
+{
+    cerr << "Usage: ipar_bench batch N" << endl;
+    cerr << "       ipar_bench print N" << endl;
+    cerr << "       ipar_bench expand N" << endl;
+    cerr << "       ipar_bench storage N" << endl;
+    cerr << "       ipar_bench setops N" << endl;
+    cerr << "       ipar_bench bitmap N" << endl;
+    cerr << "       ipar_bench lookup N" << endl;
+    cerr << "       ipar_bench rank N" << endl;
+    cerr << "       ipar_bench frozen N" << endl;
+    cerr << "       ipar_bench concurrent N" << endl;
+    cerr << "       ipar_bench ipv6 N" << endl;
+    cerr << "       ipar_bench sharded N" << endl;
+    cerr << "       ipar_bench load N" << endl;
+    cerr << "       ipar_bench gaps N" << endl;
+    cerr << "       ipar_bench top N" << endl;
+    cerr << "       ipar_bench prefixes N" << endl;
+    cerr << "       ipar_bench parse N" << endl;
+}
+
+int main (int argc, char* argv[])
+{
+    if (argc != 3)
+    {
+	usage();
+	return 1;
+    }
+    string which(argv[1]);
+    size_t count = stoul(argv[2]);
+
+    if (which == "batch") return bench_batch(count);
+    if (which == "print") return bench_print(count);
+    if (which == "expand") return bench_expand(count);
+    if (which == "storage") return bench_storage(count);
+    if (which == "setops") return bench_setops(count);
+    if (which == "bitmap") return bench_bitmap(count);
+    if (which == "lookup") return bench_lookup(count);
+    if (which == "rank") return bench_rank(count);
+    if (which == "frozen") return bench_frozen(count);
+    if (which == "concurrent") return bench_concurrent(count);
+    if (which == "ipv6") return bench_ipv6(count);
+    if (which == "sharded") return bench_sharded(count);
+    if (which == "load") return bench_load(count);
+    if (which == "gaps") return bench_gaps(count);
+    if (which == "top") return bench_top(count);
+    if (which == "prefixes") return bench_prefixes(count);
+    if (which == "parse") return bench_parse(count);
+
+    usage();
+    return 1;
+}
@@ -0,0 +1,557 @@
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <utility>
+#include <vector>
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#endif
+#include "ipar_bitmap.h"
+
+namespace IPAR
+{
+
+namespace { // anonymous
+
+// Words in the bitmap of one container, and the most values an array holds
+// before it is no smaller than a bitmap.
+const std::size_t words = 1024;
+const uint32_t array_max = 4096;
+
+// Intervals in a List before Bitmap::suits considers it, and the fewest
+// intervals per container at which it does.
+const std::size_t suits_min_size = 1 << 16;
+const std::size_t suits_per_container = 1024;
+
+// Sets bits first to last, inclusive
+void set_range (uint64_t* bits, unsigned int first, unsigned int last)
+{
+    unsigned int first_word = first >> 6;
+    unsigned int last_word = last >> 6;
+    uint64_t first_mask = ~uint64_t(0) << (first & 63);
+    uint64_t last_mask = ~uint64_t(0) >> (63 - (last & 63));
+    if (first_word == last_word)
+    {
+	bits[first_word] |= first_mask & last_mask;
+	return;
+    }
+    bits[first_word] |= first_mask;
+    std::fill(bits + first_word + 1, bits + last_word, ~uint64_t(0));
+    bits[last_word] |= last_mask;
+}
+
+// Calls emit(first, last) for each run of set bits, in order
+template<typename EMIT>
+void scan_runs (const uint64_t* bits, EMIT emit)
+{
+    bool in_run = false;
+    unsigned int start = 0;
+    for (unsigned int index = 0 ; index < words ; ++index)
+    {
+	uint64_t word = bits[index];
+	unsigned int base = index * 64;
+
+	// Look for the next change: a one outside a run, a zero inside one
+	uint64_t changes = in_run ? ~word : word;
+	while (changes != 0)
+	{
+	    unsigned int bit = static_cast<unsigned int>(__builtin_ctzll(changes));
+	    if (in_run)
+		emit(start, base + bit - 1);
+	    else
+		start = base + bit;
+	    in_run = !in_run;
+	    changes = (in_run ? ~word : word) & (~uint64_t(0) << bit);
+	}
+    }
+    if (in_run) emit(start, 65535u);
+}
+
+// Releases the memory of a vector, not just its content
+template<typename T>
+void release (std::vector<T>& vec)
+{
+    std::vector<T>().swap(vec);
+}
+
+// The set operations. Each says what it does to a pair of words, and whether
+// containers that only this bitmap has, or only the other one, are kept.
+struct UnionOp
+{
+    static const bool keep_left = true;
+    static const bool keep_right = true;
+    static uint64_t word (uint64_t left, uint64_t right)
+        { return left | right; }
+#if defined(__x86_64__) && defined(__GNUC__)
+    __attribute__((target("avx2")))
+    static __m256i vec (__m256i left, __m256i right)
+        { return _mm256_or_si256(left, right); }
+#endif
+};
+
+struct IntersectionOp
+{
+    static const bool keep_left = false;
+    static const bool keep_right = false;
+    static uint64_t word (uint64_t left, uint64_t right)
+        { return left & right; }
+#if defined(__x86_64__) && defined(__GNUC__)
+    __attribute__((target("avx2")))
+    static __m256i vec (__m256i left, __m256i right)
+        { return _mm256_and_si256(left, right); }
+#endif
+};
+
+struct DifferenceOp
+{
+    static const bool keep_left = true;
+    static const bool keep_right = false;
+    static uint64_t word (uint64_t left, uint64_t right)
+        { return left & ~right; }
+#if defined(__x86_64__) && defined(__GNUC__)
+    __attribute__((target("avx2")))
+    static __m256i vec (__m256i left, __m256i right)
+        { return _mm256_andnot_si256(right, left); }
+#endif
+};
+
+struct SymmetricOp
+{
+    static const bool keep_left = true;
+    static const bool keep_right = true;
+    static uint64_t word (uint64_t left, uint64_t right)
+        { return left ^ right; }
+#if defined(__x86_64__) && defined(__GNUC__)
+    __attribute__((target("avx2")))
+    static __m256i vec (__m256i left, __m256i right)
+        { return _mm256_xor_si256(left, right); }
+#endif
+};
+
+// Applies an operation to the bitmap of a container, in place, and counts the
+// bits that are left.
+template<typename OP>
+uint32_t scalar_kernel (uint64_t* left, const uint64_t* right)
+{
+    uint32_t count = 0;
+    for (std::size_t index = 0 ; index < words ; ++index)
+    {
+	left[index] = OP::word(left[index], right[index]);
+	count += static_cast<uint32_t>(__builtin_popcountll(left[index]));
+    }
+    return count;
+}
+
+#if defined(__x86_64__) && defined(__GNUC__) // {
+
+// The same, four words at a time
+template<typename OP>
+__attribute__((target("avx2,popcnt")))
+uint32_t avx2_kernel (uint64_t* left, const uint64_t* right)
+{
+    uint32_t count = 0;
+    for (std::size_t index = 0 ; index < words ; index += 4)
+    {
+	__m256i* dest = reinterpret_cast<__m256i*>(left + index);
+	__m256i result = OP::vec(
+	    _mm256_loadu_si256(dest),
+	    _mm256_loadu_si256(reinterpret_cast<const __m256i*>(right + index)));
+	_mm256_storeu_si256(dest, result);
+	count += static_cast<uint32_t>(
+	    __builtin_popcountll(left[index]) +
+	    __builtin_popcountll(left[index + 1]) +
+	    __builtin_popcountll(left[index + 2]) +
+	    __builtin_popcountll(left[index + 3]));
+    }
+    return count;
+}
+
+bool detect_avx2()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+}
+const bool have_avx2 = detect_avx2();
+
+#endif // } __x86_64__
+
+template<typename OP>
+uint32_t kernel (uint64_t* left, const uint64_t* right)
+{
+#if defined(__x86_64__) && defined(__GNUC__)
+    if (have_avx2) return avx2_kernel<OP>(left, right);
+#endif
+    return scalar_kernel<OP>(left, right);
+}
+
+} // anonymous namespace
+
+///////////////////////////////////
+// Bitmap::Container implementation
+///////////////////////////////////
+
+void Bitmap::Container::to_words (uint64_t* bits) const
+{
+    if (mKind == Kbitmap)
+    {
+	std::memcpy(bits, mWords.data(), words * sizeof(uint64_t));
+	return;
+    }
+    std::fill(bits, bits + words, uint64_t(0));
+    if (mKind == Karray)
+    {
+	for (uint16_t value : mValues)
+	    bits[value >> 6] |= uint64_t(1) << (value & 63);
+    }
+    else
+    {
+	for (std::size_t index = 0 ; index < mValues.size() ; index += 2)
+	    set_range(bits, mValues[index], mValues[index + 1]);
+    }
+}
+
+void Bitmap::Container::from_words (const uint64_t* bits,
+                                    uint32_t cardinality)
+{
+    // Runs start wherever a bit is set and the one below it is not
+    std::size_t num_runs = 0;
+    uint64_t carry = 0;
+    for (std::size_t index = 0 ; index < words ; ++index)
+    {
+	uint64_t word = bits[index];
+	num_runs += static_cast<std::size_t>(
+	    __builtin_popcountll(word & ~((word << 1) | carry)));
+	carry = word >> 63;
+    }
+
+    mCardinality = cardinality;
+    std::size_t array_bytes = (cardinality <= array_max) ?
+        cardinality * sizeof(uint16_t) :
+        std::numeric_limits<std::size_t>::max();
+    std::size_t run_bytes = num_runs * 2 * sizeof(uint16_t);
+    std::size_t bitmap_bytes = words * sizeof(uint64_t);
+
+    if ((run_bytes <= array_bytes) && (run_bytes <= bitmap_bytes))
+    {
+	mKind = Kruns;
+	release(mWords);
+	mValues.clear();
+	mValues.reserve(num_runs * 2);
+	scan_runs(bits, [this](unsigned int first, unsigned int last) {
+	    mValues.push_back(static_cast<uint16_t>(first));
+	    mValues.push_back(static_cast<uint16_t>(last));
+	});
+    }
+    else if (array_bytes <= bitmap_bytes)
+    {
+	mKind = Karray;
+	release(mWords);
+	mValues.clear();
+	mValues.reserve(cardinality);
+	for (std::size_t index = 0 ; index < words ; ++index)
+	{
+	    for (uint64_t word = bits[index] ; word != 0 ; word &= word - 1)
+	    {
+		mValues.push_back(static_cast<uint16_t>(
+		    index * 64 +
+		    static_cast<std::size_t>(__builtin_ctzll(word))));
+	    }
+	}
+    }
+    else
+    {
+	mKind = Kbitmap;
+	release(mValues);
+	mWords.assign(bits, bits + words);
+    }
+}
+
+void Bitmap::Container::from_runs (const std::vector<uint16_t>& runs,
+                                   uint32_t cardinality)
+{
+    mCardinality = cardinality;
+    std::size_t array_bytes = (cardinality <= array_max) ?
+        cardinality * sizeof(uint16_t) :
+        std::numeric_limits<std::size_t>::max();
+    std::size_t run_bytes = runs.size() * sizeof(uint16_t);
+    std::size_t bitmap_bytes = words * sizeof(uint64_t);
+
+    if ((run_bytes <= array_bytes) && (run_bytes <= bitmap_bytes))
+    {
+	mKind = Kruns;
+	release(mWords);
+	mValues = runs;
+    }
+    else if (array_bytes <= bitmap_bytes)
+    {
+	mKind = Karray;
+	release(mWords);
+	mValues.clear();
+	mValues.reserve(cardinality);
+	for (std::size_t index = 0 ; index < runs.size() ; index += 2)
+	{
+	    for (unsigned int value = runs[index] ;
+	         value <= runs[index + 1] ; ++value)
+		mValues.push_back(static_cast<uint16_t>(value));
+	}
+    }
+    else
+    {
+	mKind = Kbitmap;
+	release(mValues);
+	mWords.assign(words, uint64_t(0));
+	for (std::size_t index = 0 ; index < runs.size() ; index += 2)
+	    set_range(mWords.data(), runs[index], runs[index + 1]);
+    }
+}
+
+template<typename EMIT>
+void Bitmap::Container::each_run (EMIT emit) const
+{
+    switch (mKind)
+    {
+    case Kruns:
+	for (std::size_t index = 0 ; index < mValues.size() ; index += 2)
+	    emit(mValues[index], mValues[index + 1]);
+	break;
+    case Karray:
+	for (std::size_t index = 0 ; index < mValues.size() ; )
+	{
+	    unsigned int first = mValues[index];
+	    unsigned int last = first;
+	    while ((++index < mValues.size()) && (mValues[index] == last + 1))
+		++last;
+	    emit(first, last);
+	}
+	break;
+    case Kbitmap:
+	scan_runs(mWords.data(), emit);
+	break;
+    }
+}
+
+bool Bitmap::Container::contains (uint16_t value) const
+{
+    switch (mKind)
+    {
+    case Karray:
+	return std::binary_search(mValues.cbegin(), mValues.cend(), value);
+    case Kbitmap:
+	return (mWords[value >> 6] >> (value & 63)) & 1;
+    case Kruns:
+	{
+	    // The last run that starts at or before value
+	    std::size_t low = 0;
+	    std::size_t high = mValues.size() / 2;
+	    while (low < high)
+	    {
+		std::size_t mid = (low + high) / 2;
+		if (mValues[mid * 2] <= value)
+		    low = mid + 1;
+		else
+		    high = mid;
+	    }
+	    return (low > 0) && (value <= mValues[low * 2 - 1]);
+	}
+    }
+    return false;
+}
+
+////////////////////////
+// Bitmap implementation
+////////////////////////
+
+Bitmap::Bitmap() noexcept
+ : mKeys(), mContainers()
+{
+}
+
+Bitmap::~Bitmap()
+{
+}
+
+Bitmap::Bitmap(Bitmap const& other) = default;
+Bitmap& Bitmap::operator=(Bitmap const& other) = default;
+Bitmap::Bitmap(Bitmap&& other) noexcept = default;
+Bitmap& Bitmap::operator=(Bitmap&& other) noexcept = default;
+
+Bitmap::Bitmap(const List& list)
+ : mKeys(), mContainers()
+{
+    // Gather the runs of each container, then let it pick its form
+    std::vector<uint16_t> runs;
+    uint32_t cardinality = 0;
+    uint32_t key = 0;
+    bool open = false;
+    auto finish = [&]() {
+	mKeys.push_back(static_cast<uint16_t>(key));
+	mContainers.emplace_back();
+	mContainers.back().from_runs(runs, cardinality);
+	runs.clear();
+	cardinality = 0;
+    };
+
+    for (auto iter = list.cbegin() ; iter != list.cend() ; ++iter)
+    {
+	uint32_t lower = iter->first;
+	uint32_t upper = iter->second;
+	for (;;)
+	{
+	    if (open && ((lower >> 16) != key)) finish();
+	    key = lower >> 16;
+	    open = true;
+	    uint32_t last = std::min(upper, lower | 0xFFFF);
+	    runs.push_back(static_cast<uint16_t>(lower));
+	    runs.push_back(static_cast<uint16_t>(last));
+	    cardinality += last - lower + 1;
+	    if (last == upper) break;
+	    lower = last + 1;
+	}
+    }
+    if (open) finish();
+}
+
+void Bitmap::add_to (List& list) const
+{
+    // Runs that meet across containers become one interval
+    std::vector<std::pair<uint32_t,uint32_t>> intervals;
+    for (std::size_t index = 0 ; index < mKeys.size() ; ++index)
+    {
+	uint32_t base = uint32_t(mKeys[index]) << 16;
+	mContainers[index].each_run(
+	    [base, &intervals](unsigned int first, unsigned int last) {
+		uint32_t lower = base | first;
+		uint32_t upper = base | last;
+		if (!intervals.empty() && (intervals.back().second + 1 == lower))
+		    intervals.back().second = upper;
+		else
+		    intervals.emplace_back(lower, upper);
+	    });
+    }
+    list.add_sorted(intervals.data(), intervals.data() + intervals.size());
+}
+
+template<typename OP>
+void Bitmap::combine (const Bitmap& other)
+{
+    std::vector<uint16_t> keys;
+    std::vector<Container> containers;
+    keys.reserve(mKeys.size() + other.mKeys.size());
+    containers.reserve(mKeys.size() + other.mKeys.size());
+    std::vector<uint64_t> left(words);
+    std::vector<uint64_t> right(words);
+
+    std::size_t mine = 0;
+    std::size_t theirs = 0;
+    while ((mine < mKeys.size()) || (theirs < other.mKeys.size()))
+    {
+	if ((theirs == other.mKeys.size()) ||
+	    ((mine < mKeys.size()) && (mKeys[mine] < other.mKeys[theirs])))
+	{
+	    if (OP::keep_left)
+	    {
+		keys.push_back(mKeys[mine]);
+		containers.push_back(std::move(mContainers[mine]));
+	    }
+	    ++mine;
+	}
+	else if ((mine == mKeys.size()) || (other.mKeys[theirs] < mKeys[mine]))
+	{
+	    if (OP::keep_right)
+	    {
+		keys.push_back(other.mKeys[theirs]);
+		containers.push_back(other.mContainers[theirs]);
+	    }
+	    ++theirs;
+	}
+	else
+	{
+	    mContainers[mine].to_words(left.data());
+	    other.mContainers[theirs].to_words(right.data());
+	    uint32_t cardinality = kernel<OP>(left.data(), right.data());
+	    if (cardinality != 0)
+	    {
+		keys.push_back(mKeys[mine]);
+		containers.emplace_back();
+		containers.back().from_words(left.data(), cardinality);
+	    }
+	    ++mine;
+	    ++theirs;
+	}
+    }
+
+    mKeys.swap(keys);
+    mContainers.swap(containers);
+}
+
+void Bitmap::set_union (const Bitmap& other)
+{
+    combine<UnionOp>(other);
+}
+
+void Bitmap::set_intersection (const Bitmap& other)
+{
+    combine<IntersectionOp>(other);
+}
+
+void Bitmap::set_difference (const Bitmap& other)
+{
+    combine<DifferenceOp>(other);
+}
+
+void Bitmap::set_symmetric_difference (const Bitmap& other)
+{
+    combine<SymmetricOp>(other);
+}
+
+bool Bitmap::contains (uint32_t address) const
+{
+    auto iter = std::lower_bound(mKeys.cbegin(), mKeys.cend(),
+                                 static_cast<uint16_t>(address >> 16));
+    if ((iter == mKeys.cend()) || (*iter != (address >> 16))) return false;
+    return mContainers[static_cast<std::size_t>(iter - mKeys.cbegin())]
+        .contains(static_cast<uint16_t>(address));
+}
+
+uint64_t Bitmap::cardinality() const
+{
+    uint64_t total = 0;
+    for (const Container& container : mContainers)
+	total += container.mCardinality;
+    return total;
+}
+
+std::size_t Bitmap::memory_used() const
+{
+    std::size_t total = sizeof(*this) +
+        mKeys.capacity() * sizeof(uint16_t) +
+        mContainers.capacity() * sizeof(Container);
+    for (const Container& container : mContainers)
+    {
+	total += container.mValues.capacity() * sizeof(uint16_t) +
+	         container.mWords.capacity() * sizeof(uint64_t);
+    }
+    return total;
+}
+
+bool Bitmap::suits (const List& list)
+{
+    if (list.size() < suits_min_size) return false;
+
+    // Count the containers that the list reaches into
+    std::size_t containers = 0;
+    uint32_t last_key = 0;
+    bool any = false;
+    for (auto iter = list.cbegin() ; iter != list.cend() ; ++iter)
+    {
+	uint32_t first_key = iter->first >> 16;
+	uint32_t end_key = iter->second >> 16;
+	containers += end_key - first_key + 1;
+	if (any && (first_key == last_key)) --containers;
+	last_key = end_key;
+	any = true;
+    }
+    return list.size() >= containers * suits_per_container;
+}
+
+} // namespace IPAR
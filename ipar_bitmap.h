@@ -0,0 +1,102 @@
+////////////////////////////////////////////////////////
+// A compressed bitmap of IPv4 addresses, for sets that
+// are dense and badly fragmented.
+////////////////////////////////////////////////////////
+
+#ifndef IPAR_BITMAP_H_ // {
+#define IPAR_BITMAP_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "ipar_iplist.h"
+
+namespace IPAR {
+
+// A set of IP addresses, in the style of a roaring bitmap. The address space
+// is split into containers of 64K addresses, keyed by the upper 16 bits. Each
+// container that is not empty holds its lower 16 bits in whichever form is
+// smallest: a sorted array of up to 4096 values, a bitmap of 8 KB, or a list
+// of runs. Set operations work container by container, on 1024 words at a
+// time (AVX2 where the processor has it), so their cost depends on how much
+// of the address space is in use rather than on how fragmented it is.
+class Bitmap
+{
+public:
+
+    // The automatic methods
+    Bitmap() noexcept;
+    ~Bitmap();
+    Bitmap(Bitmap const& other);
+    Bitmap& operator=(Bitmap const& other);
+    Bitmap(Bitmap&& other) noexcept;
+    Bitmap& operator=(Bitmap&& other) noexcept;
+
+    // Conversion from and to a List. Nothing is lost either way.
+    explicit Bitmap(const List& list);
+    void add_to (List& list) const;
+
+    // Set algebra. This bitmap becomes its union, intersection, difference
+    // or symmetric difference with the other one.
+    void set_union (const Bitmap& other);
+    void set_intersection (const Bitmap& other);
+    void set_difference (const Bitmap& other);
+    void set_symmetric_difference (const Bitmap& other);
+
+    bool contains (uint32_t address) const;
+    bool empty() const { return mKeys.empty(); }
+
+    // Number of addresses
+    uint64_t cardinality() const;
+
+    // For diagnostic use: bytes held, and containers in each form.
+    std::size_t memory_used() const;
+    std::size_t num_containers() const { return mKeys.size(); }
+
+    // Whether a list is fragmented enough, for its size, that set operations
+    // are cheaper as a Bitmap.
+    static bool suits (const List& list);
+
+private:
+
+    struct Container
+    {
+	enum Kind : uint8_t {
+	    Karray,         // mValues holds sorted values
+	    Kbitmap,        // mWords holds 1024 words
+	    Kruns           // mValues holds first and last of each run
+	};
+	// Bits set for each value, in 1024 words
+	void to_words (uint64_t* words) const;
+
+	// Take the smallest form for the given content
+	void from_words (const uint64_t* words, uint32_t cardinality);
+	void from_runs (const std::vector<uint16_t>& runs,
+	                uint32_t cardinality);
+
+	// Calls emit(first, last) for each run, in order
+	template<typename EMIT>
+	void each_run (EMIT emit) const;
+
+	bool contains (uint16_t value) const;
+
+	Kind mKind;
+	uint32_t mCardinality;
+	std::vector<uint16_t> mValues;
+	std::vector<uint64_t> mWords;
+    };
+
+    // The set operations, one container at a time. OP supplies the
+    // operation on words and says what becomes of containers that only one
+    // side has.
+    template<typename OP>
+    void combine (const Bitmap& other);
+
+    std::vector<uint16_t> mKeys;            // Upper 16 bits, sorted
+    std::vector<Container> mContainers;     // In the order of mKeys
+
+}; // class Bitmap
+
+} // namespace IPAR
+
+#endif // } IPAR_BITMAP_H_
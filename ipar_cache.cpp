@@ -0,0 +1,286 @@
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "ipar_cache.h"
+#include "ipar_common.h"
+#include "ipar_snapshot.h"
+#include "ipar_threads.h"
+
+namespace IPAR {
+
+namespace { // anonymous
+
+// Where cache entries go. Empty if there is no suitable place.
+std::string cache_directory()
+{
+    std::string base;
+    const char* env = std::getenv("XDG_CACHE_HOME");
+    if ((env != nullptr) && (env[0] == '/'))
+    {
+	base = env;
+    }
+    else
+    {
+	env = std::getenv("HOME");
+	if ((env == nullptr) || (env[0] == '\0')) return "";
+	base = std::string(env) + "/.cache";
+    }
+    mkdir(base.c_str(), 0700);
+    std::string dir = base + "/iprange";
+    mkdir(dir.c_str(), 0700);
+    return dir;
+}
+
+// Size of the path, once padded
+std::size_t padded (std::size_t length)
+{
+    return (length + 7) & ~static_cast<std::size_t>(7);
+}
+
+// Checks a cache entry against the original file. If it matches, returns a
+// view of the snapshot it contains. Otherwise returns an empty view.
+std::string_view cached_snapshot (std::string_view entry,
+                                  const CacheHeader& wanted,
+				  const std::string& path)
+{
+    CacheHeader header;
+    if (entry.size() < sizeof(header)) return std::string_view();
+    std::memcpy(&header, entry.data(), sizeof(header));
+    if ((std::memcmp(header.mMagic, cache_magic, sizeof(cache_magic)) != 0) ||
+        (header.mFileSize != wanted.mFileSize) ||
+	(header.mModSeconds != wanted.mModSeconds) ||
+	(header.mModNanoseconds != wanted.mModNanoseconds) ||
+	(header.mContentHash != wanted.mContentHash) ||
+	(header.mPathLength != path.size()))
+	return std::string_view();
+    std::size_t offset = sizeof(header) + padded(path.size());
+    if ((entry.size() < offset) ||
+        (entry.substr(sizeof(header), path.size()) != path))
+	return std::string_view();
+    return entry.substr(offset);
+}
+
+// Writes a cache entry. The entry appears all at once, by renaming a
+// temporary file, so readers never see a partial entry.
+bool write_entry (const std::string& entry_name, const CacheHeader& header,
+                  const std::string& path, const List& iplist,
+                  const List6& iplist6)
+{
+    std::ostringstream tmp;
+    tmp << entry_name << ".tmp." << getpid() << '.'
+        << std::this_thread::get_id();
+    std::string tmp_name = tmp.str();
+    {
+	std::ofstream ofs(tmp_name, std::ofstream::binary);
+	if (!ofs) return false;
+	ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	std::string padded_path(path);
+	padded_path.resize(padded(path.size()), '\0');
+	ofs.write(padded_path.data(),
+	          static_cast<std::streamsize>(padded_path.size()));
+	write_snapshot(ofs, iplist, iplist6);
+	if (!ofs)
+	{
+	    std::remove(tmp_name.c_str());
+	    return false;
+	}
+    }
+    if (std::rename(tmp_name.c_str(), entry_name.c_str()) != 0)
+    {
+	std::remove(tmp_name.c_str());
+	return false;
+    }
+    return true;
+}
+
+} // namespace anonymous
+
+
+/////////////////////////////////////
+// Implementation of FileCache class
+/////////////////////////////////////
+
+FileCache::FileCache(bool enabled)
+ : mEnabled(enabled), mDirectory{}, mHits(0), mMisses(0)
+{
+    if (mEnabled) mDirectory = cache_directory();
+    if (mEnabled && mDirectory.empty())
+    {
+	diagnostics() << "WARNING: no cache directory, cache disabled"
+		      << std::endl;
+	mEnabled = false;
+    }
+}
+
+int FileCache::read (const std::string& filename, List& iplist,
+                     unsigned int jobs)
+{
+    return read_lists(filename, iplist, nullptr, jobs);
+}
+
+int FileCache::read (const std::string& filename, List& iplist,
+                     List6& iplist6, unsigned int jobs)
+{
+    return read_lists(filename, iplist, &iplist6, jobs);
+}
+
+int FileCache::read_lists (const std::string& filename, List& iplist,
+                           List6* iplist6, unsigned int jobs)
+{
+    if (!mEnabled)
+    {
+	return (iplist6 == nullptr) ? file_read(filename, iplist, jobs) :
+	    file_read(filename, iplist, *iplist6, jobs);
+    }
+
+    IPAR::MappedText text(filename);
+    struct stat st;
+    char resolved[PATH_MAX];
+    if (!text || (stat(filename.c_str(), &st) != 0) ||
+        (realpath(filename.c_str(), resolved) == nullptr))
+    {
+        diagnostics() << "ERROR: could not open input file \"" << filename
+                      << "\" for reading" << std::endl;
+	return 1;
+    }
+    std::string where = "\"" + filename + "\"";
+
+    // A snapshot is already as good as it gets
+    if (Snapshot::detect(text.view()))
+    {
+	return (iplist6 == nullptr) ?
+	    view_read(text.view(), iplist, jobs, where) :
+	    view_read(text.view(), iplist, *iplist6, jobs, where);
+    }
+
+    // Describe the file as it is now
+    std::string path(resolved);
+    CacheHeader wanted;
+    std::memcpy(wanted.mMagic, cache_magic, sizeof(cache_magic));
+    wanted.mFileSize = static_cast<uint64_t>(st.st_size);
+    wanted.mModSeconds = st.st_mtim.tv_sec;
+    wanted.mModNanoseconds = st.st_mtim.tv_nsec;
+    wanted.mContentHash = hash64(text.view().data(), text.view().size());
+    wanted.mPathLength = path.size();
+
+    std::ostringstream name;
+    name << mDirectory << '/' << std::hex << hash64(path.data(), path.size())
+         << ".snap";
+    std::string entry_name = name.str();
+
+    // Look for a matching entry
+    {
+	IPAR::MappedText entry(entry_name);
+	std::string_view snapshot;
+	if (entry) snapshot = cached_snapshot(entry.view(), wanted, path);
+	if (!snapshot.empty())
+	{
+	    try {
+		Snapshot snap(snapshot);
+
+		// An entry with IPv6 content is of no use without iplist6.
+		// Parsing reports the error.
+		if ((snap.size6() == 0) || (iplist6 != nullptr))
+		{
+		    iplist.add_sorted(snap.begin(), snap.end());
+		    if (snap.size6() != 0)
+		    {
+			auto entries6 = snap.entries6();
+			iplist6->add_batch(entries6);
+		    }
+		    ++mHits;
+		    return 0;
+		}
+	    }
+	    catch (const std::exception&) {
+		// Damaged entry, will be replaced.
+	    }
+	}
+    }
+
+    // Parse the original, and remember the result
+    ++mMisses;
+    List parsed;
+    List6 parsed6;
+    int retval = (iplist6 == nullptr) ?
+	view_read(text.view(), parsed, jobs, where) :
+	view_read(text.view(), parsed, parsed6, jobs, where);
+    if (retval != 0) return retval;
+    if (!write_entry(entry_name, wanted, path, parsed, parsed6))
+    {
+	diagnostics() << "WARNING: could not write cache file \"" << entry_name
+		      << "\"" << std::endl;
+    }
+    if (iplist.empty())
+	iplist.swap(parsed);
+    else
+	iplist.add_list(parsed);
+    if (iplist6 == nullptr) return 0;
+    if (iplist6->empty())
+	iplist6->swap(parsed6);
+    else
+	iplist6->add_list(parsed6);
+    return 0;
+}
+
+int FileCache::read_all (const std::vector<std::string>& filenames,
+                         List& iplist, List6& iplist6, unsigned int jobs)
+{
+    if (filenames.empty()) return 0;
+
+    // One file per thread. Any threads left over help parse each file.
+    unsigned int files_at_once = static_cast<unsigned int>(
+        std::min<std::size_t>(std::max(jobs, 1u), filenames.size()));
+    unsigned int jobs_per_file = std::max(jobs / files_at_once, 1u);
+
+    std::vector<List> lists(filenames.size());
+    std::vector<List6> lists6(filenames.size());
+    std::vector<std::ostringstream> messages(filenames.size());
+    std::vector<int> results(filenames.size(), 0);
+    parallel_for (files_at_once, filenames.size(), [&](std::size_t index)
+    {
+	DiagnosticsTo to(messages[index]);
+	results[index] = read(filenames[index], lists[index], lists6[index],
+	                      jobs_per_file);
+    });
+
+    // Pass the messages on in file order, up to the first failure
+    for (std::size_t index = 0 ; index < filenames.size() ; ++index)
+    {
+	diagnostics() << messages[index].str() << std::flush;
+	if (results[index] != 0) return results[index];
+    }
+
+    // Merge, always folding the smaller list into the larger one
+    parallel_reduce (files_at_once, lists, [](List& into, List& from)
+    {
+	if (into.size() < from.size()) into.swap(from);
+	into.add_list(from);
+	from = List();
+    });
+    parallel_reduce (files_at_once, lists6, [](List6& into, List6& from)
+    {
+	if (into.size() < from.size()) into.swap(from);
+	into.add_list(from);
+	from = List6();
+    });
+    if (iplist.empty())
+	iplist.swap(lists[0]);
+    else
+	iplist.add_list(lists[0]);
+    if (iplist6.empty())
+	iplist6.swap(lists6[0]);
+    else
+	iplist6.add_list(lists6[0]);
+    return 0;
+}
+
+} // namespace IPAR
@@ -0,0 +1,84 @@
+////////////////////////////////////////////////////////
+// An on-disk cache of parsed input files. Each cached
+// file is stored as a binary snapshot.
+////////////////////////////////////////////////////////
+
+#ifndef IPAR_CACHE_H_ // {
+#define IPAR_CACHE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "ipar_iplist.h"
+#include "ipar_list6.h"
+
+namespace IPAR {
+
+// Layout of a cache entry: a CacheHeader, then the path of the original file,
+// padded with zeros to a multiple of eight bytes, then a snapshot of its
+// content. An entry is used only if the path, size, modification time and
+// content hash (hash64) of the original file all match.
+const char cache_magic[8] = { 'I', 'P', 'A', 'R', 'C', 'A', 'C', 'H' };
+
+struct CacheHeader
+{
+    char mMagic[8];
+    uint64_t mFileSize;
+    int64_t mModSeconds;
+    int64_t mModNanoseconds;
+    uint64_t mContentHash;
+    uint64_t mPathLength;
+};
+
+// Reads files the same way as file_read (see ipar_common.h), but keeps a
+// copy of each parsed file in a cache directory. The directory is
+// $XDG_CACHE_HOME/iprange, or $HOME/.cache/iprange.
+class FileCache
+{
+public:
+
+    // The automatic methods
+    FileCache() = delete;
+    ~FileCache() = default;
+    FileCache(FileCache const& other) = delete;
+    FileCache& operator=(FileCache const& other) = delete;
+    FileCache(FileCache&& other) = delete;
+    FileCache& operator=(FileCache&& other) = delete;
+
+    // If enabled is false, reads go straight to file_read.
+    FileCache(bool enabled);
+
+    // Same arguments and return value as file_read.
+    int read (const std::string& filename, List& iplist, unsigned int jobs = 1);
+    int read (const std::string& filename, List& iplist, List6& iplist6,
+              unsigned int jobs = 1);
+
+    // Reads several files at once, each into lists of its own on one of up
+    // to "jobs" threads, then merges those pairwise and adds the result to
+    // iplist and iplist6. Messages come out as if the files had been read
+    // one after another: in order, and stopping at the first file that
+    // fails. Returns what read returned for that file, or zero.
+    int read_all (const std::vector<std::string>& filenames, List& iplist,
+                  List6& iplist6, unsigned int jobs = 1);
+
+    // Statistics
+    unsigned long hits() const { return mHits; }
+    unsigned long misses() const { return mMisses; }
+
+private:
+
+    // Shared by both kinds of read. Without iplist6, IPv4 only.
+    int read_lists (const std::string& filename, List& iplist, List6* iplist6,
+                    unsigned int jobs);
+
+    bool mEnabled;
+    std::string mDirectory;
+    std::atomic<unsigned long> mHits;
+    std::atomic<unsigned long> mMisses;
+
+}; // class FileCache
+
+} // namespace IPAR
+
+#endif //  } IPAR_CACHE_H_
@@ -1,10 +1,278 @@
 #include <exception>
 #include <iostream>
 #include <istream>
+#include <algorithm>
+#include <cerrno>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "ipar_common.h"
+#include "ipar_snapshot.h"
+#include "ipar_threads.h"
 
 namespace IPAR {
 
+namespace { // anonymous
+
+// Where diagnostics go on this thread. Null for std::cerr.
+thread_local std::ostream* diagnostics_stream = nullptr;
+
+// Same as isspace() in the "C" locale, which is what operator>> uses.
+inline bool is_space (char c)
+{
+    return (c == ' ') || ((c >= '\t') && (c <= '\r'));
+}
+
+// Reports a word that could not be parsed
+void report_error (const std::string& what, unsigned int line_no,
+    std::string_view line, std::string_view word, const std::string& where)
+{
+    diagnostics() << "ERROR: " << what << " at line "
+		  << line_no << " of " << where << ": " << std::endl;
+    diagnostics() << line << std::endl;
+    diagnostics() << "Last input was \"" << word << "\"" << std::endl;
+}
+
+// Parsed ranges are collected into batches of this size before they are added
+// to a list.
+const std::size_t batch_size = 1 << 20;
+
+// Parsed ranges waiting to be added, for IPv4 and IPv6. Without a list for
+// IPv6, every word is taken to be IPv4.
+class Batches
+{
+public:
+
+    Batches(List& iplist, List6* iplist6)
+     : mList(iplist), mList6(iplist6), mBatch(), mBatch6() { }
+
+    // Parses a word. Throws as parse_range and parse_range6 do.
+    void add (std::string_view word)
+    {
+	if ((mList6 != nullptr) && is_ipv6(word))
+	{
+	    mBatch6.push_back(IPAR::parse_range6(word));
+	    if (mBatch6.size() == batch_size) mList6->add_batch(mBatch6);
+	}
+	else
+	{
+	    mBatch.push_back(IPAR::parse_range(word));
+	    if (mBatch.size() == batch_size) mList.add_batch(mBatch);
+	}
+    }
+
+    // Adds whatever is left
+    void finish()
+    {
+	mList.add_batch(mBatch);
+	if (mList6 != nullptr) mList6->add_batch(mBatch6);
+    }
+
+private:
+
+    List& mList;
+    List6* mList6;
+    std::vector<std::pair<uint32_t,uint32_t>> mBatch;
+    std::vector<std::pair<uint128_t,uint128_t>> mBatch6;
+
+}; // class Batches
+
+// Shared by the common_read variants. Parses every word from the reader and
+// adds it to the lists. Errors are reported with the name of the input.
+template<typename READER, typename WORD>
+int read_words (READER& reader, List& iplist, List6* iplist6,
+                const std::string& where)
+{
+    WORD word;
+    Batches batches(iplist, iplist6);
+    while (reader >> word)
+    {
+	try {
+	    batches.add(word);
+	}
+	catch (const std::exception& ex) {
+	    report_error (ex.what(), reader.line_no(), reader.current_line(),
+	                  word, where);
+	    return 1;
+	}
+    }
+    batches.finish();
+
+    return 0;
+}
+
+// Below this size, input is not worth splitting up
+const std::size_t min_chunk = 1 << 16;
+
+// The first error found in one chunk of input, if any
+struct ChunkError
+{
+    bool mFound;
+    std::string mWhat;
+    unsigned int mLineNo;
+    std::string_view mLine;
+    std::string_view mWord;
+};
+
+// Parses text, splitting it up among threads. Each thread parses a chunk of
+// whole lines into its own list. Then the lists are merged pairwise. If
+// there are errors, only the first one in input order is reported, just as
+// if the text had been parsed in a single pass.
+int read_text (std::string_view text, List& iplist, List6* iplist6,
+               unsigned int jobs, const std::string& where)
+{
+    if ((jobs <= 1) || (text.size() < 2 * min_chunk))
+    {
+	IPAR::ViewReader reader(text);
+	return read_words<IPAR::ViewReader, std::string_view>(
+	    reader, iplist, iplist6, where);
+    }
+
+    // Split at line boundaries
+    std::vector<std::string_view> chunks;
+    std::size_t begin = 0;
+    for (unsigned int job = 1 ; (job <= jobs) && (begin < text.size()) ; ++job)
+    {
+	std::size_t end = text.size();
+	if (job < jobs)
+	{
+	    std::size_t guess = (text.size() / jobs) * job;
+	    if (guess < begin) guess = begin;
+	    end = text.find('\n', guess);
+	    end = (end == std::string_view::npos) ? text.size() : end + 1;
+	}
+	chunks.push_back(text.substr(begin, end - begin));
+	begin = end;
+    }
+
+    // Parse chunks
+    std::vector<List> lists(chunks.size());
+    std::vector<List6> lists6(chunks.size());
+    std::vector<ChunkError> errors(chunks.size());
+    parallel_for (jobs, chunks.size(), [&](std::size_t index)
+    {
+	IPAR::ViewReader reader(chunks[index]);
+	ChunkError& error = errors[index];
+	error.mFound = false;
+	std::string_view word;
+	Batches batches(lists[index],
+	                (iplist6 != nullptr) ? &lists6[index] : nullptr);
+	while (reader >> word)
+	{
+	    try {
+		batches.add(word);
+	    }
+	    catch (const std::exception& ex) {
+		error = ChunkError {
+		    true, ex.what(), reader.line_no(), reader.current_line(),
+		    word };
+		return;
+	    }
+	}
+	batches.finish();
+    });
+
+    // Report the first error, with line numbers counted from the start
+    unsigned int lines_before = 0;
+    for (std::size_t index = 0 ; index < chunks.size() ; ++index)
+    {
+	const ChunkError& error = errors[index];
+	if (error.mFound)
+	{
+	    report_error (error.mWhat, lines_before + error.mLineNo,
+	                  error.mLine, error.mWord, where);
+	    return 1;
+	}
+	lines_before += static_cast<unsigned int>(
+	    std::count(chunks[index].begin(), chunks[index].end(), '\n'));
+    }
+
+    // Merge, always folding the smaller list into the larger one
+    parallel_reduce (jobs, lists, [](List& into, List& from)
+    {
+	if (into.size() < from.size()) into.swap(from);
+	into.add_list(from);
+	from = List();
+    });
+    if (iplist.empty())
+	iplist.swap(lists[0]);
+    else
+	iplist.add_list(lists[0]);
+    if (iplist6 != nullptr)
+    {
+	parallel_reduce (jobs, lists6, [](List6& into, List6& from)
+	{
+	    if (into.size() < from.size()) into.swap(from);
+	    into.add_list(from);
+	    from = List6();
+	});
+	if (iplist6->empty())
+	    iplist6->swap(lists6[0]);
+	else
+	    iplist6->add_list(lists6[0]);
+    }
+
+    return 0;
+}
+
+// Shared by the view_read variants
+int read_view (std::string_view text, List& iplist, List6* iplist6,
+               unsigned int jobs, const std::string& where)
+{
+    if (Snapshot::detect(text))
+    {
+	try {
+	    Snapshot snapshot(text);
+	    if ((snapshot.size6() != 0) && (iplist6 == nullptr))
+		throw snapshot_error();
+	    iplist.add_sorted(snapshot.begin(), snapshot.end());
+	    if (snapshot.size6() != 0)
+	    {
+		auto entries6 = snapshot.entries6();
+		iplist6->add_batch(entries6);
+	    }
+	}
+	catch (const std::exception& ex) {
+	    diagnostics() << "ERROR: " << ex.what() << " from " << where
+			  << std::endl;
+	    return 1;
+	}
+	return 0;
+    }
+    return read_text(text, iplist, iplist6, jobs, where);
+}
+
+int read_fd (int fd, List& iplist, List6* iplist6, unsigned int jobs)
+{
+    IPAR::MappedText text(fd);
+    if (!text)
+    {
+	diagnostics() << "ERROR: could not read input" << std::endl;
+	return 1;
+    }
+
+    return read_view(text.view(), iplist, iplist6, jobs, "input");
+}
+
+int read_file (const std::string& filename, List& iplist, List6* iplist6,
+               unsigned int jobs)
+{
+    IPAR::MappedText text(filename);
+    if (!text)
+    {
+        diagnostics() << "ERROR: could not open input file \"" << filename
+                      << "\" for reading" << std::endl;
+	return 1;
+    }
+
+    return read_view(text.view(), iplist, iplist6, jobs,
+                     "\"" + filename + "\"");
+}
+
+} // namespace anonymous
+
 
 OutputStyle o_style (const std::string& arg)
 {
@@ -22,6 +290,14 @@ OutputStyle o_style (const std::string& arg)
     {
 	style = Shex;
     }
+    else if (arg == "-binary")
+    {
+	style = Sbinary;
+    }
+    else if (arg == "-raw")
+    {
+	style = Sraw;
+    }
     else
     {
 	style = Sunknown;
@@ -29,6 +305,18 @@ OutputStyle o_style (const std::string& arg)
     return style;
 }
 
+unsigned int o_jobs (const std::string& arg)
+{
+    unsigned long jobs = 0;
+    for (char digit : arg)
+    {
+	if ((digit < '0') || (digit > '9')) return 0;
+	jobs = (jobs * 10) + static_cast<unsigned long>(digit - '0');
+	if (jobs > max_jobs) return 0;
+    }
+    return static_cast<unsigned int>(jobs);
+}
+
 //////////////////////////////////////
 // Implementation of TextReader class
 //////////////////////////////////////
@@ -82,17 +370,184 @@ unsigned int TextReader::line_no() const
 }
 
 
+//////////////////////////////////////
+// Implementation of MappedText class
+//////////////////////////////////////
+
+MappedText::MappedText(int fd)
+ : mMap(MAP_FAILED), mMapLength(0), mBuffer{}, mView{}, mOk(false)
+{
+    load(fd);
+}
+
+MappedText::MappedText(const std::string& filename)
+ : mMap(MAP_FAILED), mMapLength(0), mBuffer{}, mView{}, mOk(false)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    load(fd);
+    close(fd);
+}
+
+MappedText::~MappedText()
+{
+    if (mMap != MAP_FAILED) munmap(mMap, mMapLength);
+}
+
+void MappedText::load(int fd)
+{
+    // Regular files are mapped. Mapping starts at offset zero, which is
+    // always page aligned, and the view skips anything already consumed.
+    struct stat st;
+    if ((fstat(fd, &st) == 0) && S_ISREG(st.st_mode))
+    {
+	off_t offset = lseek(fd, 0, SEEK_CUR);
+	if (offset < 0) offset = 0;
+	if (st.st_size <= offset)
+	{
+	    // Nothing to read. Not an error.
+	    mOk = true;
+	    return;
+	}
+	std::size_t length = static_cast<std::size_t>(st.st_size);
+	void* map = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map != MAP_FAILED)
+	{
+	    madvise(map, length, MADV_SEQUENTIAL);
+	    mMap = map;
+	    mMapLength = length;
+	    std::size_t start = static_cast<std::size_t>(offset);
+	    mView = std::string_view(
+	        static_cast<const char*>(map) + start, length - start);
+	    mOk = true;
+	    return;
+	}
+	// Fall through and read
+    }
+
+    // Pipes, terminals, etc.
+    static const std::size_t chunk = 1 << 20;
+    std::size_t used = 0;
+    while (true)
+    {
+	mBuffer.resize(used + chunk);
+	ssize_t count = read(fd, &mBuffer[used], chunk);
+	if (count < 0)
+	{
+	    if (errno == EINTR) continue;
+	    mBuffer.clear();
+	    return;
+	}
+	if (count == 0) break;
+	used += static_cast<std::size_t>(count);
+    }
+    mBuffer.resize(used);
+    mView = mBuffer;
+    mOk = true;
+}
+
+
+////////////////////////////////////////
+// Implementation of SnapshotFile class
+////////////////////////////////////////
+
+SnapshotFile::SnapshotFile(const std::string& filename)
+ : mText(), mSnapshot()
+{
+    struct stat st;
+    if ((stat(filename.c_str(), &st) != 0) || !S_ISREG(st.st_mode)) return;
+    mText = std::make_unique<MappedText>(filename);
+    if (!*mText || !Snapshot::detect(mText->view())) return;
+    try {
+	mSnapshot = std::make_unique<Snapshot>(mText->view());
+    }
+    catch (const std::exception&) {
+	// Left for reading as usual, which reports it
+    }
+}
+
+
+/////////////////////////////////////////
+// Implementation of DiagnosticsTo class
+/////////////////////////////////////////
+
+DiagnosticsTo::DiagnosticsTo(std::ostream& ost)
+ : mPrevious(diagnostics_stream)
+{
+    diagnostics_stream = &ost;
+}
+
+DiagnosticsTo::~DiagnosticsTo()
+{
+    diagnostics_stream = mPrevious;
+}
+
+
+//////////////////////////////////////
+// Implementation of ViewReader class
+//////////////////////////////////////
+
+ViewReader::ViewReader(std::string_view text)
+ : mPos(text.data()), mEnd(text.data() + text.size()), mLine(text.data()),
+   mLineNo(1), mOk(true)
+{
+}
+
+ViewReader& ViewReader::operator>> (std::string_view& word)
+{
+    while (mOk)
+    {
+	// Skip white space, keeping track of lines
+	while ((mPos != mEnd) && is_space(*mPos))
+	{
+	    if (*mPos == '\n')
+	    {
+		mLine = mPos + 1;
+		++mLineNo;
+	    }
+	    ++mPos;
+	}
+	if (mPos == mEnd)
+	{
+	    mOk = false;
+	    break;
+	}
+
+	// Ignore comments to end of line
+	if (*mPos == '#')
+	{
+	    while ((mPos != mEnd) && (*mPos != '\n')) ++mPos;
+	    continue;
+	}
+
+	// Found a word
+	const char* start = mPos;
+	while ((mPos != mEnd) && !is_space(*mPos)) ++mPos;
+	word = std::string_view(start, static_cast<std::size_t>(mPos - start));
+	break;
+    }
+    return *this;
+}
+
+std::string_view ViewReader::current_line() const
+{
+    const char* stop = mLine;
+    while ((stop != mEnd) && (*stop != '\n')) ++stop;
+    return std::string_view(mLine, static_cast<std::size_t>(stop - mLine));
+}
+
+
 //////////////////////////////////////
 // Implementation of FileReader class
 //////////////////////////////////////
 
 FileReader::FileReader(const std::string& filename)
- : mIfs(filename, std::ifstream::in), mTr(mIfs)
+ : mMt(filename), mVr(mMt.view())
 {
-    if (!mIfs)
+    if (!mMt)
     {
-        std::cerr << "ERROR: could not open input file \"" << filename
-                  << "\" for reading" << std::endl;
+        diagnostics() << "ERROR: could not open input file \"" << filename
+                      << "\" for reading" << std::endl;
     }
 }
 
@@ -101,29 +556,57 @@ FileReader::FileReader(const std::string& filename)
 // Implementation of stand-alone functions
 ///////////////////////////////////////////
 
+std::ostream& diagnostics()
+{
+    return (diagnostics_stream != nullptr) ? *diagnostics_stream : std::cerr;
+}
+
 int common_read (std::istream& ist, List& iplist)
 {
     // Loop over lines of input
     IPAR::TextReader reader(ist);
-    std::string word;
-    IPAR::Range iprange;
-    while (reader >> word)
-    {
-	// Assume the word is a range of IPv4 addresses
-	try {
-	    iprange = IPAR::Range(word);
-	}
-	catch (const std::exception& ex) {
-	    std::cerr << "ERROR: " << ex.what() << " at line "
-                      << reader.line_no() << " of input: " << std::endl;
-	    std::cerr << reader.current_line() << std::endl;
-	    std::cerr << "Last input was \"" << word << "\"" << std::endl;
-	    return 1;
-	}
-        iplist.add(iprange);
-    }
+    return read_words<IPAR::TextReader, std::string>(
+        reader, iplist, nullptr, "input");
+}
 
-    return 0;
+int common_read (std::istream& ist, List& iplist, List6& iplist6)
+{
+    IPAR::TextReader reader(ist);
+    return read_words<IPAR::TextReader, std::string>(
+        reader, iplist, &iplist6, "input");
+}
+
+int view_read (std::string_view text, List& iplist, unsigned int jobs,
+               const std::string& where)
+{
+    return read_view(text, iplist, nullptr, jobs, where);
+}
+
+int view_read (std::string_view text, List& iplist, List6& iplist6,
+               unsigned int jobs, const std::string& where)
+{
+    return read_view(text, iplist, &iplist6, jobs, where);
+}
+
+int common_read (int fd, List& iplist, unsigned int jobs)
+{
+    return read_fd(fd, iplist, nullptr, jobs);
+}
+
+int common_read (int fd, List& iplist, List6& iplist6, unsigned int jobs)
+{
+    return read_fd(fd, iplist, &iplist6, jobs);
+}
+
+int file_read (const std::string& filename, List& iplist, unsigned int jobs)
+{
+    return read_file(filename, iplist, nullptr, jobs);
+}
+
+int file_read (const std::string& filename, List& iplist, List6& iplist6,
+               unsigned int jobs)
+{
+    return read_file(filename, iplist, &iplist6, jobs);
 }
 
 } // namespace IPAR
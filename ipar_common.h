@@ -7,9 +7,14 @@
 
 #include <fstream>
 #include <istream>
+#include <memory>
+#include <ostream>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include "ipar_iplist.h"
+#include "ipar_list6.h"
+#include "ipar_snapshot.h"
 
 namespace IPAR {
 
@@ -18,10 +23,44 @@ enum OutputStyle {
     Sunknown,
     Scidr,
     Sdashes,
-    Shex
+    Shex,
+    Sbinary,
+    Sraw
 };
 OutputStyle o_style (const std::string& arg);
 
+// Handle user request for number of threads, as in "-j N". Returns zero if
+// the argument is not a number from 1 to max_jobs.
+const unsigned int max_jobs = 1024;
+unsigned int o_jobs (const std::string& arg);
+
+// Where error messages and warnings about input go: std::cerr, unless the
+// calling thread has a DiagnosticsTo in effect.
+std::ostream& diagnostics();
+
+// Sends diagnostics from the calling thread to another stream for as long
+// as it lives. Used to keep the messages about one of several inputs that
+// are read at the same time apart from the others.
+class DiagnosticsTo
+{
+public:
+
+    // The automatic methods
+    DiagnosticsTo() = delete;
+    ~DiagnosticsTo();
+    DiagnosticsTo(DiagnosticsTo const& other) = delete;
+    DiagnosticsTo& operator=(DiagnosticsTo const& other) = delete;
+    DiagnosticsTo(DiagnosticsTo&& other) = delete;
+    DiagnosticsTo& operator=(DiagnosticsTo&& other) = delete;
+
+    explicit DiagnosticsTo(std::ostream& ost);
+
+private:
+
+    std::ostream* mPrevious;
+
+}; // class DiagnosticsTo
+
 // This class handles text input in a common style for the IPAR programs:
 //  * All text from character # to end of line is ignored.
 //  * Text is broken down into a stream of words, delimited by spaces.
@@ -56,6 +95,112 @@ private:
 
 }; // class TextReader
 
+// This class holds the complete content of an input file in memory. A
+// regular file is mapped with mmap(2), so no copy is made. Anything else
+// (pipe, terminal) is read in with read(2).
+class MappedText
+{
+public:
+
+    // The automatic methods
+    MappedText() = delete;
+    ~MappedText();
+    MappedText(MappedText const& other) = delete;
+    MappedText& operator=(MappedText const& other) = delete;
+    MappedText(MappedText&& other) = delete;
+    MappedText& operator=(MappedText&& other) = delete;
+
+    // Takes content from an open file descriptor, such as STDIN_FILENO.
+    // Content starts at the current file offset. The descriptor is not
+    // closed.
+    MappedText(int fd);
+
+    // Takes content from a named file.
+    MappedText(const std::string& filename);
+
+    // False if the file could not be opened or read.
+    operator bool() const { return mOk; }
+
+    // The only way to access content
+    std::string_view view() const { return mView; }
+
+private:
+
+    void load(int fd);
+
+    void* mMap;
+    std::size_t mMapLength;
+    std::string mBuffer;
+    std::string_view mView;
+    bool mOk;
+
+}; // class MappedText
+
+// A binary snapshot in a named file (see ipar_snapshot.h), mapped into memory
+// and used in place. For operands that need not be made into a list.
+class SnapshotFile
+{
+public:
+
+    // The automatic methods
+    SnapshotFile() = delete;
+    ~SnapshotFile() = default;
+    SnapshotFile(SnapshotFile const& other) = delete;
+    SnapshotFile& operator=(SnapshotFile const& other) = delete;
+    SnapshotFile(SnapshotFile&& other) = delete;
+    SnapshotFile& operator=(SnapshotFile&& other) = delete;
+
+    // Maps the file and checks it, as Snapshot does. Only regular files are
+    // looked at, so that a pipe is left for reading as usual. Reports
+    // nothing: a file that is not a good snapshot should be read as usual,
+    // which reports whatever is wrong with it.
+    explicit SnapshotFile(const std::string& filename);
+
+    // False if the file is not a regular file, could not be read, or is not
+    // a good snapshot.
+    operator bool() const { return mSnapshot != nullptr; }
+
+    // The content. Only when true.
+    const Snapshot& snapshot() const { return *mSnapshot; }
+
+private:
+
+    std::unique_ptr<MappedText> mText;
+    std::unique_ptr<Snapshot> mSnapshot;
+
+}; // class SnapshotFile
+
+// This class has the same behavior as TextReader, but operates on text that is
+// already in memory. Words are returned as views into the text, so nothing is
+// copied.
+class ViewReader
+{
+public:
+
+    // The automatic methods
+    ViewReader() = delete;
+    ~ViewReader() = default;
+    ViewReader(ViewReader const& other) = default;
+    ViewReader& operator=(ViewReader const& other) = default;
+    ViewReader(ViewReader&& other) = default;
+    ViewReader& operator=(ViewReader&& other) = default;
+
+    ViewReader(std::string_view text);
+    ViewReader& operator>> (std::string_view& word);
+    operator bool() const { return mOk; }
+    std::string_view current_line() const;
+    unsigned int line_no() const { return mLineNo; }
+
+private:
+
+    const char* mPos;
+    const char* mEnd;
+    const char* mLine;
+    unsigned int mLineNo;
+    bool mOk;
+
+}; // class ViewReader
+
 class FileReader
 {
 public:
@@ -65,25 +210,51 @@ public:
     ~FileReader() = default;
     FileReader(FileReader const& other) = delete;
     FileReader& operator=(FileReader const& other) = delete;
-    FileReader(FileReader&& other) = default;
+    FileReader(FileReader&& other) = delete;
     FileReader& operator=(FileReader&& other) = delete;
 
     FileReader(const std::string& filename);
-    FileReader& operator>> (std::string& word) { mTr >> word; return *this; }
-    operator bool() const { return bool(mTr); }
-    std::string current_line() const { return mTr.current_line(); }
-    unsigned int line_no() const { return mTr.line_no(); }
+    FileReader& operator>> (std::string_view& word)
+        { mVr >> word; return *this; }
+    operator bool() const { return bool(mMt) && bool(mVr); }
+    std::string_view current_line() const { return mVr.current_line(); }
+    unsigned int line_no() const { return mVr.line_no(); }
 
 private:
 
-    std::ifstream mIfs;
-    TextReader mTr;
+    MappedText mMt;
+    ViewReader mVr;
 
 };
 
-// This method does a batch-read of interval specifiers from an
-// istream into an IPAR list.
+// These methods do a batch-read of interval specifiers into an IPAR list. The
+// second one reads from a file descriptor, such as STDIN_FILENO, without
+// copying the text. With more than one job, it splits the text at line
+// boundaries and parses the pieces on separate threads. The result is the
+// same either way.
 int common_read (std::istream& ist, List& iplist);
+int common_read (int fd, List& iplist, unsigned int jobs = 1);
+
+// Reads a whole file into an IPAR list, in the same way. This method and
+// common_read(fd) also accept a binary snapshot (see ipar_snapshot.h), which
+// is loaded without parsing.
+int file_read (const std::string& filename, List& iplist,
+               unsigned int jobs = 1);
+
+// Same as above, for text or a snapshot that is already in memory. Argument
+// "where" names the input in error messages.
+int view_read (std::string_view text, List& iplist, unsigned int jobs,
+               const std::string& where);
+
+// The same four, for input that mixes IPv4 and IPv6. Words that are IPv6
+// (see is_ipv6) go to iplist6, and everything else to iplist. The ones
+// above take IPv4 only.
+int common_read (std::istream& ist, List& iplist, List6& iplist6);
+int common_read (int fd, List& iplist, List6& iplist6, unsigned int jobs = 1);
+int file_read (const std::string& filename, List& iplist, List6& iplist6,
+               unsigned int jobs = 1);
+int view_read (std::string_view text, List& iplist, List6& iplist6,
+               unsigned int jobs, const std::string& where);
 
 } // namespace IPAR
 
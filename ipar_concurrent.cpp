@@ -0,0 +1,128 @@
+#include <algorithm>
+#include <limits>
+#include "ipar_concurrent.h"
+
+namespace IPAR
+{
+
+const char* reader_limit_error::what() const noexcept
+{
+    return "Too many readers of a concurrent list";
+}
+
+////////////////////////////////
+// ConcurrentList implementation
+////////////////////////////////
+
+ConcurrentList::ConcurrentList(unsigned int max_readers, const List& initial)
+ : mSlots(new Slot[max_readers]), mNumSlots(max_readers), mCurrent(nullptr),
+   mEpoch(1), mWriteMutex(), mList(initial), mNumVersions(1), mRetired()
+{
+    for (std::size_t slot = 0 ; slot < mNumSlots ; ++slot)
+    {
+	mSlots[slot].mPinned.store(0);
+	mSlots[slot].mTaken.store(false);
+    }
+    mCurrent.store(new Version{ mList.freeze(), mNumVersions });
+}
+
+ConcurrentList::~ConcurrentList()
+{
+    delete mCurrent.load();
+    for (auto& retired : mRetired) delete retired.second;
+}
+
+void ConcurrentList::add (const Range& range)
+{
+    std::lock_guard<std::mutex> lock(mWriteMutex);
+    mList.add(range);
+}
+
+void ConcurrentList::subtract (const Range& range)
+{
+    std::lock_guard<std::mutex> lock(mWriteMutex);
+    mList.subtract(range);
+}
+
+void ConcurrentList::add_list (const List& other)
+{
+    std::lock_guard<std::mutex> lock(mWriteMutex);
+    mList.add_list(other);
+}
+
+void ConcurrentList::set_difference (const List& other)
+{
+    std::lock_guard<std::mutex> lock(mWriteMutex);
+    mList.set_difference(other);
+}
+
+unsigned long ConcurrentList::publish()
+{
+    std::lock_guard<std::mutex> lock(mWriteMutex);
+    const Version* next = new Version{ mList.freeze(), ++mNumVersions };
+
+    // A reader that pinned an epoch up to this one may have loaded the old
+    // version. Any later one loads the new version or a newer one.
+    const Version* old = mCurrent.exchange(next);
+    uint64_t epoch = mEpoch.fetch_add(1);
+    mRetired.push_back(std::make_pair(epoch, old));
+
+    reclaim();
+    return mNumVersions;
+}
+
+std::size_t ConcurrentList::num_retired() const
+{
+    std::lock_guard<std::mutex> lock(mWriteMutex);
+    return mRetired.size();
+}
+
+void ConcurrentList::reclaim()
+{
+    uint64_t oldest = std::numeric_limits<uint64_t>::max();
+    for (std::size_t slot = 0 ; slot < mNumSlots ; ++slot)
+    {
+	uint64_t pinned = mSlots[slot].mPinned.load();
+	if ((pinned != 0) && (pinned < oldest)) oldest = pinned;
+    }
+
+    auto keep = std::remove_if(mRetired.begin(), mRetired.end(),
+        [oldest](const std::pair<uint64_t, const Version*>& retired) {
+	    if (retired.first >= oldest) return false;
+	    delete retired.second;
+	    return true;
+	});
+    mRetired.erase(keep, mRetired.end());
+}
+
+////////////////////////////////////////
+// ConcurrentList::Reader implementation
+////////////////////////////////////////
+
+ConcurrentList::Reader::Reader(ConcurrentList& list)
+ : mOwner(list), mSlot(0)
+{
+    for ( ; mSlot < mOwner.mNumSlots ; ++mSlot)
+	if (!mOwner.mSlots[mSlot].mTaken.exchange(true)) return;
+    throw reader_limit_error();
+}
+
+ConcurrentList::Reader::~Reader()
+{
+    mOwner.mSlots[mSlot].mPinned.store(0);
+    mOwner.mSlots[mSlot].mTaken.store(false);
+}
+
+bool ConcurrentList::Reader::contains (uint32_t address) const
+{
+    Pin pin(*this);
+    return pin.version()->mList.contains(address);
+}
+
+unsigned long ConcurrentList::Reader::version() const
+{
+    Pin pin(*this);
+    return pin.version()->mNumber;
+}
+
+} // namespace IPAR
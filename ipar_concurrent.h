@@ -0,0 +1,181 @@
+////////////////////////////////////////////////////////
+// A List that many threads can search while one thread
+// keeps changing it.
+////////////////////////////////////////////////////////
+
+#ifndef IPAR_CONCURRENT_H_ // {
+#define IPAR_CONCURRENT_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include "ipar_iplist.h"
+
+namespace IPAR {
+
+// An exception that is thrown by this software.
+class reader_limit_error : public std::exception
+{
+public:
+    virtual const char* what() const noexcept;
+};
+
+// A List for a long-running service, where reader threads look up addresses
+// while a writer thread applies updates.
+//
+// The writer changes a private List with add and subtract, then calls
+// publish to make the changes visible. Each publish freezes the list (see
+// NumList::freeze) into a new version and swaps it in with one atomic store,
+// so a reader sees either all of a batch of updates or none of them.
+//
+// Readers never block, and never wait for the writer or for each other. A
+// reader pins the current epoch in a slot of its own before it loads the
+// current version, and unpins it when done. A version that has been replaced
+// is freed only once every pinned epoch is later than its replacement, that
+// is, once no reader can still be looking at it. Freeing is done by the
+// writer, on later calls to publish.
+//
+// Writer methods may be called from any thread, but are serialized by a
+// mutex. All Readers must be destroyed before the ConcurrentList.
+class ConcurrentList
+{
+public:
+
+    // The automatic methods
+    ConcurrentList() = delete;
+    ~ConcurrentList();
+    ConcurrentList(ConcurrentList const& other) = delete;
+    ConcurrentList& operator=(ConcurrentList const& other) = delete;
+    ConcurrentList(ConcurrentList&& other) = delete;
+    ConcurrentList& operator=(ConcurrentList&& other) = delete;
+
+    // Up to max_readers Readers may exist at once. The first version
+    // published holds the given list.
+    explicit ConcurrentList(unsigned int max_readers,
+                            const List& initial = List());
+
+    // A thread's access to the list. Takes one of the reader slots, and
+    // throws reader_limit_error if there are none left. A Reader is for one
+    // thread at a time.
+    class Reader
+    {
+    public:
+
+	// The automatic methods
+	Reader() = delete;
+	~Reader();
+	Reader(Reader const& other) = delete;
+	Reader& operator=(Reader const& other) = delete;
+	Reader(Reader&& other) = delete;
+	Reader& operator=(Reader&& other) = delete;
+
+	explicit Reader(ConcurrentList& list);
+
+	// Whether an address is in the current version
+	bool contains (uint32_t address) const;
+
+	// Calls func with the current version, which stays valid until func
+	// returns. The result is that of func.
+	template<typename FUNC>
+	auto read (FUNC func) const;
+
+	// The number of the current version. The first one is 1.
+	unsigned long version() const;
+
+    private:
+
+	struct Pin;
+
+	ConcurrentList& mOwner;
+	std::size_t mSlot;
+
+    }; // class Reader
+
+    // Writer side. Changes are not seen by readers until publish.
+    void add (const Range& range);
+    void subtract (const Range& range);
+    void add_list (const List& other);
+    void set_difference (const List& other);
+
+    // Makes a new version out of the changes since the last one, and frees
+    // old versions that no reader can still see. Returns the number of the
+    // new version.
+    unsigned long publish();
+
+    // For diagnostic use: replaced versions not freed yet.
+    std::size_t num_retired() const;
+
+private:
+
+    // One published state of the list
+    struct Version
+    {
+	FrozenList<uint32_t> mList;
+	unsigned long mNumber;
+    };
+
+    // A reader slot, on a cache line of its own so that readers do not slow
+    // each other down. mPinned is zero while the reader is not reading.
+    struct alignas(64) Slot
+    {
+	std::atomic<uint64_t> mPinned;
+	std::atomic<bool> mTaken;
+    };
+
+    // Frees retired versions that no pinned epoch can see. The caller holds
+    // mWriteMutex.
+    void reclaim();
+
+    std::unique_ptr<Slot[]> mSlots;
+    std::size_t mNumSlots;
+    std::atomic<const Version*> mCurrent;
+    std::atomic<uint64_t> mEpoch;
+
+    // Writer state, guarded by mWriteMutex. Each retired version is kept
+    // with the epoch in which it was replaced.
+    mutable std::mutex mWriteMutex;
+    List mList;
+    unsigned long mNumVersions;
+    std::vector<std::pair<uint64_t, const Version*>> mRetired;
+
+}; // class ConcurrentList
+
+// Keeps the current version from being freed while it is in use. A pin
+// inside another one on the same Reader keeps the older epoch.
+struct ConcurrentList::Reader::Pin
+{
+    explicit Pin(const Reader& reader)
+     : mSlot(reader.mOwner.mSlots[reader.mSlot]),
+       mOuter(mSlot.mPinned.load(std::memory_order_relaxed)),
+       mVersion(nullptr)
+    {
+	// The epoch must be visible before the version is loaded, so both
+	// are sequentially consistent
+	if (mOuter == 0) mSlot.mPinned.store(reader.mOwner.mEpoch.load());
+	mVersion = reader.mOwner.mCurrent.load();
+    }
+    ~Pin() { mSlot.mPinned.store(mOuter, std::memory_order_release); }
+    Pin(Pin const& other) = delete;
+    Pin& operator=(Pin const& other) = delete;
+
+    const Version* version() const { return mVersion; }
+
+    Slot& mSlot;
+    uint64_t mOuter;
+    const Version* mVersion;
+};
+
+template<typename FUNC>
+auto ConcurrentList::Reader::read (FUNC func) const
+{
+    Pin pin(*this);
+    return func(pin.version()->mList);
+}
+
+} // namespace IPAR
+
+#endif // } IPAR_CONCURRENT_H_
@@ -1,21 +1,26 @@
 // Program ipar_expand
 // -------------------
 // Reads a list of IP address ranges from standard input.
-// Writes out equivalent list of individual IP addresses.
+// Writes out equivalent list of individual IP addresses, as nn.nn.nn.nn,
+// in hex, or raw 32-bit numbers in host byte order. IPv6 ranges are
+// expanded to IPv6 addresses in canonical form, 32 hex digits, or raw
+// 128-bit numbers.
 // No sorting or combining of intervals is performed.
 // Useful for testing other programs.
 
 #include <iostream>
-#include <iomanip>
 #include <string>
+#include <string_view>
+#include <unistd.h>
 using namespace std;
 #include "ipar_iplist.h"
 #include "ipar_common.h"
+#include "ipar_list6.h"
 
 int main (int argc, char* argv[])
 {
     // Process arguments
-    bool bHex = false;
+    IPAR::ExpandStyle style = IPAR::Equad;
     switch (argc)
     {
     case 1:
@@ -23,33 +28,46 @@ int main (int argc, char* argv[])
     case 2:
         if (std::string(argv[1]) == "-hex")
 	{
-	    bHex = true;
+	    style = IPAR::Ehex;
+	}
+	else if (std::string(argv[1]) == "-raw")
+	{
+	    style = IPAR::Eraw;
 	}
 	else
 	{
-	    cerr << "Usage: ipar_expand [-hex]" << endl;
+	    cerr << "Usage: ipar_expand [-hex|-raw]" << endl;
 	    cerr << "(no other arguments)" << endl;
 	    return 1;
 	}
         break;
     default:
-        cerr << "Usage: ipar_expand [-hex]" << endl;
+        cerr << "Usage: ipar_expand [-hex|-raw]" << endl;
 	cerr << "(no other arguments)" << endl;
 	return 1;
     }
 
-    // Choose hex output if necessary
-    if (bHex) cout << hex << setfill('0');
+    IPAR::Writer out(STDOUT_FILENO);
 
     // Loop over lines of input
-    IPAR::TextReader reader(cin);
-    string word;
+    IPAR::MappedText text(STDIN_FILENO);
+    if (!text)
+    {
+	cerr << "ERROR: could not read input" << endl;
+	return 1;
+    }
+    IPAR::ViewReader reader(text.view());
+    string_view word;
     IPAR::Range iprange;
+    IPAR::Range6 iprange6;
     while (reader >> word)
     {
-	// Assume the word is a range of IPv4 addresses
+	bool bIPv6 = IPAR::is_ipv6(word);
 	try {
-	    iprange = IPAR::Range(word);
+	    if (bIPv6)
+		iprange6 = IPAR::Range6(word);
+	    else
+		iprange = IPAR::Range(word);
 	}
 	catch (const exception& ex) {
 	    cerr << "ERROR: " << ex.what() << endl;
@@ -57,16 +75,11 @@ int main (int argc, char* argv[])
 	    return 1;
 	}
 	// Expand the range
-	auto lower = iprange.get().first;
-	auto upper = iprange.get().second;
-	while (lower <= upper)
-	{
-	    if (bHex)
-		cout << setw(8) << lower << endl;
-	    else
-		cout << IPAR::int_to_quad(lower) << endl;
-	    ++lower;
-	}
+	if (bIPv6)
+	    IPAR::expand6(out, iprange6.get().first, iprange6.get().second,
+	                  style);
+	else
+	    out.expand(iprange.get().first, iprange.get().second, style);
     }
 
     return 0;
@@ -0,0 +1,136 @@
+////////////////////////////////////////////////////////
+// Lists of IP addresses that are fixed at compile time.
+////////////////////////////////////////////////////////
+
+#ifndef IPAR_FIXEDLIST_H_ // {
+#define IPAR_FIXEDLIST_H_
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include "ipar_iplist.h"
+
+namespace IPAR {
+
+// A list of at most N intervals of IP addresses, in the same standard form
+// as a List: sorted, never overlapping or adjacent. Everything but to_list
+// can be done at compile time, so a fixed list declared constexpr is parsed,
+// sorted and merged by the compiler and kept in read-only data. A bad range
+// is then a compile error. See make_fixed_list.
+template<std::size_t N>
+class FixedList
+{
+public:
+
+    using value_type = std::pair<uint32_t,uint32_t>;
+    using const_iterator = const value_type*;
+
+    // The automatic methods
+    constexpr FixedList() noexcept : mIntervals(), mSize(0) { }
+    ~FixedList() = default;
+    FixedList(FixedList const& other) = default;
+    FixedList& operator=(FixedList const& other) = default;
+    FixedList(FixedList&& other) = default;
+    FixedList& operator=(FixedList&& other) = default;
+
+    // Takes intervals in any order, possibly overlapping. Throws
+    // numeric_range_error if a lower bound is above its upper bound.
+    constexpr explicit FixedList(const std::array<value_type, N>& intervals)
+     : mIntervals(intervals), mSize(0)
+    {
+	for (const auto& interval : mIntervals)
+	    if (interval.first > interval.second) throw numeric_range_error();
+	std::sort(mIntervals.begin(), mIntervals.end());
+
+	// Merge each interval into the last one kept, if they overlap or meet
+	for (std::size_t index = 0 ; index < N ; ++index)
+	{
+	    const value_type& next = mIntervals[index];
+	    if ((mSize != 0) && ((next.first == 0) ||
+	        (mIntervals[mSize - 1].second >= next.first - 1)))
+	    {
+		if (next.second > mIntervals[mSize - 1].second)
+		    mIntervals[mSize - 1].second = next.second;
+		continue;
+	    }
+	    mIntervals[mSize++] = next;
+	}
+	for (std::size_t index = mSize ; index < N ; ++index)
+	    mIntervals[index] = value_type(0, 0);
+    }
+
+    // Whether an address is in the list. A binary search.
+    constexpr bool contains (uint32_t address) const
+    {
+	auto iter = std::upper_bound(cbegin(), cend(), address,
+	    [](uint32_t value, const value_type& interval) {
+		return value < interval.first;
+	    });
+	return (iter != cbegin()) && (address <= (iter - 1)->second);
+    }
+
+    // The intervals in sorted order. These can go straight to
+    // List::add_sorted.
+    constexpr const_iterator cbegin() const { return mIntervals.data(); }
+    constexpr const_iterator cend() const
+        { return mIntervals.data() + mSize; }
+    constexpr const_iterator begin() const { return cbegin(); }
+    constexpr const_iterator end() const { return cend(); }
+
+    // Number of intervals, after merging
+    constexpr std::size_t size() const { return mSize; }
+    constexpr bool empty() const { return mSize == 0; }
+
+    // A List with the same content, for set operations and the like
+    List to_list() const
+    {
+	List list;
+	list.add_sorted(cbegin(), cend());
+	return list;
+    }
+
+private:
+
+    std::array<value_type, N> mIntervals;
+    std::size_t mSize;
+
+}; // class FixedList
+
+// Makes a FixedList out of ranges in any of the forms parse_range takes.
+// Example:
+//     constexpr auto local = make_fixed_list("10.0.0.0/8", "127.0.0.1");
+//     static_assert(local.contains(quad_to_int("10.1.2.3")));
+template<typename... EXPRS>
+constexpr FixedList<sizeof...(EXPRS)> make_fixed_list (const EXPRS&... exprs)
+{
+    return FixedList<sizeof...(EXPRS)>(
+        std::array<std::pair<uint32_t,uint32_t>, sizeof...(EXPRS)>{
+            parse_range(std::string_view(exprs))... });
+}
+
+// Private address space (RFC 1918)
+inline constexpr auto private_networks = make_fixed_list(
+    "10.0.0.0/8", "172.16.0.0/12", "192.168.0.0/16");
+
+// Addresses that should never be seen as the source of traffic on the
+// public Internet: private and special-purpose space (RFC 6890), and space
+// not yet allocated for unicast.
+inline constexpr auto bogon_networks = make_fixed_list(
+    "0.0.0.0/8", "10.0.0.0/8", "100.64.0.0/10", "127.0.0.0/8",
+    "169.254.0.0/16", "172.16.0.0/12", "192.0.0.0/24", "192.0.2.0/24",
+    "192.168.0.0/16", "198.18.0.0/15", "198.51.100.0/24", "203.0.113.0/24",
+    "224.0.0.0/4", "240.0.0.0/4");
+
+static_assert(private_networks.size() == 3);
+static_assert(private_networks.contains(quad_to_int("172.31.255.255")));
+static_assert(!private_networks.contains(quad_to_int("172.32.0.0")));
+static_assert(bogon_networks.size() == 13);
+static_assert(bogon_networks.contains(quad_to_int("255.255.255.255")));
+static_assert(!bogon_networks.contains(quad_to_int("8.8.8.8")));
+
+} // namespace IPAR
+
+#endif // } IPAR_FIXEDLIST_H_
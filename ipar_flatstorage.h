@@ -0,0 +1,223 @@
+#ifndef IPAR_FLATSTORAGE_H_ // {
+#define IPAR_FLATSTORAGE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "ipar_pool.h"
+
+namespace IPAR {
+
+// Storage policies for NumList. A policy is a sorted container of
+// {lower, upper} pairs with the parts of the std::map interface that NumList
+// uses: iteration in both directions, lower_bound, upper_bound, insert (with
+// and without a hint), emplace_hint at the end, erase, clear, swap, size.
+
+// The original storage: one red-black tree node per interval. ALLOC
+// allocates the nodes.
+template<typename BOUND,
+         typename ALLOC = std::allocator<std::pair<const BOUND,BOUND>>>
+using MapStorage = std::map<BOUND,BOUND,std::less<BOUND>,ALLOC>;
+
+// The same, with nodes taken from an arena of their own (see ipar_pool.h),
+// which saves most of the cost of malloc and free.
+template<typename BOUND>
+using PoolStorage =
+    MapStorage<BOUND, PoolAllocator<std::pair<const BOUND,BOUND>>>;
+
+// A number of values of BOUND. Wide enough for the whole range of BOUND,
+// except when BOUND is 64 bits or more, where the whole range wraps to zero.
+template<typename BOUND>
+using ValueCount = std::conditional_t<
+    (sizeof(BOUND) < sizeof(uint64_t)), uint64_t, BOUND>;
+
+// Whether a storage policy is a std::map, with any allocator
+template<typename STORAGE>
+struct is_map_storage : std::false_type { };
+template<typename BOUND, typename ALLOC>
+struct is_map_storage<std::map<BOUND,BOUND,std::less<BOUND>,ALLOC>>
+ : std::true_type { };
+
+// Intervals kept sorted in contiguous blocks of up to block_max entries, with
+// a flat index of the lower bound of each block. A B+-tree of depth two, in
+// effect. Lookups are two binary searches over contiguous memory. Inserting or
+// erasing moves at most one block of entries; a full block is split in half,
+// and a block that gets small is merged with its neighbour.
+// The number of values in each block is kept as well, in a Fenwick tree, so
+// that order statistics take O(log n) plus a scan of one block. Upper bounds
+// must therefore be changed with set_upper, never through an iterator.
+// Unlike std::map, inserting or erasing invalidates all iterators except the
+// one returned.
+template<typename BOUND>
+class FlatStorage
+{
+public:
+
+    using value_type = std::pair<BOUND,BOUND>;
+    using Block = std::vector<value_type>;
+    using count_type = ValueCount<BOUND>;
+
+    // Entries per block
+    static const std::size_t block_max = 512;
+
+    // The automatic methods
+    FlatStorage() noexcept;
+    ~FlatStorage() = default;
+    FlatStorage(FlatStorage const& other) = default;
+    FlatStorage& operator=(FlatStorage const& other) = default;
+    FlatStorage(FlatStorage&& other) noexcept;
+    FlatStorage& operator=(FlatStorage&& other) noexcept;
+
+    // A position is a block and an offset within it. The end is one block
+    // past the last, at offset zero.
+    template<typename STORAGE, typename VALUE>
+    class basic_iterator
+    {
+    public:
+	using iterator_category = std::bidirectional_iterator_tag;
+	using value_type = std::pair<BOUND,BOUND>;
+	using difference_type = std::ptrdiff_t;
+	using pointer = VALUE*;
+	using reference = VALUE&;
+
+	basic_iterator() : mStorage(nullptr), mBlock(0), mOffset(0) { }
+	basic_iterator(STORAGE* storage, std::size_t block, std::size_t offset)
+	 : mStorage(storage), mBlock(block), mOffset(offset) { }
+
+	// Any iterator converts to a const one
+	template<typename OTHER_STORAGE, typename OTHER_VALUE>
+	basic_iterator(
+	    const basic_iterator<OTHER_STORAGE,OTHER_VALUE>& other)
+	 : mStorage(other.mStorage), mBlock(other.mBlock),
+	   mOffset(other.mOffset) { }
+
+	reference operator*() const
+	    { return mStorage->mBlocks[mBlock][mOffset]; }
+	pointer operator->() const
+	    { return &mStorage->mBlocks[mBlock][mOffset]; }
+
+	basic_iterator& operator++()
+	{
+	    if (++mOffset == mStorage->mBlocks[mBlock].size())
+	    {
+		++mBlock;
+		mOffset = 0;
+	    }
+	    return *this;
+	}
+	basic_iterator operator++(int)
+	    { basic_iterator old(*this); ++*this; return old; }
+	basic_iterator& operator--()
+	{
+	    if (mOffset == 0)
+		mOffset = mStorage->mBlocks[--mBlock].size();
+	    --mOffset;
+	    return *this;
+	}
+	basic_iterator operator--(int)
+	    { basic_iterator old(*this); --*this; return old; }
+
+	template<typename OTHER_STORAGE, typename OTHER_VALUE>
+	bool operator==(
+	    const basic_iterator<OTHER_STORAGE,OTHER_VALUE>& other) const
+	    { return (mBlock == other.mBlock) && (mOffset == other.mOffset); }
+
+    private:
+
+	template<typename, typename> friend class basic_iterator;
+	friend class FlatStorage;
+
+	STORAGE* mStorage;
+	std::size_t mBlock;
+	std::size_t mOffset;
+
+    }; // class basic_iterator
+
+    using iterator = basic_iterator<FlatStorage, value_type>;
+    using const_iterator =
+        basic_iterator<const FlatStorage, const value_type>;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+    iterator begin() { return iterator(this, 0, 0); }
+    iterator end() { return iterator(this, mBlocks.size(), 0); }
+    const_iterator begin() const { return cbegin(); }
+    const_iterator end() const { return cend(); }
+    const_iterator cbegin() const { return const_iterator(this, 0, 0); }
+    const_iterator cend() const
+        { return const_iterator(this, mBlocks.size(), 0); }
+    reverse_iterator rbegin() { return reverse_iterator(end()); }
+    reverse_iterator rend() { return reverse_iterator(begin()); }
+    const_reverse_iterator crbegin() const
+        { return const_reverse_iterator(cend()); }
+    const_reverse_iterator crend() const
+        { return const_reverse_iterator(cbegin()); }
+
+    std::size_t size() const { return mSize; }
+    bool empty() const { return mSize == 0; }
+
+    // As for std::map
+    iterator lower_bound (BOUND key);
+    const_iterator lower_bound (BOUND key) const;
+    iterator upper_bound (BOUND key);
+    const_iterator upper_bound (BOUND key) const;
+    std::pair<iterator,bool> insert (const value_type& value);
+    iterator insert (const_iterator hint, const value_type& value);
+    iterator emplace_hint (const_iterator hint, BOUND lower, BOUND upper);
+    iterator erase (const_iterator pos);
+    void clear() noexcept;
+    void swap (FlatStorage& other) noexcept;
+
+    // Changes the upper bound of an entry in place
+    void set_upper (const_iterator pos, BOUND upper);
+
+    // Order statistics. All are O(log n) and read only, so any number of
+    // threads may call them at once.
+    // Number of values in the entries before pos
+    count_type values_before (const_iterator pos) const;
+    // The value of the given rank, which must be less than
+    // values_before(cend()).
+    BOUND select (count_type rank) const;
+    // Number of entries from first up to last
+    std::size_t distance (const_iterator first, const_iterator last) const;
+
+private:
+
+    // Where key would go: the block whose first entry is the last one not
+    // greater than key, or block zero.
+    std::size_t find_block (BOUND key) const;
+
+    // Inserts before the given position, which must be the right place.
+    iterator insert_at (std::size_t block, std::size_t offset,
+                        const value_type& value);
+
+    // Number of values in one entry
+    static count_type span (const value_type& value)
+        { return count_type(value.second - value.first) + 1; }
+    // Number of values in the first "blocks" blocks
+    count_type prefix_values (std::size_t blocks) const;
+    // Adds delta, which may have wrapped around, to the count of a block
+    void add_values (std::size_t block, count_type delta);
+    // Appends a block count to the tree
+    void push_values (count_type values);
+    // Makes the tree again from mValues, after blocks from "block" on are
+    // split, merged or erased
+    void rebuild_tree (std::size_t block);
+
+    std::vector<Block> mBlocks;
+    std::vector<BOUND> mFirsts;     // Lower bound of the first entry in each
+    std::vector<count_type> mValues;  // Number of values in each
+    std::vector<count_type> mTree;  // Fenwick tree of mValues
+    std::size_t mSize;
+
+}; // class FlatStorage
+
+} // namespace IPAR
+
+#endif // } IPAR_FLATSTORAGE_H_
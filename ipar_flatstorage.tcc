@@ -0,0 +1,362 @@
+#ifndef IPAR_FLATSTORAGE_TCC_ // {
+#define IPAR_FLATSTORAGE_TCC_
+
+#include <algorithm>
+
+namespace IPAR {
+
+//////////////////////////////
+// FlatStorage implementation
+//////////////////////////////
+
+template<typename BOUND>
+FlatStorage<BOUND>::FlatStorage() noexcept
+ : mBlocks(), mFirsts(), mValues(), mTree(), mSize(0)
+{
+}
+
+template<typename BOUND>
+FlatStorage<BOUND>::FlatStorage(FlatStorage&& other) noexcept
+ : mBlocks(std::move(other.mBlocks)), mFirsts(std::move(other.mFirsts)),
+   mValues(std::move(other.mValues)), mTree(std::move(other.mTree)),
+   mSize(other.mSize)
+{
+    other.clear();
+}
+
+template<typename BOUND>
+FlatStorage<BOUND>& FlatStorage<BOUND>::operator=(FlatStorage&& other)
+noexcept
+{
+    mBlocks = std::move(other.mBlocks);
+    mFirsts = std::move(other.mFirsts);
+    mValues = std::move(other.mValues);
+    mTree = std::move(other.mTree);
+    mSize = other.mSize;
+    other.clear();
+    return *this;
+}
+
+template<typename BOUND>
+std::size_t FlatStorage<BOUND>::find_block (BOUND key) const
+{
+    auto iter = std::upper_bound(mFirsts.cbegin(), mFirsts.cend(), key);
+    return (iter == mFirsts.cbegin()) ?
+        0 : static_cast<std::size_t>(iter - mFirsts.cbegin()) - 1;
+}
+
+template<typename BOUND>
+typename FlatStorage<BOUND>::iterator
+FlatStorage<BOUND>::lower_bound (BOUND key)
+{
+    const FlatStorage& self = *this;
+    const_iterator found = self.lower_bound(key);
+    return iterator(this, found.mBlock, found.mOffset);
+}
+
+template<typename BOUND>
+typename FlatStorage<BOUND>::const_iterator
+FlatStorage<BOUND>::lower_bound (BOUND key) const
+{
+    if (mBlocks.empty()) return cend();
+    std::size_t block = find_block(key);
+    const Block& entries = mBlocks[block];
+    auto iter = std::lower_bound(entries.cbegin(), entries.cend(), key,
+        [](const value_type& entry, BOUND val) { return entry.first < val; });
+    if (iter == entries.cend()) return const_iterator(this, block + 1, 0);
+    return const_iterator(this, block,
+                          static_cast<std::size_t>(iter - entries.cbegin()));
+}
+
+template<typename BOUND>
+typename FlatStorage<BOUND>::iterator
+FlatStorage<BOUND>::upper_bound (BOUND key)
+{
+    const FlatStorage& self = *this;
+    const_iterator found = self.upper_bound(key);
+    return iterator(this, found.mBlock, found.mOffset);
+}
+
+template<typename BOUND>
+typename FlatStorage<BOUND>::const_iterator
+FlatStorage<BOUND>::upper_bound (BOUND key) const
+{
+    if (mBlocks.empty()) return cend();
+    std::size_t block = find_block(key);
+    const Block& entries = mBlocks[block];
+    auto iter = std::upper_bound(entries.cbegin(), entries.cend(), key,
+        [](BOUND val, const value_type& entry) { return val < entry.first; });
+    if (iter == entries.cend()) return const_iterator(this, block + 1, 0);
+    return const_iterator(this, block,
+                          static_cast<std::size_t>(iter - entries.cbegin()));
+}
+
+template<typename BOUND>
+std::pair<typename FlatStorage<BOUND>::iterator, bool>
+FlatStorage<BOUND>::insert (const value_type& value)
+{
+    iterator pos = lower_bound(value.first);
+    if ((pos != end()) && (pos->first == value.first))
+	return std::make_pair(pos, false);
+    return std::make_pair(insert_at(pos.mBlock, pos.mOffset, value), true);
+}
+
+template<typename BOUND>
+typename FlatStorage<BOUND>::iterator
+FlatStorage<BOUND>::insert (const_iterator hint, const value_type& value)
+{
+    // Use the hint if value belongs right before it, as for std::map
+    bool after_prev = (hint == cbegin()) ||
+        (std::prev(hint)->first < value.first);
+    bool before_hint = (hint == cend()) || (value.first < hint->first);
+    if (after_prev && before_hint)
+	return insert_at(hint.mBlock, hint.mOffset, value);
+    return insert(value).first;
+}
+
+template<typename BOUND>
+typename FlatStorage<BOUND>::iterator
+FlatStorage<BOUND>::emplace_hint (const_iterator hint, BOUND lower,
+                                  BOUND upper)
+{
+    return insert(hint, std::make_pair(lower, upper));
+}
+
+template<typename BOUND>
+typename FlatStorage<BOUND>::iterator
+FlatStorage<BOUND>::insert_at (std::size_t block, std::size_t offset,
+                               const value_type& value)
+{
+    ++mSize;
+    if (mBlocks.empty())
+    {
+	mBlocks.emplace_back();
+	mBlocks.back().reserve(block_max);
+	mBlocks.back().push_back(value);
+	mFirsts.push_back(value.first);
+	push_values(span(value));
+	return begin();
+    }
+
+    // The end, or the start of a block: the end of the block before is just
+    // as good, and appending is cheaper.
+    if ((offset == 0) && (block > 0))
+    {
+	--block;
+	offset = mBlocks[block].size();
+    }
+
+    // At the very end, start a new block rather than split a full one, so
+    // that blocks built in order are full.
+    if ((block + 1 == mBlocks.size()) &&
+        (offset == mBlocks[block].size()) && (offset >= block_max))
+    {
+	mBlocks.emplace_back();
+	mBlocks.back().reserve(block_max);
+	mBlocks.back().push_back(value);
+	mFirsts.push_back(value.first);
+	push_values(span(value));
+	return iterator(this, block + 1, 0);
+    }
+
+    Block& entries = mBlocks[block];
+    entries.insert(entries.begin() + static_cast<std::ptrdiff_t>(offset),
+                   value);
+    if (offset == 0) mFirsts[block] = value.first;
+    add_values(block, span(value));
+    if (entries.size() <= block_max) return iterator(this, block, offset);
+
+    // Split a full block in half
+    std::size_t half = entries.size() / 2;
+    count_type lower_values = 0;
+    for (std::size_t index = 0 ; index < half ; ++index)
+	lower_values += span(entries[index]);
+    Block upper_half;
+    upper_half.reserve(block_max);
+    upper_half.assign(entries.cbegin() + static_cast<std::ptrdiff_t>(half),
+                      entries.cend());
+    entries.resize(half);
+    BOUND first = upper_half.front().first;
+    mBlocks.insert(mBlocks.begin() + static_cast<std::ptrdiff_t>(block) + 1,
+                   std::move(upper_half));
+    mFirsts.insert(mFirsts.begin() + static_cast<std::ptrdiff_t>(block) + 1,
+                   first);
+    mValues.insert(mValues.begin() + static_cast<std::ptrdiff_t>(block) + 1,
+                   mValues[block] - lower_values);
+    mValues[block] = lower_values;
+    rebuild_tree(block);
+    if (offset < half) return iterator(this, block, offset);
+    return iterator(this, block + 1, offset - half);
+}
+
+template<typename BOUND>
+typename FlatStorage<BOUND>::iterator
+FlatStorage<BOUND>::erase (const_iterator pos)
+{
+    std::size_t block = pos.mBlock;
+    std::size_t offset = pos.mOffset;
+    Block& entries = mBlocks[block];
+    add_values(block, count_type(0) - span(entries[offset]));
+    entries.erase(entries.begin() + static_cast<std::ptrdiff_t>(offset));
+    --mSize;
+
+    if (entries.empty())
+    {
+	mBlocks.erase(mBlocks.begin() + static_cast<std::ptrdiff_t>(block));
+	mFirsts.erase(mFirsts.begin() + static_cast<std::ptrdiff_t>(block));
+	mValues.erase(mValues.begin() + static_cast<std::ptrdiff_t>(block));
+	rebuild_tree(block);
+	return iterator(this, block, 0);
+    }
+    if (offset == 0) mFirsts[block] = entries.front().first;
+
+    // Take in the next block if both fit in one
+    if ((entries.size() < block_max / 4) && (block + 1 < mBlocks.size()) &&
+        (entries.size() + mBlocks[block + 1].size() <= block_max))
+    {
+	Block& next = mBlocks[block + 1];
+	entries.insert(entries.end(), next.cbegin(), next.cend());
+	mBlocks.erase(mBlocks.begin() + static_cast<std::ptrdiff_t>(block) + 1);
+	mFirsts.erase(mFirsts.begin() + static_cast<std::ptrdiff_t>(block) + 1);
+	mValues[block] += mValues[block + 1];
+	mValues.erase(
+	    mValues.begin() + static_cast<std::ptrdiff_t>(block) + 1);
+	rebuild_tree(block);
+    }
+
+    if (offset == mBlocks[block].size()) return iterator(this, block + 1, 0);
+    return iterator(this, block, offset);
+}
+
+template<typename BOUND>
+void FlatStorage<BOUND>::clear() noexcept
+{
+    mBlocks.clear();
+    mFirsts.clear();
+    mValues.clear();
+    mTree.clear();
+    mSize = 0;
+}
+
+template<typename BOUND>
+void FlatStorage<BOUND>::swap (FlatStorage& other) noexcept
+{
+    mBlocks.swap(other.mBlocks);
+    mFirsts.swap(other.mFirsts);
+    mValues.swap(other.mValues);
+    mTree.swap(other.mTree);
+    std::swap(mSize, other.mSize);
+}
+
+template<typename BOUND>
+void FlatStorage<BOUND>::set_upper (const_iterator pos, BOUND upper)
+{
+    value_type& entry = mBlocks[pos.mBlock][pos.mOffset];
+    add_values(pos.mBlock, count_type(upper) - count_type(entry.second));
+    entry.second = upper;
+}
+
+template<typename BOUND>
+typename FlatStorage<BOUND>::count_type
+FlatStorage<BOUND>::values_before (const_iterator pos) const
+{
+    count_type total = prefix_values(pos.mBlock);
+    if (pos.mBlock == mBlocks.size()) return total;
+    const Block& entries = mBlocks[pos.mBlock];
+    for (std::size_t index = 0 ; index < pos.mOffset ; ++index)
+	total += span(entries[index]);
+    return total;
+}
+
+template<typename BOUND>
+BOUND FlatStorage<BOUND>::select (count_type rank) const
+{
+    // Walk down the tree to the last block with no more than rank values
+    // before it
+    std::size_t block = 0;
+    std::size_t step = 1;
+    while (step * 2 <= mTree.size()) step *= 2;
+    for ( ; step != 0 ; step /= 2)
+    {
+	if ((block + step <= mTree.size()) &&
+	    (mTree[block + step - 1] <= rank))
+	{
+	    block += step;
+	    rank -= mTree[block - 1];
+	}
+    }
+
+    for (const value_type& entry : mBlocks[block])
+    {
+	if (rank < span(entry)) return entry.first + static_cast<BOUND>(rank);
+	rank -= span(entry);
+    }
+    return mBlocks[block].back().second;
+}
+
+template<typename BOUND>
+std::size_t FlatStorage<BOUND>::distance (const_iterator first,
+                                          const_iterator last) const
+{
+    if (first.mBlock == last.mBlock) return last.mOffset - first.mOffset;
+    std::size_t total = mBlocks[first.mBlock].size() - first.mOffset;
+    for (std::size_t block = first.mBlock + 1 ; block < last.mBlock ; ++block)
+	total += mBlocks[block].size();
+    return total + last.mOffset;
+}
+
+// The tree is one-based: node i holds the values of the blocks from
+// i - lowbit(i) up to i - 1, and is kept in mTree[i - 1].
+
+template<typename BOUND>
+typename FlatStorage<BOUND>::count_type
+FlatStorage<BOUND>::prefix_values (std::size_t blocks) const
+{
+    count_type total = 0;
+    for ( ; blocks != 0 ; blocks &= blocks - 1) total += mTree[blocks - 1];
+    return total;
+}
+
+template<typename BOUND>
+void FlatStorage<BOUND>::add_values (std::size_t block, count_type delta)
+{
+    mValues[block] += delta;
+    for (std::size_t node = block + 1 ; node <= mTree.size() ;
+         node += node & (~node + 1))
+	mTree[node - 1] += delta;
+}
+
+template<typename BOUND>
+void FlatStorage<BOUND>::push_values (count_type values)
+{
+    mValues.push_back(values);
+    std::size_t node = mValues.size();
+    std::size_t low = node & (node - 1);
+    mTree.push_back(values + prefix_values(node - 1) - prefix_values(low));
+}
+
+template<typename BOUND>
+void FlatStorage<BOUND>::rebuild_tree (std::size_t block)
+{
+    // Nodes up to "block" hold only blocks before it, and are still right.
+    // The others are made again from their own block and their children.
+    // Some of those children come before "block": the nodes that make up
+    // prefix_values(block).
+    mTree.resize(mValues.size());
+    for (std::size_t node = block + 1 ; node <= mTree.size() ; ++node)
+	mTree[node - 1] = mValues[node - 1];
+    for (std::size_t node = block ; node != 0 ; node &= node - 1)
+    {
+	std::size_t parent = node + (node & (~node + 1));
+	if (parent <= mTree.size()) mTree[parent - 1] += mTree[node - 1];
+    }
+    for (std::size_t node = block + 1 ; node <= mTree.size() ; ++node)
+    {
+	std::size_t parent = node + (node & (~node + 1));
+	if (parent <= mTree.size()) mTree[parent - 1] += mTree[node - 1];
+    }
+}
+
+} // namespace IPAR
+
+#endif // } IPAR_FLATSTORAGE_TCC_
@@ -0,0 +1,121 @@
+#ifndef IPAR_FROZEN_H_ // {
+#define IPAR_FROZEN_H_
+
+#include <cstddef>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+namespace IPAR {
+
+// An immutable copy of a NumList, made by NumList::freeze, for collections
+// that are built once and then searched many times. Lower bounds are kept in
+// Eytzinger order: the root of an implicit binary search tree at position 1,
+// and the children of position k at 2k and 2k+1. A search is a branch-free
+// walk down that tree, with the cache line a few levels further down
+// prefetched at each step. Upper bounds are kept in a parallel array.
+// Nothing changes after construction, so any number of threads can search
+// the same FrozenList at once without locking.
+template<typename BOUND>
+class FrozenList
+{
+public:
+
+    // The automatic methods
+    FrozenList() noexcept;
+    ~FrozenList() = default;
+    FrozenList(FrozenList const& other) = default;
+    FrozenList& operator=(FrozenList const& other) = default;
+    FrozenList(FrozenList&& other) noexcept = default;
+    FrozenList& operator=(FrozenList&& other) noexcept = default;
+
+    // Copies the content of a collection. See NumList::freeze.
+    template<typename LIST>
+    explicit FrozenList(const LIST& list);
+
+    // Iteration in sorted order. Intervals are formed on the fly, so
+    // dereferencing gives a pair by value.
+    class const_iterator
+    {
+    public:
+	using iterator_category = std::bidirectional_iterator_tag;
+	using value_type = std::pair<BOUND,BOUND>;
+	using difference_type = std::ptrdiff_t;
+	using pointer = void;
+	using reference = value_type;
+
+	// What operator-> points into
+	struct arrow
+	{
+	    value_type mPair;
+	    const value_type* operator->() const { return &mPair; }
+	};
+
+	const_iterator() : mList(nullptr), mPos(0) { }
+	const_iterator(const FrozenList* list, std::size_t pos)
+	 : mList(list), mPos(pos) { }
+
+	value_type operator*() const
+	    { return value_type(mList->mLowers[mPos], mList->mUppers[mPos]); }
+	arrow operator->() const { return arrow{**this}; }
+
+	const_iterator& operator++()
+	    { mPos = mList->next(mPos); return *this; }
+	const_iterator operator++(int)
+	    { const_iterator old(*this); ++*this; return old; }
+	const_iterator& operator--()
+	    { mPos = mList->prev(mPos); return *this; }
+	const_iterator operator--(int)
+	    { const_iterator old(*this); --*this; return old; }
+
+	bool operator==(const const_iterator& other) const
+	    { return mPos == other.mPos; }
+
+    private:
+
+	const FrozenList* mList;
+	std::size_t mPos;           // Eytzinger position, zero at the end
+
+    }; // class const_iterator
+
+    const_iterator cbegin() const { return const_iterator(this, first()); }
+    const_iterator cend() const { return const_iterator(this, 0); }
+    const_iterator begin() const { return cbegin(); }
+    const_iterator end() const { return cend(); }
+
+    // Whether a value is in the collection
+    bool contains (BOUND value) const;
+
+    // The interval that holds value, or the end
+    const_iterator find (BOUND value) const;
+
+    // As for NumList: the first interval whose lower bound is not below, or
+    // is above, the given value.
+    const_iterator lower_bound (BOUND value) const;
+    const_iterator upper_bound (BOUND value) const;
+
+    // Number of intervals
+    std::size_t size() const
+        { return mLowers.empty() ? 0 : mLowers.size() - 1; }
+    bool empty() const { return size() == 0; }
+
+private:
+
+    // The position of the last lower bound not above value, or zero
+    std::size_t search_last_not_above (BOUND value) const;
+
+    // Positions in sorted order. Zero is the end.
+    std::size_t first() const;
+    std::size_t last() const;
+    std::size_t next (std::size_t pos) const;
+    std::size_t prev (std::size_t pos) const;
+
+    // Position zero is not used. Both are empty if there are no intervals.
+    std::vector<BOUND> mLowers;
+    std::vector<BOUND> mUppers;
+
+}; // class FrozenList
+
+} // namespace IPAR
+
+#endif // } IPAR_FROZEN_H_
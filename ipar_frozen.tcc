@@ -0,0 +1,165 @@
+#ifndef IPAR_FROZEN_TCC_ // {
+#define IPAR_FROZEN_TCC_
+
+namespace IPAR {
+
+namespace { // anonymous
+
+// How far down the tree a search prefetches: one cache line holds the
+// descendants of position k at positions k * stride and on.
+template<typename BOUND>
+constexpr std::size_t prefetch_stride()
+{
+    return (sizeof(BOUND) < 64) ? 64 / sizeof(BOUND) : 1;
+}
+
+} // namespace anonymous
+
+/////////////////////////////
+// FrozenList implementation
+/////////////////////////////
+
+template<typename BOUND>
+FrozenList<BOUND>::FrozenList() noexcept
+ : mLowers(), mUppers()
+{
+}
+
+template<typename BOUND>
+template<typename LIST>
+FrozenList<BOUND>::FrozenList(const LIST& list)
+ : mLowers(), mUppers()
+{
+    if (list.empty()) return;
+    mLowers.resize(list.size() + 1);
+    mUppers.resize(list.size() + 1);
+
+    // Visiting positions in sorted order places each interval
+    std::size_t pos = first();
+    for (auto iter = list.cbegin() ; iter != list.cend() ; ++iter)
+    {
+	mLowers[pos] = iter->first;
+	mUppers[pos] = iter->second;
+	pos = next(pos);
+    }
+}
+
+template<typename BOUND>
+std::size_t FrozenList<BOUND>::first() const
+{
+    std::size_t count = size();
+    if (count == 0) return 0;
+    std::size_t pos = 1;
+    while (pos * 2 <= count) pos *= 2;
+    return pos;
+}
+
+template<typename BOUND>
+std::size_t FrozenList<BOUND>::last() const
+{
+    std::size_t count = size();
+    if (count == 0) return 0;
+    std::size_t pos = 1;
+    while (pos * 2 + 1 <= count) pos = pos * 2 + 1;
+    return pos;
+}
+
+template<typename BOUND>
+std::size_t FrozenList<BOUND>::next (std::size_t pos) const
+{
+    // The leftmost position in the right subtree, if there is one
+    std::size_t count = size();
+    if (pos * 2 + 1 <= count)
+    {
+	pos = pos * 2 + 1;
+	while (pos * 2 <= count) pos *= 2;
+	return pos;
+    }
+
+    // Otherwise up to the first ancestor that this is left of
+    while (pos & 1) pos >>= 1;
+    return pos >> 1;
+}
+
+template<typename BOUND>
+std::size_t FrozenList<BOUND>::prev (std::size_t pos) const
+{
+    if (pos == 0) return last();
+
+    // The rightmost position in the left subtree, if there is one
+    std::size_t count = size();
+    if (pos * 2 <= count)
+    {
+	pos *= 2;
+	while (pos * 2 + 1 <= count) pos = pos * 2 + 1;
+	return pos;
+    }
+
+    // Otherwise up to the first ancestor that this is right of
+    while ((pos & 1) == 0) pos >>= 1;
+    return pos >> 1;
+}
+
+template<typename BOUND>
+std::size_t FrozenList<BOUND>::search_last_not_above (BOUND value) const
+{
+    // Each step goes right (a one bit in pos) if the lower bound is not
+    // above value. The answer is where the walk last went right: drop the
+    // trailing left turns, then that one.
+    const BOUND* lowers = mLowers.data();
+    std::size_t count = size();
+    std::size_t pos = 1;
+    while (pos <= count)
+    {
+	if (pos * prefetch_stride<BOUND>() <= count)
+	    __builtin_prefetch(lowers + pos * prefetch_stride<BOUND>());
+	pos = pos * 2 + (lowers[pos] <= value);
+    }
+    return pos >> (__builtin_ctzll(pos) + 1);
+}
+
+template<typename BOUND>
+bool FrozenList<BOUND>::contains (BOUND value) const
+{
+    std::size_t pos = search_last_not_above(value);
+    return (pos != 0) && (value <= mUppers[pos]);
+}
+
+template<typename BOUND>
+typename FrozenList<BOUND>::const_iterator
+FrozenList<BOUND>::find (BOUND value) const
+{
+    std::size_t pos = search_last_not_above(value);
+    if ((pos != 0) && (value <= mUppers[pos]))
+	return const_iterator(this, pos);
+    return cend();
+}
+
+template<typename BOUND>
+typename FrozenList<BOUND>::const_iterator
+FrozenList<BOUND>::lower_bound (BOUND value) const
+{
+    // As above, but the answer is where the walk last went left
+    const BOUND* lowers = mLowers.data();
+    std::size_t count = size();
+    std::size_t pos = 1;
+    while (pos <= count)
+    {
+	if (pos * prefetch_stride<BOUND>() <= count)
+	    __builtin_prefetch(lowers + pos * prefetch_stride<BOUND>());
+	pos = pos * 2 + (lowers[pos] < value);
+    }
+    return const_iterator(this, pos >> (__builtin_ctzll(~pos) + 1));
+}
+
+template<typename BOUND>
+typename FrozenList<BOUND>::const_iterator
+FrozenList<BOUND>::upper_bound (BOUND value) const
+{
+    std::size_t pos = search_last_not_above(value);
+    return (pos == 0) ? cbegin() : ++const_iterator(this, pos);
+}
+
+} // namespace IPAR
+
+#endif // } IPAR_FROZEN_TCC_
@@ -2,185 +2,289 @@
 // -------------------------
 // Reads a list of IP address ranges from standard input.
 // Compiles a sorted list of intervals that are dense.
-// ...
+// Input may mix IPv4 and IPv6, but only IPv4 is analyzed.
+// Each interval is extended to the end of the later interval that gives the
+// highest share of covered addresses, see ipar_gaps.h.
+// With -j N, input is parsed and intervals are analyzed on N threads. The
+// output is the same on any number of threads.
+// Options:
+//  * -search N: extensions start no more than N addresses past the start of
+//    the interval, 16M unless told otherwise.
+//  * -top K: report only the K best extensions, keeping no more than K of
+//    them in memory.
+//  * -min P: report only extensions with at least P percent of their
+//    addresses covered. Without -top, each one is written out as soon as it
+//    is found, in order of address, so that memory stays flat.
+//  * -prefixes: report aligned prefixes from /8 to /32 instead, in order of
+//    address: those with at least the -min share of addresses covered that
+//    are not inside another one reported. Does not go with -top.
+// Otherwise every extension is reported, in increasing order of score, and
+// on a tie in order of address.
 
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
 #include <iostream>
+#include <limits>
+#include <mutex>
 #include <string>
-#include <set>
+#include <cstddef>
 #include <cstdint>
-#include <limits>
+#include <vector>
+#include <unistd.h>
 using namespace std;
 #include "ipar_iplist.h"
 #include "ipar_common.h"
+#include "ipar_list6.h"
+#include "ipar_gaps.h"
+#include "ipar_threads.h"
 
-////////////
-// Tuning //
-////////////
+// Intervals per piece of work for a thread, and pieces per thread in each
+// round. Results are kept for one round at a time.
+const std::size_t grain = 4096;
+const std::size_t grains_per_round = 16;
 
-// Stop searching for gaps after this distance. Speeds up the program
-// tremendously.
-static const uint32_t max_search = 0x00FFFFFF;
-
-// Info about a range of IP addresses
-struct GapInfo
+// What to analyze and report, from the command line
+struct Options
 {
-    std::pair<uint32_t,uint32_t> mOriginalRange;
-    uint32_t mExpandedUpper;
-    uint32_t mNumCovered;
-    double mScore;
+    unsigned int mJobs;
+    uint32_t mMaxSearch;
+    std::size_t mTop;           // Zero for all
+    double mMinScore;           // Share of addresses, from 0 to 1
+    bool mPrefixes;             // Aligned prefixes rather than extensions
 };
-bool operator< (const GapInfo& left, const GapInfo& right)
-    { return (left.mScore < right.mScore); }
-using GapInfoSet = std::set<GapInfo>;
-
-// Compute score of a range wrt an IPAR list
-std::pair<uint32_t,double>  coverage (
-    uint32_t lower_bound, uint32_t upper_bound, const IPAR::List& list);
-// Note: there must exist a [lower_bound, ????] in the list.
-
-// Find extension of interval with the most coverage
-GapInfo max_coverage (
-    uint32_t lower_bound, uint32_t upper_bound, IPAR::List& list);
-// Note: [lower_bound, upper_bound] must belong to the list.
-
-// Compare one member of the input data list with another one, on the right.
-void my_process(
-    IPAR::List& iplist, GapInfoSet& gset,
-    uint32_t lower_bound, uint32_t upper_bound,
-    double& best_score, uint32_t& best_upper,
-    uint32_t other_lower_bound, uint32_t other_upper_bound);
-// Note: [lower_bound, upper_bound] must belong to the list.
-
-// Process one member of the input data list
-void my_process(
-    IPAR::List& iplist, GapInfoSet& gset,
-    uint32_t lower_bound, uint32_t upper_bound);
+
+// Shows on standard error how far the analysis has come, at most once per
+// percent. Any thread may report progress.
+class ProgressMeter
+{
+public:
+
+    // The automatic methods
+    ProgressMeter() = delete;
+    ~ProgressMeter() = default;
+    ProgressMeter(ProgressMeter const& other) = delete;
+    ProgressMeter& operator=(ProgressMeter const& other) = delete;
+    ProgressMeter(ProgressMeter&& other) = delete;
+    ProgressMeter& operator=(ProgressMeter&& other) = delete;
+
+    explicit ProgressMeter(std::size_t total)
+     : mTotal(total), mDone(0), mShown(0), mMutex() { }
+
+    // Some more intervals are done
+    void add (std::size_t count);
+
+    // Ends the line, if anything was shown
+    void finish ();
+
+private:
+
+    std::size_t mTotal;
+    std::atomic<std::size_t> mDone;
+    std::atomic<unsigned int> mShown;
+    std::mutex mMutex;
+
+}; // class ProgressMeter
+
+// Handle user request for a count, as in "-top K". Returns false unless the
+// argument is all digits and fits.
+bool o_count (const std::string& arg, unsigned long& count);
+
+// Handle user request for a percentage, as in "-min 12.5". Returns false
+// unless the argument is a number from 0 to 100.
+bool o_percent (const std::string& arg, double& share);
 
 // Process all members of the input data list
-void find_gaps(IPAR::List& iplist);
+void find_gaps(const IPAR::List& iplist, const Options& options);
+
+// Report on aligned prefixes of the input data list
+void find_prefixes(const IPAR::List& iplist, const Options& options);
 
-int main (int argc, char* /*argv*/[])
+// Write out one extension or prefix
+void report(const IPAR::GapInfo& entry);
+void report(const IPAR::PrefixInfo& prefix);
+
+int main (int argc, char* argv[])
 {
-    // No arguments allowed
-    if (argc != 1)
+    // Process options
+    Options options { 1, IPAR::default_max_search, 0, 0.0, false };
+    bool ok = true;
+    for (int iFirst = 1 ; ok && (iFirst < argc) ; ++iFirst)
     {
-        cerr << "Usage: ipar_gap_analyzer" << endl;
-	cerr << "(no arguments)" << endl;
+	std::string arg(argv[iFirst]);
+	if (arg == "-prefixes")
+	{
+	    options.mPrefixes = true;
+	    continue;
+	}
+	std::string value((iFirst + 1 < argc) ? argv[++iFirst] : "");
+	unsigned long count = 0;
+	if (arg == "-j")
+	    ok = ((options.mJobs = IPAR::o_jobs(value)) != 0);
+	else if (arg == "-search")
+	{
+	    ok = o_count(value, count) &&
+		(count <= std::numeric_limits<uint32_t>::max());
+	    options.mMaxSearch = static_cast<uint32_t>(count);
+	}
+	else if (arg == "-top")
+	{
+	    ok = o_count(value, count) && (count != 0);
+	    options.mTop = count;
+	}
+	else if (arg == "-min")
+	    ok = o_percent(value, options.mMinScore);
+	else
+	    ok = false;
+    }
+    if (!ok || (options.mPrefixes && (options.mTop != 0)))
+    {
+	cerr << "Usage: ipar_gap_analyzer [-j N] [-search N] [-top K]"
+	     << " [-min P]" << endl;
+	cerr << "       ipar_gap_analyzer [-j N] -prefixes [-min P]" << endl;
 	return 1;
     }
 
     IPAR::List iplist;
+    IPAR::List6 iplist6;
 
     // Loop over lines of input
-    if (int retval = IPAR::common_read (cin, iplist) != 0) return retval;
+    if (int retval =
+        IPAR::common_read (STDIN_FILENO, iplist, iplist6, options.mJobs) != 0)
+	return retval;
+    if (!iplist6.empty())
+    {
+	cerr << "NOTE: " << iplist6.size() << " IPv6 intervals ignored"
+	     << endl;
+    }
 
     // Analyze and report
-    find_gaps(iplist);
+    if (options.mPrefixes)
+	find_prefixes(iplist, options);
+    else
+	find_gaps(iplist, options);
 
     return 0;
 }
 
-// Process all members of the input data list
-void find_gaps(IPAR::List& iplist)
+void ProgressMeter::add (std::size_t count)
 {
-    GapInfoSet gset;
+    std::size_t done = (mDone += count);
+    unsigned int percent = static_cast<unsigned int>(done * 100 / mTotal);
+    if (percent <= mShown) return;
 
-    for (auto iter = iplist.cbegin() ; iter != iplist.cend() ; ++iter)
-    {
-	// Debug code
-	cerr << '.' << flush;
-	my_process(iplist, gset, iter->first, iter->second);
-    }
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (percent <= mShown) return;
+    mShown = percent;
+    cerr << '\r' << percent << "% done" << flush;
+}
 
-    // Report
-    for (auto entry : gset)
+void ProgressMeter::finish ()
+{
+    if (mShown != 0) cerr << endl;
+}
+
+bool o_count (const std::string& arg, unsigned long& count)
+{
+    count = 0;
+    if (arg.empty()) return false;
+    for (char digit : arg)
     {
-        cout << "["         << IPAR::int_to_quad(entry.mOriginalRange.first)
-	     << " "         << IPAR::int_to_quad(entry.mOriginalRange.second)
-	     << "] --> [- " << IPAR::int_to_quad(entry.mExpandedUpper)
-	     << "] : "      << entry.mNumCovered <<
-	     "" " i, "       << static_cast<int>((entry.mScore * 100) + 0.5)
-	     << "% of "     << 
-	         entry.mExpandedUpper - entry.mOriginalRange.first + 1
-             << endl;
+	if ((digit < '0') || (digit > '9')) return false;
+	if (count > (std::numeric_limits<unsigned long>::max() - 9) / 10)
+	    return false;
+	count = (count * 10) + static_cast<unsigned long>(digit - '0');
     }
+    return true;
 }
 
-// Process one member of the input data list
-void my_process(
-    IPAR::List& iplist, GapInfoSet& gset,
-    uint32_t lower_bound, uint32_t upper_bound)
-// Note: [lower_bound, upper_bound] must belong to the list.
+bool o_percent (const std::string& arg, double& share)
 {
-    GapInfo best = max_coverage (lower_bound, upper_bound, iplist);
-    gset.insert(best);
+    char* end = nullptr;
+    double percent = std::strtod(arg.c_str(), &end);
+    if (arg.empty() || (*end != '\0') || !(percent >= 0.0) ||
+        (percent > 100.0))
+	return false;
+    share = percent / 100;
+    return true;
 }
 
-GapInfo max_coverage (
-    uint32_t lower_bound, uint32_t upper_bound, IPAR::List& iplist)
+// Process all members of the input data list
+void find_gaps(const IPAR::List& iplist, const Options& options)
 {
-    GapInfo best {
-        make_pair(lower_bound, upper_bound),
-        upper_bound,
-	0,
-	0.0
-    };
-
-    // Set a limit of lower_bound + max_search, being careful of numeric
-    // overflow.
-    uint32_t bmax = std::numeric_limits<uint32_t>::max();
-    uint32_t my_max = iplist.max();
-    // if (lower_bound + max_search > bmax)
-    if (bmax - lower_bound < max_search) 
-    {
-        // my_max unchanged.
-    }
-    else
-    {
-	uint32_t test_val = lower_bound + max_search;
-	if (test_val < my_max)
-	    my_max = test_val;
-    }
+    // Each thread keeps a search of its own, which is quickest when it gets
+    // to go from one interval to the next. The intervals are taken in rounds,
+    // and each round hands its results on in order of interval, so that the
+    // output is the same on any number of threads.
+    IPAR::CoverageIndex index(iplist);
+    std::vector<IPAR::ExtensionSearch> searches(options.mJobs,
+        IPAR::ExtensionSearch(index, options.mMaxSearch));
+    std::size_t round = grain * grains_per_round * options.mJobs;
+    std::vector<IPAR::GapInfo> results(std::min(round, index.size()));
+    ProgressMeter progress(index.size());
 
-    for (auto iter = iplist.lower_bound(lower_bound) ; iter != iplist.cend() ;
-         ++iter)
-    {
-	// Skip own self
-	if (iter->first == lower_bound) continue;
+    // Where the results go: a bounded heap, straight out, or all of them
+    // to be sorted
+    bool stream = (options.mTop == 0) && (options.mMinScore > 0.0);
+    IPAR::TopGaps top(options.mTop);
+    std::vector<IPAR::GapInfo> all;
 
-	// Stop when we run past the upper limit
-	if (iter->first > my_max) break;
+    for (std::size_t first = 0 ; first < index.size() ; first += round)
+    {
+	std::size_t count = std::min(round, index.size() - first);
+	IPAR::parallel_ranges(options.mJobs, count, grain,
+	    [&](unsigned int thread, std::size_t begin, std::size_t end)
+	{
+	    for (std::size_t slot = begin ; slot < end ; ++slot)
+		results[slot] = searches[thread].find(first + slot);
+	    progress.add(end - begin);
+	});
 
-	// Compute a score for this candidate
-	auto cov = coverage (lower_bound, iter->second, iplist);
-	if (cov.second > best.mScore)
+	for (std::size_t slot = 0 ; slot < count ; ++slot)
 	{
-	    best.mExpandedUpper = iter->second;
-	    best.mNumCovered = cov.first;
-	    best.mScore = cov.second;
+	    const IPAR::GapInfo& entry = results[slot];
+	    if (entry.mScore < options.mMinScore)
+		continue;
+	    else if (options.mTop != 0)
+		top.add(entry);
+	    else if (stream)
+		report(entry);
+	    else
+		all.push_back(entry);
 	}
     }
-    return best;
+    progress.finish();
+
+    if (options.mTop != 0) all = top.sorted();
+    else std::sort(all.begin(), all.end(), IPAR::reported_before);
+    for (const auto& entry : all) report(entry);
+    cout << flush;
 }
 
-// Compute score of a range wrt an IPAR list
-std::pair<uint32_t,double>  coverage (
-    uint32_t lower_bound, uint32_t upper_bound, const IPAR::List& iplist)
-// Note: there must exist a [lower_bound, ????] in the list.
+// Report on aligned prefixes of the input data list
+void find_prefixes(const IPAR::List& iplist, const Options& options)
 {
-    std::pair<uint32_t,double> cov {0, 0.0};
+    IPAR::dense_prefixes(iplist, options.mMinScore,
+        [](const IPAR::PrefixInfo& prefix) { report(prefix); });
+    cout << flush;
+}
 
-    for (auto iter = iplist.lower_bound(lower_bound) ; iter != iplist.cend() ;
-         ++iter)
-    {
-	uint32_t inter_lower_bound, inter_upper_bound;
-	if (!IPAR::intersect (lower_bound, upper_bound,
-			     iter->first, iter->second,
-			     inter_lower_bound, inter_upper_bound))
-	break;
-	++cov.first;
-	cov.second += (inter_upper_bound - inter_lower_bound + 1);
-    }
-    cov.second = cov.second / (upper_bound - lower_bound + 1);
-    return cov;
+void report(const IPAR::GapInfo& entry)
+{
+    cout << "["         << IPAR::int_to_quad(entry.mOriginalRange.first)
+	 << " "         << IPAR::int_to_quad(entry.mOriginalRange.second)
+	 << "] --> [- " << IPAR::int_to_quad(entry.mExpandedUpper)
+	 << "] : "      << entry.mNumCovered <<
+	 "" " i, "       << static_cast<int>((entry.mScore * 100) + 0.5)
+	 << "% of "     << 
+	     entry.mExpandedUpper - entry.mOriginalRange.first + 1
+	 << '\n';
+}
+
+void report(const IPAR::PrefixInfo& prefix)
+{
+    cout << IPAR::int_to_quad(prefix.mLower) << '/' << prefix.mLength
+	 << " : " << prefix.mNumCovered << " of "
+	 << (static_cast<uint64_t>(1) << (32 - prefix.mLength)) << ", "
+	 << static_cast<int>((prefix.mScore * 100) + 0.5) << "%\n";
 }
@@ -0,0 +1,356 @@
+#include <algorithm>
+#include <limits>
+#include "ipar_gaps.h"
+
+namespace IPAR
+{
+
+namespace { // anonymous
+
+// Wide enough for the product of two differences of 33-bit values. A GCC
+// extension, hence the keyword.
+__extension__ typedef unsigned __int128 wide_t;
+
+// Where a candidate is in the plane, across. One past its upper bound, which
+// may be 2^32.
+inline uint64_t end_of (const CoverageIndex& index, std::size_t candidate)
+{
+    return static_cast<uint64_t>(index.upper(candidate)) + 1;
+}
+
+// Number of prefix lengths that dense_prefixes looks at
+const unsigned int num_lengths = 32 - shortest_prefix + 1;
+
+// Addresses in a prefix of some length, and its first address
+inline uint64_t prefix_size (unsigned int length)
+{
+    return static_cast<uint64_t>(1) << (32 - length);
+}
+
+inline uint32_t prefix_of (uint32_t address, unsigned int length)
+{
+    return address & static_cast<uint32_t>(~(prefix_size(length) - 1));
+}
+
+} // namespace anonymous
+
+
+///////////////////////////////////////////
+// Implementation of stand-alone functions
+///////////////////////////////////////////
+
+bool reported_before (const GapInfo& left, const GapInfo& right)
+{
+    if (left.mScore != right.mScore) return left.mScore < right.mScore;
+    return left.mOriginalRange.first < right.mOriginalRange.first;
+}
+
+void dense_prefixes (const List& list, double min_score,
+                     const std::function<void(const PrefixInfo&)>& report)
+{
+    // The prefixes of every length that hold the last block, with what is
+    // covered of each so far. The first "depth" of them, from /8 on, are
+    // current. A block counts only in its own prefix, and each count rolls
+    // up into the prefix above when it is finished. Dense prefixes wait in
+    // "found" until their /8 is done, since one that holds them may still
+    // turn out to be dense.
+    uint32_t lowers[num_lengths];
+    uint64_t counts[num_lengths];
+    unsigned int depth = 0;
+    std::vector<PrefixInfo> found;
+
+    // Finish all but the first "keep" current prefixes, longest first
+    auto finish = [&](unsigned int keep)
+    {
+	while (depth > keep)
+	{
+	    --depth;
+	    unsigned int length = shortest_prefix + depth;
+	    double score = static_cast<double>(counts[depth]) /
+		static_cast<double>(prefix_size(length));
+	    if (score >= min_score)
+	    {
+		while (!found.empty() &&
+		       (found.back().mLower >= lowers[depth]))
+		    found.pop_back();
+		found.push_back(PrefixInfo { lowers[depth], length,
+		                             counts[depth], score });
+	    }
+	    if (depth != 0) counts[depth - 1] += counts[depth];
+	}
+	if (depth == 0)
+	{
+	    for (const auto& prefix : found) report(prefix);
+	    found.clear();
+	}
+    };
+
+    for (auto iter = list.cbegin() ; iter != list.cend() ; ++iter)
+    {
+	// Cut the interval into the largest aligned blocks that fit, of a /8
+	// at most. Careful of numeric overflow at the top.
+	uint64_t lower = iter->first;
+	uint64_t end = static_cast<uint64_t>(iter->second) + 1;
+	while (lower < end)
+	{
+	    // Bounded by the alignment of its start and by what is left
+	    uint32_t block = static_cast<uint32_t>(lower);
+	    int bits = 32 - static_cast<int>(shortest_prefix);
+	    if (block != 0) bits = std::min(bits, __builtin_ctz(block));
+	    bits = std::min(bits, 63 - __builtin_clzll(end - lower));
+	    unsigned int length = static_cast<unsigned int>(32 - bits);
+	    lower += prefix_size(length);
+
+	    // Keep the current prefixes that hold the block, finish the rest
+	    // from the bottom up, and start new ones down to the block itself.
+	    // Since prefixes nest, the ones to keep are those above the
+	    // longest that holds the block, so each one is looked at about as
+	    // often as it is started.
+	    unsigned int levels = length - shortest_prefix + 1;
+	    unsigned int keep = std::min(depth, levels);
+	    while ((keep > 0) && (lowers[keep - 1] !=
+	           prefix_of(block, shortest_prefix + keep - 1)))
+		--keep;
+	    finish(keep);
+	    for ( ; depth < levels ; ++depth)
+	    {
+		lowers[depth] = prefix_of(block, shortest_prefix + depth);
+		counts[depth] = 0;
+	    }
+	    counts[depth - 1] += prefix_size(length);
+	}
+    }
+    finish(0);
+}
+
+
+///////////////////////////////////
+// Implementation of TopGaps class
+///////////////////////////////////
+
+TopGaps::TopGaps(std::size_t count)
+ : mCount(count), mHeap()
+{
+    mHeap.reserve(count);
+}
+
+void TopGaps::add (const GapInfo& gap)
+{
+    // A heap whose top is the one that goes first: reversed report order
+    auto after = [](const GapInfo& left, const GapInfo& right)
+        { return reported_before(right, left); };
+    if (mHeap.size() < mCount)
+    {
+	mHeap.push_back(gap);
+	std::push_heap(mHeap.begin(), mHeap.end(), after);
+    }
+    else if ((mCount != 0) && reported_before(mHeap.front(), gap))
+    {
+	std::pop_heap(mHeap.begin(), mHeap.end(), after);
+	mHeap.back() = gap;
+	std::push_heap(mHeap.begin(), mHeap.end(), after);
+    }
+}
+
+std::vector<GapInfo> TopGaps::sorted() const
+{
+    std::vector<GapInfo> result(mHeap);
+    std::sort(result.begin(), result.end(), reported_before);
+    return result;
+}
+
+
+/////////////////////////////////////////
+// Implementation of CoverageIndex class
+/////////////////////////////////////////
+
+CoverageIndex::CoverageIndex(const List& list)
+ : mLower(), mUpper(), mSums()
+{
+    mLower.reserve(list.size());
+    mUpper.reserve(list.size());
+    mSums.reserve(list.size() + 1);
+    mSums.push_back(0);
+    for (auto iter = list.cbegin() ; iter != list.cend() ; ++iter)
+    {
+	mLower.push_back(iter->first);
+	mUpper.push_back(iter->second);
+	mSums.push_back(mSums.back() + (iter->second - iter->first) + 1);
+    }
+}
+
+
+///////////////////////////////////////////
+// Implementation of ExtensionSearch class
+///////////////////////////////////////////
+
+ExtensionSearch::ExtensionSearch(const CoverageIndex& index,
+                                 uint32_t max_search)
+ : mIndex(&index), mMaxSearch(max_search), mBegin(0), mPivot(0), mEnd(0),
+   mLeft(), mLeftSize(0), mUndo(), mRight()
+{
+}
+
+GapInfo ExtensionSearch::find (std::size_t interval)
+{
+    const CoverageIndex& index = *mIndex;
+    uint32_t lower = index.lower(interval);
+    uint32_t upper = index.upper(interval);
+    std::size_t first = interval + 1;
+
+    // Going back means starting over
+    if (first < mBegin)
+    {
+	clear();
+	mBegin = first;
+	mPivot = first;
+	mEnd = first;
+    }
+
+    // Take off candidates that are now behind. Once the left hull runs out,
+    // whatever is still wanted of the right one makes up a new left hull.
+    while ((mBegin < first) && (mBegin < mPivot))
+    {
+	pop_left();
+	++mBegin;
+    }
+    if (mBegin < first)
+    {
+	std::size_t end = std::max(first, mEnd);
+	std::size_t moved = mEnd;
+	clear();
+	for (std::size_t candidate = moved ; candidate > first ; --candidate)
+	    push_left(candidate - 1);
+	mBegin = first;
+	mPivot = end;
+	mEnd = end;
+    }
+
+    // Add new candidates, being careful of numeric overflow
+    uint32_t limit = std::numeric_limits<uint32_t>::max();
+    if (limit - lower >= mMaxSearch) limit = lower + mMaxSearch;
+    while ((mEnd < index.size()) && (index.lower(mEnd) <= limit))
+	push_right(mEnd++);
+
+    GapInfo best { std::make_pair(lower, upper), upper, 0, 0.0 };
+    if (mBegin == mEnd) return best;
+
+    // The best of each hull, the left one winning a tie
+    std::size_t winner = mEnd;
+    if (mLeftSize != 0)
+    {
+	winner = best_on(interval, mLeftSize, [this](std::size_t position)
+	    { return mLeft[mLeftSize - 1 - position]; });
+    }
+    if (!mRight.empty())
+    {
+	std::size_t candidate = best_on(interval, mRight.size(),
+	    [this](std::size_t position) { return mRight[position]; });
+	if ((winner == mEnd) || better(interval, candidate, winner))
+	    winner = candidate;
+    }
+
+    best.mExpandedUpper = index.upper(winner);
+    best.mNumCovered = static_cast<uint32_t>(winner - interval + 1);
+    best.mScore = static_cast<double>(index.covered(interval, winner)) /
+	static_cast<double>(end_of(index, winner) - lower);
+    return best;
+}
+
+void ExtensionSearch::push_left (std::size_t candidate)
+{
+    // The new hull keeps a prefix of the old one, up to the last point that
+    // is not below the line from the candidate to the point before it.
+    // Rather than pop those that go, find where the candidate goes and
+    // overwrite that one place, so that it can be put back.
+    std::size_t position = 0;
+    if (mLeftSize != 0)
+    {
+	std::size_t low = 0;
+	std::size_t high = mLeftSize - 1;
+	while (low < high)
+	{
+	    std::size_t middle = (low + high + 1) / 2;
+	    if (below(candidate, mLeft[middle], mLeft[middle - 1]))
+		high = middle - 1;
+	    else
+		low = middle;
+	}
+	position = low + 1;
+    }
+
+    if (position == mLeft.size()) mLeft.push_back(candidate);
+    mUndo.push_back(Undo { mLeftSize, position, mLeft[position] });
+    mLeft[position] = candidate;
+    mLeftSize = position + 1;
+}
+
+void ExtensionSearch::pop_left ()
+{
+    const Undo& undo = mUndo.back();
+    mLeft[undo.mPosition] = undo.mOverwritten;
+    mLeftSize = undo.mSize;
+    mUndo.pop_back();
+}
+
+void ExtensionSearch::push_right (std::size_t candidate)
+{
+    while ((mRight.size() >= 2) &&
+           below(mRight[mRight.size() - 2], mRight.back(), candidate))
+	mRight.pop_back();
+    mRight.push_back(candidate);
+}
+
+void ExtensionSearch::clear ()
+{
+    mLeftSize = 0;
+    mUndo.clear();
+    mRight.clear();
+}
+
+template<typename HULL>
+std::size_t ExtensionSearch::best_on (std::size_t interval, std::size_t size,
+                                      HULL hull) const
+{
+    // Along the hull, scores rise to the best one and then fall
+    std::size_t low = 0;
+    std::size_t high = size - 1;
+    while (low < high)
+    {
+	std::size_t middle = (low + high) / 2;
+	if (better(interval, hull(middle + 1), hull(middle)))
+	    low = middle + 1;
+	else
+	    high = middle;
+    }
+    return hull(low);
+}
+
+bool ExtensionSearch::better (std::size_t interval, std::size_t first,
+                              std::size_t second) const
+{
+    // Both slopes are from (x, y), and all differences are positive
+    const CoverageIndex& index = *mIndex;
+    uint64_t x = index.lower(interval);
+    uint64_t y = index.covered_before(interval);
+    wide_t first_dx = end_of(index, first) - x;
+    wide_t first_dy = index.covered_before(first + 1) - y;
+    wide_t second_dx = end_of(index, second) - x;
+    wide_t second_dy = index.covered_before(second + 1) - y;
+    return first_dy * second_dx > second_dy * first_dx;
+}
+
+bool ExtensionSearch::below (std::size_t left, std::size_t middle,
+                             std::size_t right) const
+{
+    const CoverageIndex& index = *mIndex;
+    uint64_t x = end_of(index, left);
+    uint64_t y = index.covered_before(left + 1);
+    wide_t middle_dx = end_of(index, middle) - x;
+    wide_t middle_dy = index.covered_before(middle + 1) - y;
+    wide_t right_dx = end_of(index, right) - x;
+    wide_t right_dy = index.covered_before(right + 1) - y;
+    return middle_dy * right_dx < right_dy * middle_dx;
+}
+
+} // namespace IPAR
@@ -0,0 +1,223 @@
+////////////////////////////////////////////////////////
+// Searches for stretches and prefixes of a list of IP
+// addresses that are almost dense, for ipar_gap_analyzer.
+////////////////////////////////////////////////////////
+
+#ifndef IPAR_GAPS_H_ // {
+#define IPAR_GAPS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+#include "ipar_iplist.h"
+
+namespace IPAR {
+
+// How far past the start of an interval its extensions may start, unless
+// told otherwise. Speeds up the search tremendously.
+const uint32_t default_max_search = 0x00FFFFFF;
+
+// An interval of a list, and its best extension: the range from its start
+// to the end of a later interval with the highest share of addresses that
+// are in the list. Without any later interval in reach, the extension is
+// the interval itself, with a score of zero.
+struct GapInfo
+{
+    std::pair<uint32_t,uint32_t> mOriginalRange;
+    uint32_t mExpandedUpper;
+    uint32_t mNumCovered;       // Intervals in the extension
+    double mScore;              // Share of addresses in the list
+};
+
+// The order in which extensions are reported: by score, and on a tie by
+// where they start. No two intervals of a list start at the same address, so
+// this is a total order.
+bool reported_before (const GapInfo& left, const GapInfo& right);
+
+// Keeps the last "count" extensions, in report order, of all those it is
+// given, in memory for "count" of them. Each one costs O(log count).
+class TopGaps
+{
+public:
+
+    // The automatic methods
+    TopGaps() = delete;
+    ~TopGaps() = default;
+    TopGaps(TopGaps const& other) = default;
+    TopGaps& operator=(TopGaps const& other) = default;
+    TopGaps(TopGaps&& other) = default;
+    TopGaps& operator=(TopGaps&& other) = default;
+
+    explicit TopGaps(std::size_t count);
+
+    // Offers one more extension
+    void add (const GapInfo& gap);
+
+    // The ones kept, in report order
+    std::vector<GapInfo> sorted() const;
+
+    std::size_t size() const { return mHeap.size(); }
+
+private:
+
+    std::size_t mCount;
+    std::vector<GapInfo> mHeap; // The first one in report order on top
+
+}; // class TopGaps
+
+// The intervals of a list in arrays, with prefix sums of their sizes, so
+// that the addresses covered by any run of intervals are known in O(1).
+class CoverageIndex
+{
+public:
+
+    // The automatic methods
+    CoverageIndex() = delete;
+    ~CoverageIndex() = default;
+    CoverageIndex(CoverageIndex const& other) = default;
+    CoverageIndex& operator=(CoverageIndex const& other) = default;
+    CoverageIndex(CoverageIndex&& other) = default;
+    CoverageIndex& operator=(CoverageIndex&& other) = default;
+
+    explicit CoverageIndex(const List& list);
+
+    // Number of intervals, and the bounds of each one
+    std::size_t size() const { return mLower.size(); }
+    uint32_t lower (std::size_t index) const { return mLower[index]; }
+    uint32_t upper (std::size_t index) const { return mUpper[index]; }
+
+    // Addresses in the intervals before an index
+    uint64_t covered_before (std::size_t index) const
+        { return mSums[index]; }
+
+    // Addresses in intervals first through last
+    uint64_t covered (std::size_t first, std::size_t last) const
+        { return mSums[last + 1] - mSums[first]; }
+
+private:
+
+    std::vector<uint32_t> mLower;
+    std::vector<uint32_t> mUpper;
+    std::vector<uint64_t> mSums;
+
+}; // class CoverageIndex
+
+// Finds the best extension of intervals of a CoverageIndex. The candidates
+// for interval i are the intervals j > i that start no more than max_search
+// past its start.
+//
+// Candidate j is the point (upper(j) + 1, covered_before(j + 1)) in the
+// plane, and its score from interval i is the slope of the line to it from
+// (lower(i), covered_before(i)). The best candidate is then on the upper
+// convex hull of the candidates, where a binary search finds it. The hull
+// follows the candidates as they slide to the right: new ones are added to
+// one hull on the right, and old ones are taken off another one on the left,
+// which is built so that each addition can be undone. Each interval costs
+// O(log n), amortized. Slopes are compared exactly. On a tie, the earliest
+// candidate wins.
+class ExtensionSearch
+{
+public:
+
+    // The automatic methods
+    ExtensionSearch() = delete;
+    ~ExtensionSearch() = default;
+    ExtensionSearch(ExtensionSearch const& other) = default;
+    ExtensionSearch& operator=(ExtensionSearch const& other) = default;
+    ExtensionSearch(ExtensionSearch&& other) = default;
+    ExtensionSearch& operator=(ExtensionSearch&& other) = default;
+
+    // The index must outlive the search.
+    ExtensionSearch(const CoverageIndex& index,
+                    uint32_t max_search = default_max_search);
+
+    // The best extension of an interval. Calls are quickest for intervals
+    // in increasing order, some of which may be skipped. Going back to an
+    // earlier interval starts the search over.
+    GapInfo find (std::size_t interval);
+
+private:
+
+    // A change to the left hull, for undoing it
+    struct Undo
+    {
+	std::size_t mSize;
+	std::size_t mPosition;
+	std::size_t mOverwritten;
+    };
+
+    // Adds a candidate to the left of the left hull, and takes the last one
+    // added off again
+    void push_left (std::size_t candidate);
+    void pop_left ();
+
+    // Adds a candidate to the right of the right hull
+    void push_right (std::size_t candidate);
+
+    // Takes everything off both hulls
+    void clear ();
+
+    // The candidate on a hull with the best score from an interval. The
+    // hull is given as a function from position, left to right, to
+    // candidate.
+    template<typename HULL>
+    std::size_t best_on (std::size_t interval, std::size_t size,
+                         HULL hull) const;
+
+    // Whether candidate "first" scores better than "second" from an
+    // interval, and whether "middle" is strictly below the line from "left"
+    // to "right".
+    bool better (std::size_t interval, std::size_t first,
+                 std::size_t second) const;
+    bool below (std::size_t left, std::size_t middle,
+                std::size_t right) const;
+
+    const CoverageIndex* mIndex;
+    uint32_t mMaxSearch;
+
+    // Candidates in [mBegin, mPivot) are on the left hull, and those in
+    // [mPivot, mEnd) on the right one.
+    std::size_t mBegin;
+    std::size_t mPivot;
+    std::size_t mEnd;
+
+    // Right to left, with mLeftSize in use
+    std::vector<std::size_t> mLeft;
+    std::size_t mLeftSize;
+    std::vector<Undo> mUndo;
+
+    // Left to right
+    std::vector<std::size_t> mRight;
+
+}; // class ExtensionSearch
+
+// Shortest prefix that dense_prefixes looks at
+const unsigned int shortest_prefix = 8;
+
+// An aligned prefix, such as 10.1.0.0/16, and how much of it is in a list
+struct PrefixInfo
+{
+    uint32_t mLower;
+    unsigned int mLength;       // Bits in the prefix, 8 to 32
+    uint64_t mNumCovered;       // Addresses in the list
+    double mScore;              // Share of addresses in the list
+};
+
+// Reports, in order of address, the prefixes from /8 to /32 with a share of
+// at least min_score of their addresses in a list, leaving out those inside
+// a prefix that is reported. Every prefix that holds part of the list is
+// counted: the intervals are cut into aligned blocks, each block is counted
+// in its own prefix, and counts roll up into the prefix above as each one is
+// finished. Only the prefixes that hold the current block are kept. Each
+// prefix is started and finished once. Those for one interval are its
+// blocks, at most 48 unless it spans whole /8s, and the prefixes on the
+// paths to its two ends, at most 50. Time is O(32 n) for n intervals, and
+// memory is that of the reports for one /8.
+void dense_prefixes (const List& list, double min_score,
+                     const std::function<void(const PrefixInfo&)>& report);
+
+} // namespace IPAR
+
+#endif // } IPAR_GAPS_H_
@@ -10,14 +10,15 @@
 //    * intervals, with dashes.
 //    * individual 32-bit numbers, in hex format.
 // The last format is useful for testing.
+// IPv6 ranges may be mixed in, and are written out after the IPv4 ones.
 
 #include <iostream>
-#include <iomanip>
 #include <string>
 #include <cstring>
 using namespace std;
 #include "ipar_iplist.h"
 #include "ipar_common.h"
+#include "ipar_list6.h"
 
 int main (int argc, char* argv[])
 {
@@ -30,7 +31,8 @@ int main (int argc, char* argv[])
         break;
     case 2:
         style = IPAR::o_style(argv[1]);
-	if (style == IPAR::Sunknown)
+	if ((style == IPAR::Sunknown) || (style == IPAR::Sbinary) ||
+	    (style == IPAR::Sraw))
 	{
 	    cerr << "Usage: ipar_interactive [-cidr|-dashes|-hex]" << endl;
 	    cerr << "(no other arguments)" << endl;
@@ -43,9 +45,7 @@ int main (int argc, char* argv[])
 	return 1;
     }
 
-    // Modify output format if necessary
-    if (style == IPAR::Shex) cout << hex << setfill('0');
-
+    IPAR::Writer out(cout);
     string line;
     cout << "> " << flush;
     while (getline(cin, line))
@@ -54,6 +54,7 @@ int main (int argc, char* argv[])
 	string word;
 	istringstream sstr(line);
 	IPAR::List iplist;
+	IPAR::List6 iplist6;
 	while (sstr >> word)
 	{
 	    // Ignore comments to end of line
@@ -62,34 +63,30 @@ int main (int argc, char* argv[])
 		word = "";
 		break;
 	    }
-	    IPAR::Range iprange;
 	    try {
-		iprange = IPAR::Range(word);
+		if (IPAR::is_ipv6(word))
+		    iplist6.add (IPAR::Range6(word));
+		else
+		    iplist.add (IPAR::Range(word));
 	    }
 	    catch (const exception& ex) {
 		cerr << "ERROR: could not parse \"" << word << "\"" << endl;
 	        break;
 	    }
-	    iplist.add (iprange);
 	}
 
 	// Report from one line of input
 	if (style == IPAR::Shex)
 	{
-	    cout << hex << setfill('0');
-            for (auto iter = iplist.cbegin() ; iter != iplist.cend() ; ++iter)
-	    {
-		uint32_t lower = iter->first;
-		while (lower <= iter->second)
-		{
-		    cout << setw(8) << lower++ << endl;
-		}
-	    }
+	    iplist.expand(out, IPAR::Ehex);
+	    iplist6.expand(out, IPAR::Ehex);
 	}
 	else
 	{
-	    iplist.print(cout, (style == IPAR::Sdashes));
+	    iplist.print(out, (style == IPAR::Sdashes));
+	    iplist6.print(out, (style == IPAR::Sdashes));
 	}
+	out.flush();
 	cout << "> " << flush;
     }
 
@@ -1,67 +1,140 @@
+#include <cstring>
 #include <iostream>
 #include <limits>
+#include <memory>
+#include <vector>
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#endif
 #include "ipar_iplist.h"
+#include "ipar_list6.h"
 #include "ipar_numlist.h"
+#include "ipar_threads.h"
 
 namespace IPAR
 {
 
 namespace { // anonymous
 
-uint32_t string_to_int(const std::string& expr)
-{
-    uint32_t retval = 0;
-    std::string sub(expr);
-    while (sub != "")
-    {
-	char digit = sub[0];
-	int idigit = static_cast<int>(digit) - '0';
-	if ((idigit < 0) || (idigit > 9)) throw (ip_domain_error());
-	retval = (retval * 10 ) + idigit;
-	sub = sub.substr(1, std::string::npos);
-    }
-    return retval;
-}
+#if defined(__x86_64__) && defined(__GNUC__) // {
 
-std::string int8_to_string(uint32_t val)
-{
-    std::stringstream ss;
-    ss << val;
-    return ss.str();
-}
+// Vectorized dotted quad parser, SSE4.1. Only takes the common case: four
+// octets of one to three digits each, with values up to 255. Returns false
+// for anything else, and the scalar parser sorts it out.
 
-int count_trailing_zeroes(uint32_t val)
+// One byte shuffle for each combination of octet lengths. Each octet ends up
+// right-aligned in its own 32-bit lane as (hundreds, tens, units, 0).
+struct QuadShuffles
 {
-    if (val == 0) return 32;
-    static const int MultiplyDeBruijnBitPosition[32] = 
-    {
-      0, 1, 28, 2, 29, 14, 24, 3, 30, 22, 20, 15, 25, 17, 4, 8, 
-      31, 27, 13, 23, 21, 19, 16, 7, 26, 12, 18, 6, 11, 5, 10, 9
-    };
-    return
-	MultiplyDeBruijnBitPosition[((val & -val) * 0x077CB531U) >> 27];
-}
+    unsigned char mTable[81][16];
 
-int log2(uint32_t val)
-{
-    #define LT(n) n, n, n, n, n, n, n, n, n, n, n, n, n, n, n, n
-    static const char LogTable256[256] = 
-    {
-	-1, 0, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3,
-	LT(4), LT(5), LT(5), LT(6), LT(6), LT(6), LT(6),
-	LT(7), LT(7), LT(7), LT(7), LT(7), LT(7), LT(7), LT(7)
-    };
-
-    uint32_t t, tt; // temporaries
-
-    if ((tt = (val >> 16)) != 0)
+    constexpr QuadShuffles() : mTable{}
     {
-      return (t = (tt >> 8)) ? 24 + LogTable256[t] : 16 + LogTable256[tt];
+	for (int index = 0 ; index < 81 ; ++index)
+	{
+	    int start = 0;
+	    int code = index;
+	    for (int octet = 0 ; octet < 4 ; ++octet)
+	    {
+		int divisor = (octet == 0) ? 27 : (octet == 1) ? 9 :
+		              (octet == 2) ? 3 : 1;
+		int len = (code / divisor) + 1;
+		code %= divisor;
+		for (int lane = 0 ; lane < 4 ; ++lane)
+		    mTable[index][4*octet + lane] = 0x80;
+		for (int k = 0 ; k < len ; ++k)
+		{
+		    mTable[index][4*octet + (3 - len) + k] =
+			static_cast<unsigned char>(start + k);
+		}
+		start += len + 1;
+	    }
+	}
     }
-    else 
+};
+constexpr QuadShuffles quad_shuffles;
+
+__attribute__((target("sse4.1")))
+bool sse_quad_to_int(const char* begin, std::size_t len, uint32_t& result)
+{
+    // Callers guarantee 7 <= len <= 15, so a zero padded copy is safe to
+    // load.
+    alignas(16) char buf[16] = {};
+    std::memcpy(buf, begin, len);
+    __m128i text = _mm_load_si128(reinterpret_cast<const __m128i*>(buf));
+
+    // Classify characters
+    unsigned int lenmask = (1u << len) - 1;
+    __m128i digits = _mm_sub_epi8(text, _mm_set1_epi8('0'));
+    unsigned int dots = static_cast<unsigned int>(_mm_movemask_epi8(
+        _mm_cmpeq_epi8(text, _mm_set1_epi8('.')))) & lenmask;
+    unsigned int decimals = static_cast<unsigned int>(_mm_movemask_epi8(
+        _mm_cmpeq_epi8(_mm_min_epu8(digits, _mm_set1_epi8(9)), digits)))
+	& lenmask;
+    if (((dots | decimals) != lenmask) || (__builtin_popcount(dots) != 3))
+	return false;
+
+    // Lengths of octets
+    unsigned int dot1 = static_cast<unsigned int>(__builtin_ctz(dots));
+    dots &= dots - 1;
+    unsigned int dot2 = static_cast<unsigned int>(__builtin_ctz(dots));
+    dots &= dots - 1;
+    unsigned int dot3 = static_cast<unsigned int>(__builtin_ctz(dots));
+    unsigned int len0 = dot1;
+    unsigned int len1 = dot2 - dot1 - 1;
+    unsigned int len2 = dot3 - dot2 - 1;
+    unsigned int len3 = static_cast<unsigned int>(len) - dot3 - 1;
+    if ((len0 - 1 > 2) || (len1 - 1 > 2) || (len2 - 1 > 2) || (len3 - 1 > 2))
+	return false;
+    unsigned int index =
+        (len0 - 1) * 27 + (len1 - 1) * 9 + (len2 - 1) * 3 + (len3 - 1);
+
+    // Gather digits and multiply out
+    __m128i shuffle = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(quad_shuffles.mTable[index]));
+    __m128i gathered = _mm_shuffle_epi8(digits, shuffle);
+    __m128i pairs = _mm_maddubs_epi16(
+        gathered, _mm_setr_epi8(100, 10, 1, 0, 100, 10, 1, 0,
+	                        100, 10, 1, 0, 100, 10, 1, 0));
+    __m128i octets = _mm_madd_epi16(pairs, _mm_set1_epi16(1));
+    if (_mm_movemask_epi8(_mm_cmpgt_epi32(octets, _mm_set1_epi32(255))))
+	return false;
+
+    // Narrow to bytes, most significant octet first
+    __m128i bytes = _mm_packus_epi16(_mm_packus_epi32(octets, octets), octets);
+    result = __builtin_bswap32(
+        static_cast<uint32_t>(_mm_cvtsi128_si32(bytes)));
+    return true;
+}
+
+bool detect_sse41()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.1");
+}
+const bool have_sse41 = detect_sse41();
+
+#endif // } __x86_64__
+
+inline uint32_t parse_quad(const char* begin, const char* end)
+{
+#if defined(__x86_64__) && defined(__GNUC__)
+    std::size_t len = static_cast<std::size_t>(end - begin);
+    uint32_t result;
+    if (have_sse41 && (len >= 7) && (len <= 15) &&
+        sse_quad_to_int(begin, len, result))
     {
-      return (t = (val >> 8)) ? 8 + LogTable256[t] : LogTable256[val];
+	return result;
     }
+#endif
+    return scalar_quad_to_int(
+        std::string_view(begin, static_cast<std::size_t>(end - begin)));
+}
+
+// Position of the highest bit that is set. Undefined for zero.
+inline int log2(uint32_t val)
+{
+    return 31 - __builtin_clz(val);
 }
 
 int ceil_log2(uint32_t val)
@@ -70,45 +143,19 @@ int ceil_log2(uint32_t val)
     if ((static_cast<uint32_t>(1) << retval) != val) ++retval;
     return retval;
 }
-std::pair<uint32_t,uint32_t> maker(const std::string& expr)
+// Prints the intervals from first up to last. Returns the number of lines.
+unsigned long print_intervals (Writer& out, bool dashes,
+                               ListBase::const_iterator first,
+                               ListBase::const_iterator last)
 {
-    std::string left, right;
-    uint32_t lower, upper;
-    std::string::size_type index;
-
-    // Is the expression a lower and upper bound?
-    index = expr.find('-');
-    if (index != std::string::npos)
-    {
-         left = expr.substr(0, index);
-	 lower = quad_to_int(left);
-	 right = expr.substr(index+1, std::string::npos);
-	 upper = quad_to_int(right);
-    }
-    // Is the expression a starting point and a bitmask?
-    else
-    {
-        index = expr.find('/');
-	if (index != std::string::npos)
-	{
-	     left = expr.substr(0, index);
-	     lower = quad_to_int(left);
-	     right = expr.substr(index+1, std::string::npos);
-	     uint32_t count = string_to_int(right);
-	     if (count > 32) throw(ip_range_error());
-	     uint32_t mask = (1 << (32 - count)) - 1;
-	     upper = lower | mask;
-	     lower = lower & ~mask;
-	}
-	// Assume the expression is a single IP address
-	else
-	{
-	    upper = lower = quad_to_int(expr);
-	}
-    }
-    return std::make_pair(lower, upper);
+    unsigned long lines = 0;
+    for (auto iter = first ; iter != last ; ++iter)
+	lines += print_interval(out, dashes, iter->first, iter->second);
+    return lines;
 }
 
+// Intervals per slice of parallel output
+const std::size_t slice_intervals = 1 << 16;
 } // namespace anonymous
 
 
@@ -130,42 +177,17 @@ const char* ip_domain_error::what() const noexcept
 // Implementation of Range class
 /////////////////////////////////
 
-Range::Range() noexcept
- : NumRange<uint32_t>()
-{
-}
-Range::~Range()
-{
-}
-Range::Range(Range const& other) noexcept
- : NumRange<uint32_t>(other)
-{
-}
 Range& Range::operator=(Range const& other) noexcept
 {
     NumRange<uint32_t>::operator=(other);
     return *this;
 }
-Range::Range(Range&& other) noexcept
- : NumRange<uint32_t>(std::move(other))
-{
-}
 Range& Range::operator=(Range&& other) noexcept
 {
     NumRange<uint32_t>::operator=(std::move(other));
     return *this;
 }
 
-Range::Range(uint32_t lower, uint32_t upper)
- : NumRange<uint32_t>(lower, upper)
-{
-}
-
-Range::Range(const std::string& expr)
- : NumRange<uint32_t>(maker(expr))
-{
-}
-
 Range::Range(Range& ra, std::string& middle)
  : NumRange<uint32_t>(ra.get().first, quad_to_int(middle))
 {
@@ -177,119 +199,186 @@ Range::Range(Range& ra, std::string& middle)
 ////////////////////////////////
 
 List::List() noexcept
- : NumList<uint32_t>(), mNumOutput(0)
+ : ListBase(), mNumOutput(0)
 {
 }
 List::~List()
 {
 }
 List::List(List const& other) noexcept
- : NumList<uint32_t>(other)
+ : ListBase(other)
 {
 }
 List& List::operator=(List const& other) noexcept
 {
-    NumList<uint32_t>::operator=(other);
+    ListBase::operator=(other);
     return *this;
 }
 List::List(List&& other) noexcept
- : NumList<uint32_t>(std::move(other))
+ : ListBase(std::move(other))
 {
 }
 List& List::operator=(List&& other) noexcept
 {
-    NumList<uint32_t>::operator=(std::move(other));
+    ListBase::operator=(std::move(other));
     return *this;
 }
 
 void List::add(const Range& range) noexcept
 {
-    NumList<uint32_t>::add(range);
+    ListBase::add(range);
 }
-void List::add_from (const NumList<uint32_t>::const_iterator& iter) noexcept
+void List::add_from (const ListBase::const_iterator& iter) noexcept
 {
-    NumList<uint32_t>::add_from(iter);
+    ListBase::add_from(iter);
 }
-void List::add_from (const NumList<uint32_t>::const_reverse_iterator& iter)
+void List::add_from (const ListBase::const_reverse_iterator& iter)
 noexcept
 {
-    NumList<uint32_t>::add_from(iter);
+    ListBase::add_from(iter);
+}
+
+void List::add_batch (std::vector<std::pair<uint32_t,uint32_t>>& batch)
+{
+    ListBase::add_batch(batch);
+}
+
+void List::add_sorted (const std::pair<uint32_t,uint32_t>* first,
+                       const std::pair<uint32_t,uint32_t>* last)
+{
+    ListBase::add_sorted(first, last);
+}
+
+void List::add_list (const List& other) noexcept
+{
+    ListBase::add_list(other);
+}
+
+void List::set_union (const List& other)
+{
+    ListBase::set_union(other);
+}
+
+void List::set_intersection (const List& other)
+{
+    ListBase::set_intersection(other);
+}
+
+void List::set_difference (const List& other)
+{
+    ListBase::set_difference(other);
+}
+
+void List::set_symmetric_difference (const List& other)
+{
+    ListBase::set_symmetric_difference(other);
+}
+
+void List::set_intersection (const std::pair<uint32_t,uint32_t>* first,
+                             const std::pair<uint32_t,uint32_t>* last)
+{
+    ListBase::set_intersection(first, last);
+}
+
+void List::set_difference (const std::pair<uint32_t,uint32_t>* first,
+                           const std::pair<uint32_t,uint32_t>* last)
+{
+    ListBase::set_difference(first, last);
+}
+
+void List::swap (List& other) noexcept
+{
+    ListBase::swap(other);
+    std::swap(mNumOutput, other.mNumOutput);
 }
 
 void List::subtract(const Range& range)
 {
-    NumList<uint32_t>::subtract(range);
+    ListBase::subtract(range);
 }
-void List::subtract_from (const NumList<uint32_t>::const_iterator& iter)
+void List::subtract_from (const ListBase::const_iterator& iter)
 noexcept
 {
-    NumList<uint32_t>::subtract_from(iter);
+    ListBase::subtract_from(iter);
 }
-void List::subtract_from (const NumList<uint32_t>::const_reverse_iterator& iter)
+void List::subtract_from (const ListBase::const_reverse_iterator& iter)
 noexcept
 {
-    NumList<uint32_t>::subtract_from(iter);
+    ListBase::subtract_from(iter);
 }
 
 void List::print(std::ostream& ost, bool dashes) const
 {
-    if (dashes)
+    Writer out(ost);
+    print(out, dashes);
+}
+
+void List::print(Writer& out, bool dashes) const
+{
+    mNumOutput += print_intervals(out, dashes, cbegin(), cend());
+}
+
+void List::print(Writer& out, bool dashes, unsigned int jobs) const
+{
+    if ((jobs <= 1) || (size() <= slice_intervals))
     {
-	for (const_iterator iter = cbegin() ; iter != cend() ; ++iter)
-	{
-	    uint32_t lower = iter->first;
-	    ost << int_to_quad(lower);
-	    if (iter->second != lower)
-		ost << '-' << int_to_quad(iter->second);
-	    ost << std::endl;
-	    ++mNumOutput;
-	}
+	print(out, dashes);
+	return;
     }
-    else
+
+    // Work in rounds of a few slices per thread, so that no more than a few
+    // buffers of text exist at any time.
+    std::size_t slices_per_round = static_cast<std::size_t>(jobs) * 2;
+    std::vector<std::unique_ptr<Writer>> buffers;
+    for (std::size_t slice = 0 ; slice < slices_per_round ; ++slice)
+	buffers.emplace_back(new Writer(slice_intervals * 32));
+    std::vector<const_iterator> cuts;
+    std::vector<unsigned long> lines(slices_per_round);
+
+    const_iterator iter = cbegin();
+    while (iter != cend())
     {
-	for (auto iter = cbegin() ; iter != cend() ; ++iter)
+	// Where each slice of this round begins and ends
+	cuts.clear();
+	cuts.push_back(iter);
+	while ((cuts.size() <= slices_per_round) && (iter != cend()))
 	{
-	    uint32_t lower = iter->first;
-	    while (lower <= iter->second)
-	    {
-		int zbits = count_trailing_zeroes(lower);
-		int maxbits = log2(iter->second - lower + 1);
-		if (zbits > maxbits) zbits = maxbits;
-		if (zbits == 0)
-		{
-		    ost << int_to_quad(lower) << std::endl;
-		    ++mNumOutput;
-		    // Avoid numeric overflow
-		    static const uint32_t bmax =
-			std::numeric_limits<uint32_t>::max();
-		    if (lower == bmax) break;
-		    ++lower;
-		}
-		else
-		{
-		    uint32_t mask = (1 << zbits) - 1;
-		    uint32_t middle = lower | mask;
-		    ost << int_to_quad(lower) << '/' << (32 - zbits)
-			<< std::endl;
-		    ++mNumOutput;
-		    // Avoid numeric overflow
-		    static const uint32_t bmax =
-			std::numeric_limits<uint32_t>::max();
-		    if (middle == bmax) break;
-		    lower = middle + 1;
-		}
-	    }
+	    for (std::size_t count = 0 ;
+	         (count < slice_intervals) && (iter != cend()) ; ++count)
+		++iter;
+	    cuts.push_back(iter);
+	}
+	std::size_t slices = cuts.size() - 1;
+
+	parallel_for(jobs, slices, [&](std::size_t slice)
+	{
+	    buffers[slice]->clear();
+	    lines[slice] = print_intervals(*buffers[slice], dashes,
+	                                   cuts[slice], cuts[slice + 1]);
+	});
+
+	// In order
+	for (std::size_t slice = 0 ; slice < slices ; ++slice)
+	{
+	    out.put(buffers[slice]->text(), buffers[slice]->size());
+	    mNumOutput += lines[slice];
 	}
     }
 }
 
+void List::expand(Writer& out, ExpandStyle style) const
+{
+    for (auto iter = cbegin() ; iter != cend() ; ++iter)
+	mNumOutput += out.expand(iter->first, iter->second, style);
+}
+
 uint32_t List::min() const
 {
-    return NumList<uint32_t>::min();
+    return ListBase::min();
 }
 uint32_t List::max() const
 {
-    return NumList<uint32_t>::max();
+    return ListBase::max();
 }
 
 std::ostream& operator<< (std::ostream& ost, const List& list)
@@ -300,7 +389,7 @@ std::ostream& operator<< (std::ostream& ost, const List& list)
 
 unsigned long List::num_operations() const
 {
-    return NumList<uint32_t>::num_operations();
+    return ListBase::num_operations();
 }
 
 unsigned long List::num_output() const
@@ -310,7 +399,7 @@ unsigned long List::num_output() const
 
 void List::verify() const
 {
-    NumList<uint32_t>::verify();
+    ListBase::verify();
 }
 
 
@@ -320,37 +409,96 @@ void List::verify() const
 
 std::string int_to_quad(uint32_t val)
 {
-    return
-	int8_to_string((val >> 24) & 0xFF) +
-	'.'                                +
-	int8_to_string((val >> 16) & 0xFF) +
-	'.'                                +
-	int8_to_string((val >>  8) & 0xFF) +
-	'.'                                +
-	int8_to_string (val        & 0xFF) ;
+    char buf[16];
+    return std::string(buf, format_quad(buf, val));
 }
 
-uint32_t quad_to_int(const std::string& expr)
+uint32_t runtime_quad_to_int(std::string_view expr)
 {
-    int part;
-    uint32_t retval = 0;
-    std::string sub(expr);
-    for (part = 0 ; part < 3 ; ++part)
+    return parse_quad(expr.data(), expr.data() + expr.size());
+}
+
+std::pair<uint32_t,uint32_t> runtime_parse_range(std::string_view expr)
+{
+    const char* begin = expr.data();
+    const char* end = begin + expr.size();
+    std::size_t len = expr.size();
+    uint32_t lower, upper;
+
+    // Is the expression a lower and upper bound?
+    const char* sep = static_cast<const char*>(std::memchr(begin, '-', len));
+    if (sep != nullptr)
     {
-	std::string::size_type index = sub.find('.');
-	if (index == std::string::npos) throw (ip_domain_error());
-	std::string octet = sub.substr(0, index);
-	uint32_t byte = string_to_int(octet);
-	if (byte > 255) throw (ip_domain_error());
-	retval = (retval << 8) | byte;
-	sub = sub.substr(index+1, std::string::npos);
+	lower = parse_quad(begin, sep);
+	upper = parse_quad(sep + 1, end);
+	return std::make_pair(lower, upper);
     }
-    std::string octet = sub.substr(0, std::string::npos);
-    uint32_t byte = string_to_int(octet);
-    if (byte > 255) throw (ip_domain_error());
-    retval = (retval << 8) | byte;
 
-    return retval;
+    // Is the expression a starting point and a bitmask?
+    sep = static_cast<const char*>(std::memchr(begin, '/', len));
+    if (sep != nullptr)
+    {
+	lower = parse_quad(begin, sep);
+	uint32_t count = decimal_to_int(
+	    std::string_view(sep + 1, static_cast<std::size_t>(end - sep - 1)));
+	if (count > 32) throw(ip_range_error());
+	uint32_t mask = (count == 0) ?
+	    std::numeric_limits<uint32_t>::max() :
+	    (static_cast<uint32_t>(1) << (32 - count)) - 1;
+	upper = lower | mask;
+	lower = lower & ~mask;
+	return std::make_pair(lower, upper);
+    }
+
+    // Assume the expression is a single IP address
+    upper = lower = parse_quad(begin, end);
+    return std::make_pair(lower, upper);
+}
+
+unsigned long print_interval (Writer& out, bool dashes, uint32_t lower,
+                              uint32_t upper)
+{
+    if (dashes)
+    {
+	out.quad(lower);
+	if (upper != lower)
+	{
+	    out.put('-');
+	    out.quad(upper);
+	}
+	out.put('\n');
+	return 1;
+    }
+
+    // A reversed range covers nothing, as it did for the old print loop
+    if (upper < lower) return 0;
+
+    unsigned long lines = 0;
+    while (true)
+    {
+	// Largest aligned block that starts at lower and fits. Note that the
+	// whole address space has a size of zero.
+	int zbits = (lower == 0) ? 32 : __builtin_ctz(lower);
+	uint32_t size = upper - lower + 1;
+	int maxbits = (size == 0) ? 32 : log2(size);
+	if (zbits > maxbits) zbits = maxbits;
+
+	out.quad(lower);
+	if (zbits != 0)
+	{
+	    out.put('/');
+	    out.decimal(static_cast<uint32_t>(32 - zbits));
+	}
+	out.put('\n');
+	++lines;
+
+	// Avoid numeric overflow
+	uint32_t middle = (zbits == 32) ? std::numeric_limits<uint32_t>::max() :
+	    lower | ((static_cast<uint32_t>(1) << zbits) - 1);
+	if (middle == upper) break;
+	lower = middle + 1;
+    }
+    return lines;
 }
 
 std::pair<uint32_t /*start*/, int /*bits*/> to_cidr (
@@ -403,3 +551,26 @@ std::pair<uint32_t /*start*/, int /*bits*/> to_cidr (
 } // namespace IPAR
 
 #include "ipar_numlist.tcc"
+
+namespace IPAR {
+
+// Every storage policy is compiled here, whichever one List uses, so that
+// other programs (ipar_bench) can compare them.
+template class NumList<uint32_t, std::numeric_limits<uint32_t>::max(),
+                       MapStorage<uint32_t>>;
+template class NumList<uint32_t, std::numeric_limits<uint32_t>::max(),
+                       PoolStorage<uint32_t>>;
+template class NumList<uint32_t, std::numeric_limits<uint32_t>::max(),
+                       FlatStorage<uint32_t>>;
+template class FlatStorage<uint32_t>;
+template class FrozenList<uint32_t>;
+
+// IPv6, see ipar_list6.h
+template class NumRange<uint128_t, uint128_max>;
+template class NumList<uint128_t, uint128_max, ListStorage6>;
+#ifdef IPAR_FLAT_STORAGE
+template class FlatStorage<uint128_t>;
+#endif
+template class FrozenList<uint128_t>;
+
+} // namespace IPAR
@@ -4,8 +4,13 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
 // #include <cstdint>
 #include "ipar_numlist.h"
+#include "ipar_writer.h"
 
 namespace IPAR {
 
@@ -24,10 +29,17 @@ public:
 // Convenience functions.
 
 // Reads a IP address in format nn.nn.nn.nn and outputs an equivalent 32-bit
-// number
-uint32_t quad_to_int(const std::string& expr);
+// number. Can be evaluated at compile time, where a bad address is a
+// compile error.
+constexpr uint32_t quad_to_int(std::string_view expr);
 std::string int_to_quad(uint32_t val);
 
+// Reads a range of IP addresses in any of the three forms nn.nn.nn.nn,
+// nn.nn.nn.nn-nn.nn.nn.nn and nn.nn.nn.nn/mm. Returns lower and upper bounds.
+// Nothing is allocated. Throws ip_domain_error or ip_range_error. Can be
+// evaluated at compile time, like quad_to_int.
+constexpr std::pair<uint32_t,uint32_t> parse_range(std::string_view expr);
+
 // Inputs a range of integers and returns the smallest CIDR range that
 // contains it. The return value indicates the start of the CIDR range
 // and the number of fixed bits in the range. This format is what
@@ -35,6 +47,12 @@ std::string int_to_quad(uint32_t val);
 std::pair<uint32_t /*start*/, int /*bits*/> to_cidr (
     uint32_t lower_bound, uint32_t upper_bound);
 
+// Writes out one interval as List::print does: one or more lines of CIDR
+// blocks nn.nn.nn.nn/mm, or with dashes, one line nn.nn.nn.nn-nn.nn.nn.nn.
+// Returns the number of lines.
+unsigned long print_interval (Writer& out, bool dashes, uint32_t lower,
+                              uint32_t upper);
+
 // Available from ipar_numlist.h:
 // Compute the intersection of two intervals. If the return value is false, the
 // intersection is the empty set. In this case, the result argumentss are
@@ -45,19 +63,108 @@ std::pair<uint32_t /*start*/, int /*bits*/> to_cidr (
 //                 BOUND b_lower, BOUND b_upper,
 //                 BOUND& result_lower, BOUND& result_upper)
 
+// How the parsers work. At run time, quad_to_int and parse_range call the
+// versions in ipar_iplist.cpp, which take the common cases with SSE. At
+// compile time, and for whatever SSE does not take, the portable versions
+// here do the work. Both always give the same results.
+
+uint32_t runtime_quad_to_int(std::string_view expr);
+std::pair<uint32_t,uint32_t> runtime_parse_range(std::string_view expr);
+
+// Parses a string of decimal digits. As it always has, an empty string is
+// zero and overflow wraps around.
+constexpr uint32_t decimal_to_int(std::string_view expr)
+{
+    uint32_t retval = 0;
+    for (char digit : expr)
+    {
+	uint32_t idigit = static_cast<unsigned char>(digit) - '0';
+	if (idigit > 9) throw (ip_domain_error());
+	retval = (retval * 10 ) + idigit;
+    }
+    return retval;
+}
+
+// Portable version of the dotted quad parser
+constexpr uint32_t scalar_quad_to_int(std::string_view expr)
+{
+    uint32_t retval = 0;
+    for (int part = 0 ; part < 3 ; ++part)
+    {
+	std::size_t dot = expr.find('.');
+	if (dot == std::string_view::npos) throw (ip_domain_error());
+	uint32_t byte = decimal_to_int(expr.substr(0, dot));
+	if (byte > 255) throw (ip_domain_error());
+	retval = (retval << 8) | byte;
+	expr.remove_prefix(dot + 1);
+    }
+    uint32_t byte = decimal_to_int(expr);
+    if (byte > 255) throw (ip_domain_error());
+    retval = (retval << 8) | byte;
+
+    return retval;
+}
+
+// Portable version of parse_range
+constexpr std::pair<uint32_t,uint32_t> scalar_parse_range(
+    std::string_view expr)
+{
+    // Is the expression a lower and upper bound?
+    std::size_t sep = expr.find('-');
+    if (sep != std::string_view::npos)
+    {
+	return std::make_pair(scalar_quad_to_int(expr.substr(0, sep)),
+	                      scalar_quad_to_int(expr.substr(sep + 1)));
+    }
+
+    // Is the expression a starting point and a bitmask?
+    sep = expr.find('/');
+    if (sep != std::string_view::npos)
+    {
+	uint32_t lower = scalar_quad_to_int(expr.substr(0, sep));
+	uint32_t count = decimal_to_int(expr.substr(sep + 1));
+	if (count > 32) throw(ip_range_error());
+	uint32_t mask = (count == 0) ?
+	    std::numeric_limits<uint32_t>::max() :
+	    (static_cast<uint32_t>(1) << (32 - count)) - 1;
+	return std::make_pair(lower & ~mask, lower | mask);
+    }
+
+    // Assume the expression is a single IP address
+    uint32_t lower = scalar_quad_to_int(expr);
+    return std::make_pair(lower, lower);
+}
+
+constexpr uint32_t quad_to_int(std::string_view expr)
+{
+    if (std::is_constant_evaluated()) return scalar_quad_to_int(expr);
+    return runtime_quad_to_int(expr);
+}
+
+constexpr std::pair<uint32_t,uint32_t> parse_range(std::string_view expr)
+{
+    if (std::is_constant_evaluated()) return scalar_parse_range(expr);
+    return runtime_parse_range(expr);
+}
+
 // An interval of IP addresses. Mostly used to translate to and from strings.
+// Can be made at compile time.
 class Range : public NumRange<uint32_t>
 {
 public:
 
-    Range() noexcept;
-    ~Range();
-    Range(Range const& other) noexcept;
+    constexpr Range() noexcept : NumRange<uint32_t>() { }
+    ~Range() = default;
+    constexpr Range(Range const& other) noexcept
+     : NumRange<uint32_t>(other) { }
     Range& operator=(Range const& other) noexcept;
-    Range(Range&& other) noexcept;
+    constexpr Range(Range&& other) noexcept
+     : NumRange<uint32_t>(std::move(other)) { }
     Range& operator=(Range&& other) noexcept;
-    Range(uint32_t lower, uint32_t upper);
-    Range(const std::string& expr);
+    constexpr Range(uint32_t lower, uint32_t upper)
+     : NumRange<uint32_t>(lower, upper) { }
+    constexpr Range(std::string_view expr)
+     : NumRange<uint32_t>(parse_range(expr)) { }
 
     // Splitter-constructor. 
     // Note that the first argument is NOT const.
@@ -67,11 +174,22 @@ public:
 
 }; // class Range
 
+// How List keeps its intervals: a std::map with its nodes in an arena. Build
+// with IPAR_FLAT_STORAGE defined (make FLAT_STORAGE=1) for sorted blocks in
+// place of a std::map.
+#ifdef IPAR_FLAT_STORAGE
+using ListStorage = FlatStorage<uint32_t>;
+#else
+using ListStorage = PoolStorage<uint32_t>;
+#endif
+using ListBase =
+    NumList<uint32_t, std::numeric_limits<uint32_t>::max(), ListStorage>;
+
 // List of IP addresses. Maintained as a sorted list of non-overlapping,
 // non-adjacent intervals in CIDR form. That is, each interval can be
 // expressed as nn.nn.nn.nn/mm and the least significant (32-mm) bits of
 // nn.nn.nn.nn are zero.
-class List : public NumList<uint32_t>
+class List : public ListBase
 {
 public:
 
@@ -84,19 +202,54 @@ public:
 
     // Add an interval of IP addresses.
     void add (const Range&) noexcept;
-    void add_from (const NumList<uint32_t>::const_iterator& iter) noexcept;
-    void add_from (const NumList<uint32_t>::const_reverse_iterator& iter)
+    void add_from (const ListBase::const_iterator& iter) noexcept;
+    void add_from (const ListBase::const_reverse_iterator& iter)
         noexcept;
 
+    // Add many intervals at once. See NumList::add_batch.
+    void add_batch (std::vector<std::pair<uint32_t,uint32_t>>& batch);
+
+    // Add intervals that are sorted, and never overlapping or adjacent.
+    void add_sorted (const std::pair<uint32_t,uint32_t>* first,
+                     const std::pair<uint32_t,uint32_t>* last);
+
+    // Add every interval of another list.
+    void add_list (const List& other) noexcept;
+
+    // Set algebra with another list. See NumList::set_union etc.
+    void set_union (const List& other);
+    void set_intersection (const List& other);
+    void set_difference (const List& other);
+    void set_symmetric_difference (const List& other);
+
+    // The same, with sorted intervals used in place, such as the entries of
+    // a Snapshot.
+    void set_intersection (const std::pair<uint32_t,uint32_t>* first,
+                           const std::pair<uint32_t,uint32_t>* last);
+    void set_difference (const std::pair<uint32_t,uint32_t>* first,
+                         const std::pair<uint32_t,uint32_t>* last);
+
+    // Exchange content with another list.
+    void swap (List& other) noexcept;
+
     // Remove an interval of IP addresses.
     void subtract (const Range&);
-    void subtract_from (const NumList<uint32_t>::const_iterator& iter) noexcept;
-    void subtract_from (const NumList<uint32_t>::const_reverse_iterator& iter)
+    void subtract_from (const ListBase::const_iterator& iter) noexcept;
+    void subtract_from (const ListBase::const_reverse_iterator& iter)
         noexcept;
 
     // Print out everything in the list. A series of strings nn.nn.nn.nn/nn in
     // sorted order. If dashes is true, output is nn.nn.nn.nn-nn.nn.nn.nn.
+    // Printing to a Writer is much faster for large lists.
     void print(std::ostream& ost, bool dashes=false) const;
+    void print(Writer& out, bool dashes=false) const;
+
+    // The same, with text formatted on up to "jobs" threads. Slices of the
+    // list are formatted into separate buffers, then written out in order.
+    void print(Writer& out, bool dashes, unsigned int jobs) const;
+
+    // Print out every single address in the list. See Writer::expand.
+    void expand(Writer& out, ExpandStyle style) const;
 
     // Statistics
     uint32_t min() const;
@@ -0,0 +1,334 @@
+#include <cstring>
+#include <limits>
+#include "ipar_list6.h"
+
+namespace IPAR
+{
+
+namespace { // anonymous
+
+constexpr char hex_digits[] = "0123456789abcdef";
+
+// Value of a hex digit, or 16 for anything else
+struct HexValues
+{
+    unsigned char mValues[256];
+
+    constexpr HexValues() : mValues{}
+    {
+	for (int index = 0 ; index < 256 ; ++index) mValues[index] = 16;
+	for (int digit = 0 ; digit < 10 ; ++digit) mValues['0' + digit] =
+	    static_cast<unsigned char>(digit);
+	for (int digit = 0 ; digit < 6 ; ++digit)
+	{
+	    mValues['a' + digit] = static_cast<unsigned char>(10 + digit);
+	    mValues['A' + digit] = static_cast<unsigned char>(10 + digit);
+	}
+    }
+};
+constexpr HexValues hex_values;
+
+inline unsigned int hex_value (char c)
+{
+    return hex_values.mValues[static_cast<unsigned char>(c)];
+}
+
+// Number of trailing zero bits. Undefined for zero.
+inline int ctz128 (uint128_t val)
+{
+    uint64_t low = static_cast<uint64_t>(val);
+    if (low != 0) return __builtin_ctzll(low);
+    return 64 + __builtin_ctzll(static_cast<uint64_t>(val >> 64));
+}
+
+// Position of the highest bit that is set. Undefined for zero.
+inline int log2_128 (uint128_t val)
+{
+    uint64_t high = static_cast<uint64_t>(val >> 64);
+    if (high != 0) return 127 - __builtin_clzll(high);
+    return 63 - __builtin_clzll(static_cast<uint64_t>(val));
+}
+
+// Writes lower case hex without leading zeros. Returns the end of the text.
+inline char* format_group (char* pos, unsigned int group)
+{
+    int shift = 12;
+    while ((shift > 0) && ((group >> shift) == 0)) shift -= 4;
+    for ( ; shift >= 0 ; shift -= 4)
+	*pos++ = hex_digits[(group >> shift) & 0xF];
+    return pos;
+}
+
+// Prints the intervals from first up to last. Returns the number of lines.
+unsigned long print_intervals6 (Writer& out, bool dashes,
+                                List6Base::const_iterator first,
+                                List6Base::const_iterator last)
+{
+    unsigned long lines = 0;
+    for (auto iter = first ; iter != last ; ++iter)
+    {
+	uint128_t lower = iter->first;
+	if (dashes)
+	{
+	    char* pos = out.reserve(82);
+	    char* end = format_ipv6(pos, lower);
+	    if (iter->second != lower)
+	    {
+		*end++ = '-';
+		end = format_ipv6(end, iter->second);
+	    }
+	    *end++ = '\n';
+	    out.advance(static_cast<std::size_t>(end - pos));
+	    ++lines;
+	    continue;
+	}
+	while (true)
+	{
+	    // Largest aligned block that starts at lower and fits. Note that
+	    // the whole address space has a size of zero.
+	    int zbits = (lower == 0) ? 128 : ctz128(lower);
+	    uint128_t size = iter->second - lower + 1;
+	    int maxbits = (size == 0) ? 128 : log2_128(size);
+	    if (zbits > maxbits) zbits = maxbits;
+
+	    char* pos = out.reserve(41);
+	    out.advance(
+	        static_cast<std::size_t>(format_ipv6(pos, lower) - pos));
+	    if (zbits != 0)
+	    {
+		out.put('/');
+		out.decimal(static_cast<uint32_t>(128 - zbits));
+	    }
+	    out.put('\n');
+	    ++lines;
+
+	    // Avoid numeric overflow
+	    uint128_t middle = (zbits == 128) ? uint128_max :
+		lower | ((static_cast<uint128_t>(1) << zbits) - 1);
+	    if (middle == iter->second) break;
+	    lower = middle + 1;
+	}
+    }
+    return lines;
+}
+
+} // namespace anonymous
+
+
+///////////////////////////////////////////
+// Implementation of stand-alone functions
+///////////////////////////////////////////
+
+uint128_t ipv6_to_int(std::string_view expr)
+{
+    const char* pos = expr.data();
+    const char* end = pos + expr.size();
+    unsigned int groups[8];
+    int count = 0;
+    int gap = -1;               // Where "::" is, in groups
+
+    if ((end - pos >= 2) && (pos[0] == ':') && (pos[1] == ':'))
+    {
+	gap = 0;
+	pos += 2;
+    }
+    while (pos != end)
+    {
+	const char* start = pos;
+	unsigned int group = 0;
+	while ((pos != end) && (hex_value(*pos) < 16))
+	    group = (group << 4) | hex_value(*pos++);
+
+	// A dotted quad for the last two groups
+	if ((pos != end) && (*pos == '.'))
+	{
+	    if (count > 6) throw (ip_domain_error());
+	    uint32_t quad = quad_to_int(std::string_view(
+	        start, static_cast<std::size_t>(end - start)));
+	    groups[count++] = quad >> 16;
+	    groups[count++] = quad & 0xFFFF;
+	    pos = end;
+	    break;
+	}
+
+	if ((pos == start) || (pos - start > 4) || (count == 8))
+	    throw (ip_domain_error());
+	groups[count++] = group;
+	if (pos == end) break;
+	if ((*pos++ != ':') || (pos == end)) throw (ip_domain_error());
+	if (*pos == ':')
+	{
+	    if (gap >= 0) throw (ip_domain_error());
+	    gap = count;
+	    ++pos;
+	}
+    }
+
+    // Without "::" there must be eight groups. With it, at most seven.
+    if ((gap < 0) ? (count != 8) : (count > 7)) throw (ip_domain_error());
+
+    uint128_t retval = 0;
+    for (int index = 0 ; index < count ; ++index)
+    {
+	if (index == gap) retval <<= 16 * (8 - count);
+	retval = (retval << 16) | groups[index];
+    }
+    if ((gap == count) && (count != 0)) retval <<= 16 * (8 - count);
+    return retval;
+}
+
+std::string int_to_ipv6(uint128_t val)
+{
+    char buf[40];
+    return std::string(buf, format_ipv6(buf, val));
+}
+
+char* format_ipv6 (char* pos, uint128_t val)
+{
+    unsigned int groups[8];
+    for (int index = 7 ; index >= 0 ; --index)
+    {
+	groups[index] = static_cast<unsigned int>(val & 0xFFFF);
+	val >>= 16;
+    }
+
+    // IPv4-mapped
+    if ((groups[0] | groups[1] | groups[2] | groups[3] | groups[4]) == 0 &&
+        (groups[5] == 0xFFFF))
+    {
+	std::memcpy(pos, "::ffff:", 7);
+	return format_quad(pos + 7, (groups[6] << 16) | groups[7]);
+    }
+
+    // The longest run of zero groups, if two or more
+    int gap = -1;
+    int gap_length = 1;
+    for (int index = 0 ; index < 8 ; )
+    {
+	if (groups[index] != 0)
+	{
+	    ++index;
+	    continue;
+	}
+	int run = index;
+	while ((run < 8) && (groups[run] == 0)) ++run;
+	if (run - index > gap_length)
+	{
+	    gap = index;
+	    gap_length = run - index;
+	}
+	index = run;
+    }
+
+    for (int index = 0 ; index < 8 ; ++index)
+    {
+	if (index == gap)
+	{
+	    *pos++ = ':';
+	    *pos++ = ':';
+	    index += gap_length - 1;
+	    continue;
+	}
+	if ((index != 0) && (index != gap + gap_length)) *pos++ = ':';
+	pos = format_group(pos, groups[index]);
+    }
+    return pos;
+}
+
+std::pair<uint128_t,uint128_t> parse_range6(std::string_view expr)
+{
+    // Is the expression a lower and upper bound?
+    std::size_t sep = expr.find('-');
+    if (sep != std::string_view::npos)
+    {
+	return std::make_pair(ipv6_to_int(expr.substr(0, sep)),
+	                      ipv6_to_int(expr.substr(sep + 1)));
+    }
+
+    // Is the expression a starting point and a bitmask?
+    sep = expr.find('/');
+    if (sep != std::string_view::npos)
+    {
+	uint128_t lower = ipv6_to_int(expr.substr(0, sep));
+	uint32_t count = decimal_to_int(expr.substr(sep + 1));
+	if (count > 128) throw(ip_range_error());
+	uint128_t mask = (count == 0) ? uint128_max :
+	    (static_cast<uint128_t>(1) << (128 - count)) - 1;
+	return std::make_pair(lower & ~mask, lower | mask);
+    }
+
+    // Assume the expression is a single IP address
+    uint128_t lower = ipv6_to_int(expr);
+    return std::make_pair(lower, lower);
+}
+
+uint128_t expand6 (Writer& out, uint128_t lower, uint128_t upper,
+                   ExpandStyle style)
+{
+    uint128_t total = upper - lower + 1;
+    while (true)
+    {
+	char* pos = out.reserve(41);
+	char* end = pos;
+	switch (style)
+	{
+	case Ehex:
+	    for (int shift = 124 ; shift >= 0 ; shift -= 4)
+		*end++ = hex_digits[static_cast<unsigned int>(lower >> shift)
+		                    & 0xF];
+	    *end++ = '\n';
+	    break;
+	case Equad:
+	    end = format_ipv6(pos, lower);
+	    *end++ = '\n';
+	    break;
+	default:
+	    std::memcpy(pos, &lower, sizeof(lower));
+	    end = pos + sizeof(lower);
+	    break;
+	}
+	out.advance(static_cast<std::size_t>(end - pos));
+
+	// Avoid numeric overflow
+	if (lower == upper) break;
+	++lower;
+    }
+    return total;
+}
+
+
+/////////////////////////////////
+// Implementation of List6 class
+/////////////////////////////////
+
+void List6::swap (List6& other) noexcept
+{
+    List6Base::swap(other);
+    std::swap(mNumOutput, other.mNumOutput);
+}
+
+void List6::print(std::ostream& ost, bool dashes) const
+{
+    Writer out(ost);
+    print(out, dashes);
+}
+
+void List6::print(Writer& out, bool dashes) const
+{
+    mNumOutput += print_intervals6(out, dashes, cbegin(), cend());
+}
+
+void List6::expand(Writer& out, ExpandStyle style) const
+{
+    for (auto iter = cbegin() ; iter != cend() ; ++iter)
+	mNumOutput += static_cast<unsigned long>(
+	    expand6(out, iter->first, iter->second, style));
+}
+
+std::ostream& operator<< (std::ostream& ost, const List6& list)
+{
+    list.print(ost);
+    return ost;
+}
+
+} // namespace IPAR
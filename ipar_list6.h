@@ -0,0 +1,131 @@
+////////////////////////////////////////////////////////
+// Lists of IPv6 addresses. The same NumList as for
+// IPv4, with 128-bit bounds.
+////////////////////////////////////////////////////////
+
+#ifndef IPAR_LIST6_H_ // {
+#define IPAR_LIST6_H_
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "ipar_iplist.h"
+#include "ipar_numlist.h"
+#include "ipar_writer.h"
+
+namespace IPAR {
+
+// An IPv6 address as a number. A GCC extension, hence the keyword.
+__extension__ typedef unsigned __int128 uint128_t;
+constexpr uint128_t uint128_max = ~uint128_t(0);
+
+// Convenience functions.
+
+// Whether a word is meant as IPv6 rather than IPv4. Every IPv6 address has
+// a colon, and no IPv4 address does.
+inline bool is_ipv6 (std::string_view word)
+{
+    return word.find(':') != std::string_view::npos;
+}
+
+// Reads an IPv6 address in any of the text forms of RFC 4291: eight groups
+// of up to four hex digits separated by colons, with one run of zero groups
+// shortened to "::" if wanted, and the last two groups as a dotted quad if
+// wanted. Throws ip_domain_error.
+uint128_t ipv6_to_int(std::string_view expr);
+
+// Writes an address in the canonical form of RFC 5952: lower case, no
+// leading zeros, and the longest run of two or more zero groups (the first
+// one, on a tie) shortened to "::". IPv4-mapped addresses end in a dotted
+// quad, as in ::ffff:10.1.2.3.
+std::string int_to_ipv6(uint128_t val);
+
+// The same, at pos. There must be room for 40 characters. Returns the end
+// of the text.
+char* format_ipv6 (char* pos, uint128_t val);
+
+// Reads a range of IPv6 addresses in any of the forms a, a-b and a/mm, with
+// mm up to 128. Returns lower and upper bounds. Nothing is allocated.
+// Throws ip_domain_error or ip_range_error.
+std::pair<uint128_t,uint128_t> parse_range6(std::string_view expr);
+
+// Writes out every single address from lower to upper: 32 hex digits, the
+// canonical text form, or 16 bytes in host byte order, one per address.
+// Returns the number of addresses, which wraps around to zero for the whole
+// address space.
+uint128_t expand6 (Writer& out, uint128_t lower, uint128_t upper,
+                   ExpandStyle style);
+
+// An interval of IPv6 addresses.
+class Range6 : public NumRange<uint128_t, uint128_max>
+{
+public:
+
+    // The automatic methods
+    Range6() noexcept : NumRange<uint128_t, uint128_max>() { }
+    ~Range6() = default;
+    Range6(Range6 const& other) = default;
+    Range6& operator=(Range6 const& other) = default;
+    Range6(Range6&& other) = default;
+    Range6& operator=(Range6&& other) = default;
+
+    Range6(uint128_t lower, uint128_t upper)
+     : NumRange<uint128_t, uint128_max>(lower, upper) { }
+    Range6(std::string_view expr)
+     : NumRange<uint128_t, uint128_max>(parse_range6(expr)) { }
+
+}; // class Range6
+
+// How List6 keeps its intervals, chosen the same way as for List
+#ifdef IPAR_FLAT_STORAGE
+using ListStorage6 = FlatStorage<uint128_t>;
+#else
+using ListStorage6 = PoolStorage<uint128_t>;
+#endif
+using List6Base = NumList<uint128_t, uint128_max, ListStorage6>;
+
+// List of IPv6 addresses, kept like List: sorted intervals that never
+// overlap or touch, printed in CIDR form. Everything else comes from
+// NumList, which takes a Range6 wherever it takes a range.
+class List6 : public List6Base
+{
+public:
+
+    // The automatic methods
+    List6() noexcept : List6Base(), mNumOutput(0) { }
+    ~List6() = default;
+    List6(List6 const& other) = default;
+    List6& operator=(List6 const& other) = default;
+    List6(List6&& other) = default;
+    List6& operator=(List6&& other) = default;
+
+    // Exchange content with another list.
+    void swap (List6& other) noexcept;
+
+    // Print out everything in the list, as List::print does: a series of
+    // blocks aaaa::/nn in sorted order, or with dashes, intervals
+    // aaaa::-bbbb::.
+    void print(std::ostream& ost, bool dashes=false) const;
+    void print(Writer& out, bool dashes=false) const;
+
+    // Print out every single address in the list. See expand6.
+    void expand(Writer& out, ExpandStyle style) const;
+
+    // For diagnostic use: how many lines of text have been written out
+    // since construction.
+    unsigned long num_output() const { return mNumOutput; }
+
+private:
+
+    mutable unsigned long mNumOutput;
+
+}; // class List6
+
+std::ostream& operator<< (std::ostream&, const List6&);
+
+} // namespace IPAR
+
+#endif // } IPAR_LIST6_H_
@@ -0,0 +1,248 @@
+// Program ipar_lookup
+// -------------------
+// Opens lists of IP addresses from specified files, and compiles their union
+// into a lookup table, see ipar_table.h.
+// Reads single IP addresses from standard input, one per line, as a stream.
+// Lists and addresses may mix IPv4 and IPv6. IPv6 addresses are looked up in
+// a FrozenList of the IPv6 content, see ipar_frozen.h.
+// Anything from # to end of line is ignored, as is anything after the first
+// word of a line.
+// Writes out every address that is in the lists, or with -v every address
+// that is not.
+// Any of the files may be a binary snapshot, see ipar_read -binary.
+// With -j N, each file is parsed on N threads, and the files are loaded
+// side by side.
+// With -cache, parsed files are cached, see ipar_cache.h.
+
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unistd.h>
+using namespace std;
+#include "ipar_iplist.h"
+#include "ipar_common.h"
+#include "ipar_list6.h"
+#include "ipar_cache.h"
+#include "ipar_table.h"
+
+namespace {
+
+// Bytes read from standard input at a time, and addresses looked up at a time
+const size_t read_size = 1 << 20;
+const size_t batch_size = 4096;
+
+// Addresses waiting to be looked up, and the text they came from. IPv6
+// addresses are looked up as they come, and take a place in the batch only
+// to keep the output in order.
+class Batch
+{
+public:
+
+    Batch(const IPAR::Table& table, const IPAR::FrozenList<IPAR::uint128_t>&
+          table6, IPAR::Writer& out, bool matches)
+     : mTable(table), mTable6(table6), mOut(out), mMatches(matches),
+       mFound(0)
+    {
+	mAddresses.reserve(batch_size);
+	mWords.reserve(batch_size);
+	mResults.reset(new bool[batch_size]);
+    }
+
+    void add (uint32_t address, string_view word)
+    {
+	mAddresses.push_back(address);
+	mWords.push_back(word);
+	if (mAddresses.size() == batch_size) flush();
+    }
+
+    void add6 (IPAR::uint128_t address, string_view word)
+    {
+	mResults6.push_back(
+	    make_pair(mAddresses.size(), mTable6.contains(address)));
+	add(0, word);
+    }
+
+    // Looks up everything in the batch, and writes out what is wanted. The
+    // text of the words must still be there.
+    void flush()
+    {
+	mTable.contains(mAddresses,
+	                span<bool>(mResults.get(), mAddresses.size()));
+	for (const auto& result6 : mResults6)
+	    mResults[result6.first] = result6.second;
+	for (size_t index = 0 ; index < mAddresses.size() ; ++index)
+	{
+	    if (mResults[index] != mMatches) continue;
+	    mOut.put(mWords[index].data(), mWords[index].size());
+	    mOut.put('\n');
+	    ++mFound;
+	}
+	mAddresses.clear();
+	mWords.clear();
+	mResults6.clear();
+    }
+
+    unsigned long found() const { return mFound; }
+
+private:
+
+    const IPAR::Table& mTable;
+    const IPAR::FrozenList<IPAR::uint128_t>& mTable6;
+    IPAR::Writer& mOut;
+    bool mMatches;
+    unsigned long mFound;
+    vector<uint32_t> mAddresses;
+    vector<string_view> mWords;
+    unique_ptr<bool[]> mResults;
+    vector<pair<size_t,bool>> mResults6;
+};
+
+// Same as isspace() in the "C" locale, as for IPAR::ViewReader
+inline bool is_space (char c)
+{
+    return (c == ' ') || ((c >= '\t') && (c <= '\r'));
+}
+
+// The first word of a line, not counting comments
+string_view first_word (const char* begin, const char* end)
+{
+    while ((begin != end) && is_space(*begin)) ++begin;
+    const char* stop = begin;
+    while ((stop != end) && !is_space(*stop) && (*stop != '#')) ++stop;
+    return string_view(begin, static_cast<size_t>(stop - begin));
+}
+
+} // anonymous namespace
+
+int main (int argc, char* argv[])
+{
+    // Process options
+    unsigned int jobs = 1;
+    bool bCache = false;
+    bool bMatches = true;
+    int iFirst = 1;
+    for ( ; iFirst < argc ; ++iFirst)
+    {
+	std::string arg(argv[iFirst]);
+	if (arg == "-cache")
+	{
+	    bCache = true;
+	}
+	else if (arg == "-v")
+	{
+	    bMatches = false;
+	}
+	else if (arg == "-j")
+	{
+	    if ((++iFirst == argc) || ((jobs = IPAR::o_jobs(argv[iFirst])) == 0))
+	    {
+		cerr << "Usage: ipar_lookup [-j N] [-cache] [-v] file ..." << endl;
+		return 1;
+	    }
+	}
+	else
+	{
+	    break;
+	}
+    }
+    if (iFirst == argc)
+    {
+	cerr << "Usage: ipar_lookup [-j N] [-cache] [-v] file ..." << endl;
+	return 1;
+    }
+    IPAR::FileCache cache(bCache);
+
+    // Everything in the files, compiled. A lone snapshot is compiled
+    // straight from its intervals, without a list in between.
+    IPAR::List mainlist;
+    IPAR::List6 mainlist6;
+    vector<string> filenames(argv + iFirst, argv + argc);
+    unique_ptr<IPAR::SnapshotFile> operand;
+    if (filenames.size() == 1)
+	operand = make_unique<IPAR::SnapshotFile> (filenames[0]);
+    bool bSnapshot = operand && *operand;
+    if (bSnapshot)
+    {
+	auto entries6 = operand->snapshot().entries6();
+	mainlist6.add_batch (entries6);
+    }
+    else if (cache.read_all (filenames, mainlist, mainlist6, jobs) != 0)
+    {
+	return 1;
+    }
+    IPAR::Table table = bSnapshot
+	? IPAR::Table(operand->snapshot().begin(), operand->snapshot().end())
+	: IPAR::Table(mainlist);
+    IPAR::FrozenList<IPAR::uint128_t> table6 = mainlist6.freeze();
+
+    // Loop over lines of input. Whole lines are taken from each read, and
+    // the remainder is kept for the next.
+    IPAR::Writer out(STDOUT_FILENO);
+    Batch batch(table, table6, out, bMatches);
+    vector<char> buffer(read_size);
+    size_t kept = 0;
+    unsigned long numLookups = 0;
+    unsigned int lineNo = 0;
+    for (;;)
+    {
+	if (kept == buffer.size()) buffer.resize(buffer.size() * 2);
+	ssize_t got = read(STDIN_FILENO, buffer.data() + kept,
+	                   buffer.size() - kept);
+	if ((got < 0) && (errno == EINTR)) continue;
+	if (got < 0)
+	{
+	    cerr << "ERROR: could not read input" << endl;
+	    return 1;
+	}
+
+	// At end of input, the last line need not have a newline
+	const char* pos = buffer.data();
+	const char* end = pos + kept + static_cast<size_t>(got);
+	const char* stop = end;
+	if (got > 0)
+	{
+	    stop = static_cast<const char*>(
+	        memrchr(pos, '\n', static_cast<size_t>(end - pos)));
+	    stop = (stop == nullptr) ? pos : stop + 1;
+	}
+
+	while (pos != stop)
+	{
+	    const char* eol = static_cast<const char*>(
+	        memchr(pos, '\n', static_cast<size_t>(stop - pos)));
+	    if (eol == nullptr) eol = stop;
+	    ++lineNo;
+	    string_view word = first_word(pos, eol);
+	    if (!word.empty())
+	    {
+		try {
+		    if (IPAR::is_ipv6(word))
+			batch.add6(IPAR::ipv6_to_int(word), word);
+		    else
+			batch.add(IPAR::quad_to_int(word), word);
+		}
+		catch (const exception& ex) {
+		    cerr << "ERROR: " << ex.what() << endl;
+		    cerr << "Line " << lineNo << ": \"" << word << "\"" << endl;
+		    return 1;
+		}
+		++numLookups;
+	    }
+	    pos = (eol == stop) ? stop : eol + 1;
+	}
+	batch.flush();
+	if (got == 0) break;
+
+	kept = static_cast<size_t>(end - stop);
+	memmove(buffer.data(), stop, kept);
+    }
+    out.flush();
+
+    cerr << numLookups << " addresses looked up, " << batch.found()
+         << " lines output" << endl;
+    return 0;
+}
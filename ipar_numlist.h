@@ -1,10 +1,18 @@
 #ifndef IPAR_NUMLIST_H_ // {
 #define IPAR_NUMLIST_H_
 
+#include <atomic>
+#include <cstdint>
 #include <exception>
 #include <functional>
 #include <limits>
-#include <map>
+#include <mutex>
+#include <random>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "ipar_flatstorage.h"
+#include "ipar_frozen.h"
 
 namespace IPAR {
 
@@ -14,7 +22,7 @@ class numeric_range_error : public std::exception
     virtual const char* what() const noexcept;
 };
 
-template<typename BOUND, BOUND BMAX> class NumList;
+template<typename BOUND, BOUND BMAX, typename STORAGE> class NumList;
 
 // A dense interval.
 template<typename BOUND, BOUND BMAX=std::numeric_limits<BOUND>::max()>
@@ -30,11 +38,16 @@ public:
     NumRange& operator=(NumRange&& other) noexcept;
 
     // The only way to access content
-    const std::pair<BOUND, BOUND>& get() const { return *this; }
+    constexpr const std::pair<BOUND, BOUND>& get() const { return *this; }
 
     // Construct from lower and upper bounds. Correct ordering is checked.
-    NumRange(BOUND lower, BOUND upper);
-    NumRange(const std::pair<BOUND,BOUND>& other);
+    constexpr NumRange(BOUND lower, BOUND upper)
+     : std::pair<BOUND, BOUND>(lower, upper)
+    {
+	if (lower > upper) throw numeric_range_error();
+    }
+    constexpr NumRange(const std::pair<BOUND,BOUND>& other)
+     : std::pair<BOUND, BOUND>(other) { }
 
     // Splitter-constructor. Note that the argument is NOT const.
     // Shortens the length of this interval and returns a new interval
@@ -42,18 +55,23 @@ public:
     // argument middle.
     NumRange(NumRange& nr, BOUND middle);
 
-    friend class NumList<BOUND,BMAX>;
+    template<typename B, B M, typename S> friend class NumList;
 
 }; // class NumRange
 
 // A collection of intervals, maintained in a standard form. What this means is
 // that the intervals are always sorted, and there are never two adjacent or
-// overlapping intervals.
-template<typename BOUND, BOUND BMAX=std::numeric_limits<BOUND>::max()>
-class NumList : private std::map<BOUND,BOUND>
+// overlapping intervals. STORAGE keeps the intervals; see ipar_flatstorage.h.
+template<typename BOUND, BOUND BMAX=std::numeric_limits<BOUND>::max(),
+         typename STORAGE=MapStorage<BOUND>>
+class NumList : private STORAGE
 {
 public:
 
+    // A number of values. Wide enough for the whole range of BOUND, except
+    // when BOUND is 64 bits or more, where the whole range wraps to zero.
+    using count_type = ValueCount<BOUND>;
+
     NumList() noexcept;
     ~NumList() = default;
     NumList(NumList const& other) noexcept;
@@ -63,35 +81,35 @@ public:
 
     // The only way to access content
     class const_iterator
-      : public std::map<BOUND,BOUND>::const_iterator
+      : public STORAGE::const_iterator
     {
         public:
         const_iterator(
-            const typename std::map<BOUND,BOUND>::const_iterator& m)
-         : std::map<BOUND,BOUND>::const_iterator(m)
+            const typename STORAGE::const_iterator& m)
+         : STORAGE::const_iterator(m)
         { }
     };
     class const_reverse_iterator
-      : public std::map<BOUND,BOUND>::const_reverse_iterator
+      : public STORAGE::const_reverse_iterator
     {
         public:
         const_reverse_iterator(
-            const typename std::map<BOUND,BOUND>::const_reverse_iterator& m)
-         : std::map<BOUND,BOUND>::const_reverse_iterator(m)
+            const typename STORAGE::const_reverse_iterator& m)
+         : STORAGE::const_reverse_iterator(m)
         { }
     };
     const_iterator cbegin() const {
-        return const_iterator(std::map<BOUND,BOUND>::cbegin()); }
+        return const_iterator(STORAGE::cbegin()); }
     const_reverse_iterator crbegin() const {
-        return const_reverse_iterator(std::map<BOUND,BOUND>::crbegin()); }
+        return const_reverse_iterator(STORAGE::crbegin()); }
     const_iterator cend() const {
-        return const_iterator(std::map<BOUND,BOUND>::cend()); }
+        return const_iterator(STORAGE::cend()); }
     const_reverse_iterator crend() const {
-        return const_reverse_iterator(std::map<BOUND,BOUND>::crend()); }
+        return const_reverse_iterator(STORAGE::crend()); }
     const_iterator lower_bound(BOUND left) const {
-        return const_iterator(std::map<BOUND,BOUND>::lower_bound(left)); }
+        return const_iterator(STORAGE::lower_bound(left)); }
     const_iterator upper_bound(BOUND left) const {
-        return const_iterator(std::map<BOUND,BOUND>::upper_bound(left)); }
+        return const_iterator(STORAGE::upper_bound(left)); }
 
     // Add an interval to the collection.
     void add (const NumRange<BOUND,BMAX>& range) noexcept {
@@ -104,19 +122,96 @@ public:
 
     // Special-purpose versions, to avoid cost of constructing a Range
     // when transferring from one List to another.
-    void add_from (const NumList<BOUND,BMAX>::const_iterator& iter) 
+    void add_from (const NumList::const_iterator& iter) 
         noexcept { add_nover(iter->first, iter->second); }
-    void add_from (const NumList<BOUND,BMAX>::const_reverse_iterator& iter)
+    void add_from (const NumList::const_reverse_iterator& iter)
         noexcept { add_nover(iter->first, iter->second); }
-    void subtract_from (const NumList<BOUND,BMAX>::const_iterator& iter) 
+    void subtract_from (const NumList::const_iterator& iter) 
         noexcept { subtract_nover(iter->first, iter->second); }
-    void subtract_from (const NumList<BOUND,BMAX>::const_reverse_iterator& iter)
+    void subtract_from (const NumList::const_reverse_iterator& iter)
         noexcept { subtract_nover(iter->first, iter->second); }
 
+    // Add many intervals at once. The batch is sorted (radix sort, for
+    // unsigned integer bounds) and coalesced in one linear pass, then merged
+    // into the collection. A batch that is already sorted is not sorted
+    // again, and intervals beyond the end of the collection are appended
+    // without searching. The batch is emptied.
+    void add_batch (std::vector<std::pair<BOUND,BOUND>>& batch);
+
+    // Add intervals that are already sorted and never overlapping or
+    // adjacent, such as the content of another collection. Whatever lies
+    // beyond the end of this collection is appended without searching.
+    template<typename ITER>
+    void add_sorted (ITER first, ITER last);
+
+    // Add every interval of another collection. The operation counts of the
+    // two collections are combined.
+    void add_list (const NumList& other) noexcept;
+
+    // Set algebra. This collection becomes its union, intersection,
+    // difference or symmetric difference with the other one. Collections of
+    // similar size are merged in one linear pass, and the result replaces
+    // the content. When one is much smaller, each of its intervals is looked
+    // up in the larger one instead, which costs O(m log n); for union,
+    // difference and symmetric difference with a small other collection,
+    // this collection is changed in place.
+    void set_union (const NumList& other);
+    void set_intersection (const NumList& other);
+    void set_difference (const NumList& other);
+    void set_symmetric_difference (const NumList& other);
+
+    // Intersection and difference with intervals that are sorted, never
+    // overlapping or adjacent, and in contiguous memory, such as the entries
+    // of a Snapshot. They are used in place, without making a collection of
+    // them first.
+    template<typename ITER>
+    void set_intersection (ITER first, ITER last);
+    template<typename ITER>
+    void set_difference (ITER first, ITER last);
+
+    // Exchange content with another collection, including operation counts.
+    void swap (NumList& other) noexcept;
+
+    // An immutable copy of the content, laid out for fast searching by any
+    // number of threads at once. See ipar_frozen.h.
+    FrozenList<BOUND> freeze() const;
+
+    // Number of intervals in the collection
+    std::size_t size() const { return STORAGE::size(); }
+    bool empty() const { return STORAGE::empty(); }
+
     // Report extreme values
     BOUND min() const;
     BOUND max() const;
 
+    // Order statistics. With FlatStorage, which keeps the number of values
+    // in each block up to date, each one is O(log n) plus a scan of one
+    // block. With map storage, the first of these after the collection
+    // changes indexes it in one linear pass; until the next change, each one
+    // is then O(log n). Either way, any number of threads may call them at
+    // once, as for the other const methods.
+
+    // Number of values in the collection
+    count_type cardinality() const;
+    // Number of values from lower to upper, inclusive
+    count_type count (BOUND lower, BOUND upper) const;
+    // Number of intervals that meet [lower, upper]
+    std::size_t count_intervals (BOUND lower, BOUND upper) const;
+    // Number of values less than value
+    count_type rank (BOUND value) const;
+    // The value of the given rank, counting from zero. Throws
+    // numeric_range_error unless rank < cardinality().
+    BOUND select (count_type rank) const;
+    // A value picked uniformly at random. Throws numeric_range_error if the
+    // collection is empty.
+    template<typename GEN>
+    BOUND sample (GEN& gen) const
+    {
+	if (STORAGE::empty()) throw numeric_range_error();
+	std::uniform_int_distribution<count_type> dist(0, cardinality() - 1);
+	return select(dist(gen));
+    }
+
     // For diagnostic use: how many non-trivial transformations have been
     // performed since construction.
     unsigned long num_operations() const;
@@ -126,17 +221,68 @@ public:
 
 private:
 
+    // Called on every change to the content
+    void changed() noexcept
+        { mIndexed.store(false, std::memory_order_relaxed); }
+
+    // Changes an upper bound in place, through the storage if it keeps
+    // counts of values
+    void set_upper (typename STORAGE::iterator iter, BOUND upper);
+
+    // Finds the last interval that starts at or before value, and the number
+    // of values before it, from the storage or from the index. False if
+    // there is none.
+    bool find_interval (BOUND value, std::pair<BOUND,BOUND>& interval,
+                        count_type& before) const;
+
+    // For map storage: fills in mIndex and mCounts, if the content changed
+    // since last time.
+    void build_index() const;
+
     void add_nover (BOUND lower, BOUND upper)  noexcept;
     void subtract_nover (BOUND lower, BOUND upper)  noexcept;
     void subtract_sub1(
-	typename std::map<BOUND, BOUND>::iterator & check_iter,
+	typename STORAGE::iterator & check_iter,
         BOUND new_key, BOUND new_upper);
     void subtract_sub2(
-	typename std::map<BOUND, BOUND>::iterator & check_iter,
+	typename STORAGE::iterator & check_iter,
         BOUND new_upper);
 
+    template<typename ITER>
+    void append_sorted (ITER first, ITER last);
+
+    // Makes the content equal to result, which is sorted, disjoint and
+    // non-adjacent.
+    void replace_content (const std::vector<std::pair<BOUND,BOUND>>& result);
+
+    // Helpers for set algebra. KEEP decides from membership in this
+    // collection (left) and the other (right). The other intervals may come
+    // from a collection or from anywhere else; for probe_intervals, FIND
+    // gives the first interval of large that starts at or after a value.
+    template<typename KEEP>
+    void merge_with (const NumList& other, KEEP keep);
+    template<typename ITER, typename KEEP>
+    void merge_with (ITER first, ITER last, std::size_t count, KEEP keep);
+    template<typename KEEP>
+    static void probe_intervals (
+        const NumList& small, const NumList& large, bool small_is_left,
+        KEEP keep, std::vector<std::pair<BOUND,BOUND>>& result);
+    template<typename SMALL, typename LARGE, typename FIND, typename KEEP>
+    static void probe_intervals (
+        SMALL small, SMALL small_end, LARGE large, LARGE large_end,
+        FIND find, bool small_is_left, KEEP keep,
+        std::vector<std::pair<BOUND,BOUND>>& result);
+
     unsigned long mNumOperations;
 
+    // For order statistics with map storage only: a copy of the intervals,
+    // and the number of values before each one, with the total at the end.
+    // The mutex is held while they are built.
+    mutable std::vector<std::pair<BOUND,BOUND>> mIndex;
+    mutable std::vector<count_type> mCounts;
+    mutable std::atomic<bool> mIndexed;
+    mutable std::mutex mIndexMutex;
+
 }; // class NumList
 
 // Convenience functions
@@ -1,10 +1,15 @@
 #ifndef IPAR_NUMLIST_TCC_ // {
 #define IPAR_NUMLIST_TCC_
 
+#include <algorithm>
 #include <exception>
 #include <functional>
+#include <iterator>
 #include <limits>
 #include <map>
+#include <type_traits>
+#include "ipar_flatstorage.tcc"
+#include "ipar_frozen.tcc"
 
 namespace IPAR {
 
@@ -59,6 +64,155 @@ void verify_special (
     }
 }
 
+// Sorts intervals by lower bound. Unsigned integer bounds, including 128-bit
+// ones, get an LSD radix sort, one byte per pass, skipping any byte that is
+// the same everywhere. Other types, and small batches, go to std::sort.
+template<typename BOUND>
+void sort_intervals (std::vector<std::pair<BOUND,BOUND>>& batch)
+{
+    if constexpr (std::numeric_limits<BOUND>::is_integer &&
+                  !std::numeric_limits<BOUND>::is_signed)
+    {
+	if (batch.size() >= 256)
+	{
+	    // Which bits differ anywhere
+	    BOUND varying = 0;
+	    for (const auto& pr : batch)
+		varying |= pr.first ^ batch.front().first;
+
+	    std::vector<std::pair<BOUND,BOUND>> scratch(batch.size());
+	    for (unsigned int shift = 0 ; shift < 8 * sizeof(BOUND) ; shift += 8)
+	    {
+		if (((varying >> shift) & 0xFF) == 0) continue;
+		std::size_t counts[256] = {};
+		for (const auto& pr : batch)
+		{
+		    ++counts[static_cast<unsigned int>(pr.first >> shift)
+		             & 0xFF];
+		}
+		std::size_t total = 0;
+		for (auto& count : counts)
+		{
+		    std::size_t here = count;
+		    count = total;
+		    total += here;
+		}
+		for (const auto& pr : batch)
+		{
+		    scratch[counts[static_cast<unsigned int>(pr.first >> shift)
+		                   & 0xFF]++] = pr;
+		}
+		batch.swap(scratch);
+	    }
+	    return;
+	}
+    }
+    std::sort(batch.begin(), batch.end());
+}
+
+// Coalesces intervals that are sorted by lower bound, in place. Returns the
+// number of intervals that were absorbed.
+template<typename BOUND>
+unsigned long coalesce_sorted (
+    std::vector<std::pair<BOUND,BOUND>>& batch, BOUND bmax)
+{
+    if (batch.empty()) return 0;
+    std::size_t out = 0;
+    for (std::size_t in = 1 ; in < batch.size() ; ++in)
+    {
+	if (bad_order (batch[out].second, batch[in].first, bmax))
+	{
+	    if (batch[out].second < batch[in].second)
+		batch[out].second = batch[in].second;
+	}
+	else
+	{
+	    batch[++out] = batch[in];
+	}
+    }
+    unsigned long absorbed = batch.size() - (out + 1);
+    batch.resize(out + 1);
+    return absorbed;
+}
+
+// Merges two sorted sequences of disjoint, non-adjacent intervals. Appends
+// to result every stretch of numbers for which keep(in_left, in_right) is
+// true, coalescing with whatever result already ends with. Takes one step for
+// each start or end of an interval.
+template<typename BOUND, typename LEFT, typename RIGHT, typename KEEP>
+void merge_intervals (LEFT left, LEFT left_end, RIGHT right, RIGHT right_end,
+                      BOUND bmax, KEEP keep,
+                      std::vector<std::pair<BOUND,BOUND>>& result)
+{
+    if ((left == left_end) && (right == right_end)) return;
+    BOUND pos;
+    if (left == left_end)
+	pos = right->first;
+    else if ((right == right_end) || (left->first < right->first))
+	pos = left->first;
+    else
+	pos = right->first;
+
+    while ((left != left_end) || (right != right_end))
+    {
+	bool in_left = (left != left_end) && (left->first <= pos);
+	bool in_right = (right != right_end) && (right->first <= pos);
+	if (!in_left && !in_right)
+	{
+	    // A gap in both. Skip to whatever starts next.
+	    if (left == left_end)
+		pos = right->first;
+	    else if ((right == right_end) || (left->first < right->first))
+		pos = left->first;
+	    else
+		pos = right->first;
+	    continue;
+	}
+
+	// The stretch from pos to end is the same throughout
+	BOUND end = bmax;
+	if (left != left_end)
+	    end = in_left ? left->second : left->first - 1;
+	if (right != right_end)
+	{
+	    BOUND right_limit = in_right ? right->second : right->first - 1;
+	    if (right_limit < end) end = right_limit;
+	}
+
+	if (keep(in_left, in_right))
+	{
+	    if (!result.empty() && bad_order (result.back().second, pos, bmax))
+		result.back().second = end;
+	    else
+		result.emplace_back(pos, end);
+	}
+
+	if (in_left && (left->second == end)) ++left;
+	if (in_right && (right->second == end)) ++right;
+	if (end == bmax) break;
+	pos = end; ++pos;
+    }
+}
+
+// Whether a few lookups in a collection of size large are cheaper than a
+// linear pass over it.
+inline bool is_skewed (std::size_t small, std::size_t large)
+{
+    std::size_t log = 1;
+    while ((large >> log) != 0) ++log;
+    return small * log * 4 < large;
+}
+
+// The first of the sorted intervals from first to last that starts at or
+// after value
+template<typename ITER, typename BOUND>
+ITER starting_from (ITER first, ITER last, BOUND value)
+{
+    return std::lower_bound(first, last, value,
+        [](const std::pair<BOUND,BOUND>& pr, BOUND val)
+	    { return pr.first < val; });
+}
+
 } // namespace anonymous
 
 
@@ -89,19 +243,6 @@ noexcept
 }
 
 
-template<typename BOUND, BOUND BMAX>
-NumRange<BOUND,BMAX>::NumRange(const std::pair<BOUND,BOUND>& other)
- : std::pair<BOUND, BOUND>(other)
-{
-}
-
-template<typename BOUND, BOUND BMAX>
-NumRange<BOUND,BMAX>::NumRange(BOUND lower, BOUND upper)
- : std::pair<BOUND, BOUND>(lower, upper)
-{
-    if (lower > upper) throw numeric_range_error();
-}
-
 template<typename BOUND, BOUND BMAX>
 NumRange<BOUND,BMAX>::NumRange(NumRange& nr, BOUND middle)
  : std::pair<BOUND, BOUND>(nr.first, middle)
@@ -110,7 +251,7 @@ NumRange<BOUND,BMAX>::NumRange(NumRange& nr, BOUND middle)
 
     if (nr.first > middle) throw numeric_range_error();
 
-    nr.mLower = ++middle;
+    nr.first = ++middle;
     if (nr.first > nr.second) throw numeric_range_error();
 }
 
@@ -119,55 +260,64 @@ NumRange<BOUND,BMAX>::NumRange(NumRange& nr, BOUND middle)
 // NumList implementation
 //////////////////////////
 
-template<typename BOUND, BOUND BMAX>
-NumList<BOUND,BMAX>::NumList() noexcept
- : std::map<BOUND,BOUND>(), mNumOperations(0)
+template<typename BOUND, BOUND BMAX, typename STORAGE>
+NumList<BOUND,BMAX,STORAGE>::NumList() noexcept
+ : STORAGE(), mNumOperations(0), mIndex(), mCounts(), mIndexed(false),
+   mIndexMutex()
 {
 }
 
-template<typename BOUND, BOUND BMAX>
-NumList<BOUND,BMAX>::NumList(const NumList<BOUND,BMAX>& other)
+template<typename BOUND, BOUND BMAX, typename STORAGE>
+NumList<BOUND,BMAX,STORAGE>::NumList(const NumList<BOUND,BMAX,STORAGE>& other)
     noexcept
- : std::map<BOUND,BOUND>(other), mNumOperations(0)
+ : STORAGE(other), mNumOperations(0), mIndex(), mCounts(), mIndexed(false),
+   mIndexMutex()
 {
 }
 
-template<typename BOUND, BOUND BMAX>
-NumList<BOUND,BMAX>::NumList(NumList<BOUND,BMAX>&& other) noexcept
- : std::map<BOUND,BOUND>(std::move(other)), mNumOperations(0)
+template<typename BOUND, BOUND BMAX, typename STORAGE>
+NumList<BOUND,BMAX,STORAGE>::NumList(NumList<BOUND,BMAX,STORAGE>&& other) noexcept
+ : STORAGE(std::move(other)), mNumOperations(0), mIndex(), mCounts(),
+   mIndexed(false), mIndexMutex()
 {
+    other.changed();
 }
 
-template<typename BOUND, BOUND BMAX>
-NumList<BOUND,BMAX>& NumList<BOUND,BMAX>::operator=(
-    const NumList<BOUND,BMAX>& other) noexcept
+template<typename BOUND, BOUND BMAX, typename STORAGE>
+NumList<BOUND,BMAX,STORAGE>& NumList<BOUND,BMAX,STORAGE>::operator=(
+    const NumList<BOUND,BMAX,STORAGE>& other) noexcept
 {
-    std::map<BOUND,BOUND>::operator=(other);
+    STORAGE::operator=(other);
+    changed();
     // mNumOperations unchanged
     return *this;
 }
 
-template<typename BOUND, BOUND BMAX>
-NumList<BOUND,BMAX>&
-NumList<BOUND,BMAX>::operator=(NumList<BOUND,BMAX>&& other) noexcept
+template<typename BOUND, BOUND BMAX, typename STORAGE>
+NumList<BOUND,BMAX,STORAGE>&
+NumList<BOUND,BMAX,STORAGE>::operator=(NumList<BOUND,BMAX,STORAGE>&& other) noexcept
 {
-    std::map<BOUND,BOUND>::operator=(std::move(other));
+    STORAGE::operator=(std::move(other));
+    changed();
+    other.changed();
     // mNumOperations unchanged
     return *this;
 }
 
-template<typename BOUND, BOUND BMAX>
-void NumList<BOUND,BMAX>::add_nover (BOUND lower, BOUND upper)  noexcept
+template<typename BOUND, BOUND BMAX, typename STORAGE>
+void NumList<BOUND,BMAX,STORAGE>::add_nover (BOUND lower, BOUND upper)  noexcept
 {
+    changed();
+
     // Dispensing with a special case simplifies matters
-    if (std::map<BOUND,BOUND>::empty())
+    if (STORAGE::empty())
     {
-        (*this)[lower] = upper;
+        STORAGE::emplace_hint(STORAGE::end(), lower, upper);
 	return;
     }
 
     // Find a home for the input element
-    auto pr = std::map<BOUND,BOUND>::insert(std::make_pair(lower, upper));
+    auto pr = STORAGE::insert(std::make_pair(lower, upper));
     auto base_iter = pr.first;
     auto check_iter = base_iter;
     if (pr.second)
@@ -188,10 +338,10 @@ void NumList<BOUND,BMAX>::add_nover (BOUND lower, BOUND upper)  noexcept
 	    {
 	         // Coalesce
 		if (prev_iter->second < base_iter->second)
-		    prev_iter->second = base_iter->second;
+		    set_upper(prev_iter, base_iter->second);
 
 		// The new element is now completely redundant
-		base_iter = std::map<BOUND,BOUND>::erase (base_iter);
+		base_iter = STORAGE::erase (base_iter);
 		--base_iter; // Points back to prev_iter
 
 		++mNumOperations;
@@ -204,8 +354,8 @@ void NumList<BOUND,BMAX>::add_nover (BOUND lower, BOUND upper)  noexcept
     else
     {
 	// Found existing element, expand if if necessary
-        if (bad_order (upper, base_iter->second, BMAX))
-	    base_iter->second = upper;
+        if (base_iter->second < upper)
+	    set_upper(base_iter, upper);
 
 	// Begin checking right after existing element
         ++check_iter;
@@ -218,10 +368,10 @@ void NumList<BOUND,BMAX>::add_nover (BOUND lower, BOUND upper)  noexcept
 	{
 	    // coalesce, as before.
 	    if (base_iter->second < check_iter->second)
-		base_iter->second = check_iter->second;
+		set_upper(base_iter, check_iter->second);
 
 	    // The old element is now completely redundant, as before.
-	    check_iter = std::map<BOUND,BOUND>::erase(check_iter);
+	    check_iter = STORAGE::erase(check_iter);
 	    base_iter = std::prev(check_iter);
 
 	    ++mNumOperations;
@@ -234,14 +384,16 @@ void NumList<BOUND,BMAX>::add_nover (BOUND lower, BOUND upper)  noexcept
     }
 }
 
-template<typename BOUND, BOUND BMAX>
-void NumList<BOUND,BMAX>::subtract_nover (BOUND lower, BOUND upper) noexcept
+template<typename BOUND, BOUND BMAX, typename STORAGE>
+void NumList<BOUND,BMAX,STORAGE>::subtract_nover (BOUND lower, BOUND upper) noexcept
 {
+    changed();
+
     // Eliminate a special case
-    if (std::map<BOUND,BOUND>::empty()) return;
+    if (STORAGE::empty()) return;
 
     // Find a location for the input element
-    auto check_iter = std::map<BOUND,BOUND>::lower_bound(lower);
+    auto check_iter = STORAGE::lower_bound(lower);
     // if (lower >= check_iter->first) ...
     if (check_iter != this->cbegin()) --check_iter;
 
@@ -254,28 +406,526 @@ void NumList<BOUND,BMAX>::subtract_nover (BOUND lower, BOUND upper) noexcept
 	subtract_sub2(check_iter, upper);
 }
 
-template<typename BOUND, BOUND BMAX>
-unsigned long NumList<BOUND,BMAX>::num_operations() const
+template<typename BOUND, BOUND BMAX, typename STORAGE>
+void NumList<BOUND,BMAX,STORAGE>::add_batch (
+    std::vector<std::pair<BOUND,BOUND>>& batch)
+{
+    auto by_lower = [](const std::pair<BOUND,BOUND>& left,
+                       const std::pair<BOUND,BOUND>& right)
+	{ return left.first < right.first; };
+
+    // Sort, unless the input is already sorted, and coalesce
+    if (!std::is_sorted(batch.cbegin(), batch.cend(), by_lower))
+	sort_intervals(batch);
+    mNumOperations += coalesce_sorted(batch, BMAX);
+
+    // Dispensing with a special case simplifies matters
+    if (STORAGE::empty())
+    {
+	append_sorted(batch.cbegin(), batch.cend());
+	batch.clear();
+	return;
+    }
+
+    // How much of the batch reaches into existing content?
+    BOUND last = this->crbegin()->second;
+    auto split = std::partition_point(batch.cbegin(), batch.cend(),
+        [last](const std::pair<BOUND,BOUND>& pr)
+	    { return bad_order (last, pr.first, BMAX); });
+    std::size_t overlap = static_cast<std::size_t>(split - batch.cbegin());
+
+    if (overlap * 16 >= STORAGE::size())
+    {
+	// A lot. Cheaper to merge everything in one linear pass and rebuild.
+	std::vector<std::pair<BOUND,BOUND>> merged;
+	merged.reserve(STORAGE::size() + batch.size());
+	std::merge(STORAGE::cbegin(),
+	           STORAGE::cend(),
+	           batch.cbegin(), batch.cend(),
+		   std::back_inserter(merged), by_lower);
+	mNumOperations += coalesce_sorted(merged, BMAX);
+	replace_content(merged);
+	batch.clear();
+	return;
+    }
+
+    // Not much
+    add_sorted(batch.cbegin(), batch.cend());
+    batch.clear();
+}
+
+template<typename BOUND, BOUND BMAX, typename STORAGE>
+template<typename ITER>
+void NumList<BOUND,BMAX,STORAGE>::add_sorted (ITER first, ITER last)
+{
+    // Add one at a time whatever reaches into existing content. That may
+    // extend the end of the collection, so keep going until there is a gap.
+    for ( ; first != last ; ++first)
+    {
+	if (STORAGE::empty() ||
+	    !bad_order (this->crbegin()->second, first->first, BMAX))
+	    break;
+	add_nover(first->first, first->second);
+    }
+
+    // The rest go on the end
+    append_sorted(first, last);
+}
+
+template<typename BOUND, BOUND BMAX, typename STORAGE>
+template<typename ITER>
+void NumList<BOUND,BMAX,STORAGE>::append_sorted (ITER first, ITER last)
+{
+    // Intervals are sorted, disjoint, and beyond any existing content, so
+    // each one goes at the end and the hint is always right.
+    changed();
+    for ( ; first != last ; ++first)
+	STORAGE::emplace_hint(
+	    STORAGE::end(), first->first, first->second);
+}
+
+template<typename BOUND, BOUND BMAX, typename STORAGE>
+void NumList<BOUND,BMAX,STORAGE>::replace_content (
+    const std::vector<std::pair<BOUND,BOUND>>& result)
+{
+    changed();
+    if constexpr (is_map_storage<STORAGE>::value)
+    {
+	// Tree nodes are costly to make and free. Keep every node whose lower
+	// bound is still there, and only erase or insert the others. If little
+	// will be kept, clearing everything is quicker.
+	if (result.size() * 4 < STORAGE::size())
+	{
+	    STORAGE::clear();
+	    append_sorted(result.cbegin(), result.cend());
+	    return;
+	}
+	auto iter = STORAGE::begin();
+	auto pos = result.cbegin();
+	while ((iter != STORAGE::end()) && (pos != result.cend()))
+	{
+	    if (iter->first == pos->first)
+	    {
+		iter->second = pos->second;
+		++iter;
+		++pos;
+	    }
+	    else if (iter->first < pos->first)
+	    {
+		iter = STORAGE::erase(iter);
+	    }
+	    else
+	    {
+		STORAGE::emplace_hint(iter, pos->first, pos->second);
+		++pos;
+	    }
+	}
+	while (iter != STORAGE::end()) iter = STORAGE::erase(iter);
+	append_sorted(pos, result.cend());
+    }
+    else
+    {
+	STORAGE::clear();
+	append_sorted(result.cbegin(), result.cend());
+    }
+}
+
+template<typename BOUND, BOUND BMAX, typename STORAGE>
+void NumList<BOUND,BMAX,STORAGE>::add_list (const NumList<BOUND,BMAX,STORAGE>& other) noexcept
+{
+    add_sorted(other.cbegin(), other.cend());
+    mNumOperations += other.mNumOperations;
+}
+
+template<typename BOUND, BOUND BMAX, typename STORAGE>
+void NumList<BOUND,BMAX,STORAGE>::swap (NumList<BOUND,BMAX,STORAGE>& other) noexcept
+{
+    STORAGE::swap(other);
+    std::swap(mNumOperations, other.mNumOperations);
+    changed();
+    other.changed();
+}
+
+template<typename BOUND, BOUND BMAX, typename STORAGE>
+FrozenList<BOUND> NumList<BOUND,BMAX,STORAGE>::freeze() const
+{
+    return FrozenList<BOUND>(*this);
+}
+
+template<typename BOUND, BOUND BMAX, typename STORAGE>
+template<typename KEEP>
+void NumList<BOUND,BMAX,STORAGE>::probe_intervals (
+    const NumList<BOUND,BMAX,STORAGE>& small,
+    const NumList<BOUND,BMAX,STORAGE>& large, bool small_is_left, KEEP keep,
+    std::vector<std::pair<BOUND,BOUND>>& result)
+{
+    probe_intervals(small.cbegin(), small.cend(), large.cbegin(), large.cend(),
+                    [&large](BOUND value) { return large.lower_bound(value); },
+                    small_is_left, keep, result);
+}
+
+template<typename BOUND, BOUND BMAX, typename STORAGE>
+template<typename SMALL, typename LARGE, typename FIND, typename KEEP>
+void NumList<BOUND,BMAX,STORAGE>::probe_intervals (
+    SMALL small, SMALL small_end, LARGE large, LARGE large_end, FIND find,
+    bool small_is_left, KEEP keep, std::vector<std::pair<BOUND,BOUND>>& result)
+{
+    for (auto iter = small ; iter != small_end ; ++iter)
+    {
+	// Whatever in large overlaps this interval
+	LARGE first = find(iter->first);
+	if (first != large)
+	{
+	    auto before = std::prev(first);
+	    if (before->second >= iter->first) first = before;
+	}
+	auto last = first;
+	while ((last != large_end) && (last->first <= iter->second)) ++last;
+
+	auto next = std::next(iter);
+	if (small_is_left)
+	    merge_intervals(iter, next, first, last, BMAX, keep, result);
+	else
+	    merge_intervals(first, last, iter, next, BMAX, keep, result);
+    }
+}
+
+template<typename BOUND, BOUND BMAX, typename STORAGE>
+template<typename KEEP>
+void NumList<BOUND,BMAX,STORAGE>::merge_with (
+    const NumList<BOUND,BMAX,STORAGE>& other, KEEP keep)
+{
+    merge_with(other.cbegin(), other.cend(), other.size(), keep);
+}
+
+template<typename BOUND, BOUND BMAX, typename STORAGE>
+template<typename ITER, typename KEEP>
+void NumList<BOUND,BMAX,STORAGE>::merge_with (
+    ITER first, ITER last, std::size_t count, KEEP keep)
+{
+    std::vector<std::pair<BOUND,BOUND>> result;
+    merge_intervals(this->cbegin(), this->cend(), first, last, BMAX, keep,
+                    result);
+    mNumOperations += count;
+    replace_content(result);
+}
+
+template<typename BOUND, BOUND BMAX, typename STORAGE>
+void NumList<BOUND,BMAX,STORAGE>::set_union (
+    const NumList<BOUND,BMAX,STORAGE>& other)
+{
+    if (is_skewed(other.size(), STORAGE::size()))
+    {
+	for (auto iter = other.cbegin() ; iter != other.cend() ; ++iter)
+	    add_nover(iter->first, iter->second);
+	return;
+    }
+    merge_with(other, [](bool in_left, bool in_right)
+        { return in_left || in_right; });
+}
+
+template<typename BOUND, BOUND BMAX, typename STORAGE>
+void NumList<BOUND,BMAX,STORAGE>::set_intersection (
+    const NumList<BOUND,BMAX,STORAGE>& other)
+{
+    auto keep = [](bool in_left, bool in_right) { return in_left && in_right; };
+    bool small_this = is_skewed(STORAGE::size(), other.size());
+    if (small_this || is_skewed(other.size(), STORAGE::size()))
+    {
+	std::vector<std::pair<BOUND,BOUND>> result;
+	if (small_this)
+	    probe_intervals(*this, other, true, keep, result);
+	else
+	    probe_intervals(other, *this, false, keep, result);
+	mNumOperations += std::min(other.size(), STORAGE::size());
+	replace_content(result);
+	return;
+    }
+    merge_with(other, keep);
+}
+
+template<typename BOUND, BOUND BMAX, typename STORAGE>
+void NumList<BOUND,BMAX,STORAGE>::set_difference (
+    const NumList<BOUND,BMAX,STORAGE>& other)
+{
+    auto keep = [](bool in_left, bool in_right) { return in_left && !in_right; };
+    if (is_skewed(other.size(), STORAGE::size()))
+    {
+	for (auto iter = other.cbegin() ; iter != other.cend() ; ++iter)
+	    subtract_nover(iter->first, iter->second);
+	return;
+    }
+    if (is_skewed(STORAGE::size(), other.size()))
+    {
+	std::vector<std::pair<BOUND,BOUND>> result;
+	probe_intervals(*this, other, true, keep, result);
+	mNumOperations += STORAGE::size();
+	replace_content(result);
+	return;
+    }
+    merge_with(other, keep);
+}
+
+template<typename BOUND, BOUND BMAX, typename STORAGE>
+template<typename ITER>
+void NumList<BOUND,BMAX,STORAGE>::set_intersection (ITER first, ITER last)
+{
+    auto keep = [](bool in_left, bool in_right)
+	{ return in_left && in_right; };
+    std::size_t other_size = static_cast<std::size_t>(last - first);
+    bool small_this = is_skewed(STORAGE::size(), other_size);
+    if (small_this || is_skewed(other_size, STORAGE::size()))
+    {
+	std::vector<std::pair<BOUND,BOUND>> result;
+	if (small_this)
+	{
+	    probe_intervals(cbegin(), cend(), first, last,
+	        [first, last](BOUND value)
+		    { return starting_from(first, last, value); },
+	        true, keep, result);
+	}
+	else
+	{
+	    probe_intervals(first, last, cbegin(), cend(),
+	        [this](BOUND value) { return lower_bound(value); },
+	        false, keep, result);
+	}
+	mNumOperations += std::min(other_size, STORAGE::size());
+	replace_content(result);
+	return;
+    }
+    merge_with(first, last, other_size, keep);
+}
+
+template<typename BOUND, BOUND BMAX, typename STORAGE>
+template<typename ITER>
+void NumList<BOUND,BMAX,STORAGE>::set_difference (ITER first, ITER last)
+{
+    auto keep = [](bool in_left, bool in_right)
+	{ return in_left && !in_right; };
+    std::size_t other_size = static_cast<std::size_t>(last - first);
+    if (is_skewed(other_size, STORAGE::size()))
+    {
+	for ( ; first != last ; ++first)
+	    subtract_nover(first->first, first->second);
+	return;
+    }
+    if (is_skewed(STORAGE::size(), other_size))
+    {
+	std::vector<std::pair<BOUND,BOUND>> result;
+	probe_intervals(cbegin(), cend(), first, last,
+	    [first, last](BOUND value)
+		{ return starting_from(first, last, value); },
+	    true, keep, result);
+	mNumOperations += STORAGE::size();
+	replace_content(result);
+	return;
+    }
+    merge_with(first, last, other_size, keep);
+}
+
+template<typename BOUND, BOUND BMAX, typename STORAGE>
+void NumList<BOUND,BMAX,STORAGE>::set_symmetric_difference (
+    const NumList<BOUND,BMAX,STORAGE>& other)
+{
+    if (is_skewed(other.size(), STORAGE::size()))
+    {
+	// Find the parts of other that are new here, then remove other and put
+	// those parts back.
+	std::vector<std::pair<BOUND,BOUND>> fresh;
+	probe_intervals(other, *this, false,
+	    [](bool in_left, bool in_right) { return !in_left && in_right; },
+	    fresh);
+	for (auto iter = other.cbegin() ; iter != other.cend() ; ++iter)
+	    subtract_nover(iter->first, iter->second);
+	for (const auto& pr : fresh)
+	    add_nover(pr.first, pr.second);
+	return;
+    }
+    merge_with(other, [](bool in_left, bool in_right)
+        { return in_left != in_right; });
+}
+
+template<typename BOUND, BOUND BMAX, typename STORAGE>
+unsigned long NumList<BOUND,BMAX,STORAGE>::num_operations() const
 {
     return mNumOperations;
 }
 
-template<typename BOUND, BOUND BMAX>
-BOUND NumList<BOUND,BMAX>::min() const
+template<typename BOUND, BOUND BMAX, typename STORAGE>
+BOUND NumList<BOUND,BMAX,STORAGE>::min() const
 {
-    if (std::map<BOUND,BOUND>::empty()) throw (numeric_range_error());
+    if (STORAGE::empty()) throw (numeric_range_error());
     return this->cbegin()->first;
 }
 
-template<typename BOUND, BOUND BMAX>
-BOUND NumList<BOUND,BMAX>::max() const
+template<typename BOUND, BOUND BMAX, typename STORAGE>
+BOUND NumList<BOUND,BMAX,STORAGE>::max() const
 {
-    if (std::map<BOUND,BOUND>::empty()) throw (numeric_range_error());
+    if (STORAGE::empty()) throw (numeric_range_error());
     return this->crbegin()->second;
 }
 
-template<typename BOUND, BOUND BMAX>
-void NumList<BOUND,BMAX>::verify() const
+template<typename BOUND, BOUND BMAX, typename STORAGE>
+void NumList<BOUND,BMAX,STORAGE>::set_upper (
+    typename STORAGE::iterator iter, BOUND upper)
+{
+    if constexpr (is_map_storage<STORAGE>::value)
+	iter->second = upper;
+    else
+	STORAGE::set_upper(iter, upper);
+}
+
+template<typename BOUND, BOUND BMAX, typename STORAGE>
+void NumList<BOUND,BMAX,STORAGE>::build_index() const
+{
+    if (mIndexed.load(std::memory_order_acquire)) return;
+    std::lock_guard<std::mutex> lock(mIndexMutex);
+    if (mIndexed.load(std::memory_order_relaxed)) return;
+    mIndex.assign(this->cbegin(), this->cend());
+    mCounts.resize(mIndex.size() + 1);
+    count_type total = 0;
+    for (std::size_t index = 0 ; index < mIndex.size() ; ++index)
+    {
+	mCounts[index] = total;
+	total += count_type(mIndex[index].second - mIndex[index].first) + 1;
+    }
+    mCounts.back() = total;
+    mIndexed.store(true, std::memory_order_release);
+}
+
+template<typename BOUND, BOUND BMAX, typename STORAGE>
+bool NumList<BOUND,BMAX,STORAGE>::find_interval (
+    BOUND value, std::pair<BOUND,BOUND>& interval, count_type& before) const
+{
+    if constexpr (is_map_storage<STORAGE>::value)
+    {
+	build_index();
+	auto iter = std::upper_bound(mIndex.cbegin(), mIndex.cend(), value,
+	    [](BOUND val, const std::pair<BOUND,BOUND>& pr)
+		{ return val < pr.first; });
+	if (iter == mIndex.cbegin()) return false;
+	std::size_t index =
+	    static_cast<std::size_t>(iter - mIndex.cbegin()) - 1;
+	interval = mIndex[index];
+	before = mCounts[index];
+    }
+    else
+    {
+	auto iter = upper_bound(value);
+	if (iter == cbegin()) return false;
+	--iter;
+	interval = *iter;
+	before = STORAGE::values_before(iter);
+    }
+    return true;
+}
+
+template<typename BOUND, BOUND BMAX, typename STORAGE>
+typename NumList<BOUND,BMAX,STORAGE>::count_type
+NumList<BOUND,BMAX,STORAGE>::cardinality() const
+{
+    if constexpr (is_map_storage<STORAGE>::value)
+    {
+	build_index();
+	return mCounts.back();
+    }
+    else
+    {
+	return STORAGE::values_before(STORAGE::cend());
+    }
+}
+
+template<typename BOUND, BOUND BMAX, typename STORAGE>
+typename NumList<BOUND,BMAX,STORAGE>::count_type
+NumList<BOUND,BMAX,STORAGE>::rank (BOUND value) const
+{
+    std::pair<BOUND,BOUND> interval;
+    count_type before = 0;
+    if (!find_interval(value, interval, before)) return 0;
+    if (value > interval.second)
+	return before + count_type(interval.second - interval.first) + 1;
+    return before + count_type(value - interval.first);
+}
+
+template<typename BOUND, BOUND BMAX, typename STORAGE>
+typename NumList<BOUND,BMAX,STORAGE>::count_type
+NumList<BOUND,BMAX,STORAGE>::count (BOUND lower, BOUND upper) const
+{
+    if (lower > upper) throw numeric_range_error();
+    count_type below = rank(lower);
+
+    // Values up to and including upper
+    std::pair<BOUND,BOUND> interval;
+    count_type before = 0;
+    if (!find_interval(upper, interval, before)) return 0;
+    if (upper >= interval.second)
+	return before + count_type(interval.second - interval.first) + 1 -
+	       below;
+    return before + count_type(upper - interval.first) + 1 - below;
+}
+
+template<typename BOUND, BOUND BMAX, typename STORAGE>
+std::size_t NumList<BOUND,BMAX,STORAGE>::count_intervals (
+    BOUND lower, BOUND upper) const
+{
+    if (lower > upper) throw numeric_range_error();
+
+    if constexpr (is_map_storage<STORAGE>::value)
+    {
+	// Intervals that start at or before upper, less those that end before
+	// lower. Upper bounds are sorted too.
+	build_index();
+	auto last = std::upper_bound(mIndex.cbegin(), mIndex.cend(), upper,
+	    [](BOUND val, const std::pair<BOUND,BOUND>& pr)
+		{ return val < pr.first; });
+	auto first = std::lower_bound(mIndex.cbegin(), last, lower,
+	    [](const std::pair<BOUND,BOUND>& pr, BOUND val)
+		{ return pr.second < val; });
+	return static_cast<std::size_t>(last - first);
+    }
+    else
+    {
+	// From the interval that holds or follows lower, up to the last one
+	// that starts at or before upper
+	auto first = STORAGE::upper_bound(lower);
+	if (first != STORAGE::cbegin())
+	{
+	    auto prev = std::prev(first);
+	    if (prev->second >= lower) first = prev;
+	}
+	return STORAGE::distance(first, STORAGE::upper_bound(upper));
+    }
+}
+
+template<typename BOUND, BOUND BMAX, typename STORAGE>
+BOUND NumList<BOUND,BMAX,STORAGE>::select (count_type rank) const
+{
+    if (STORAGE::empty()) throw numeric_range_error();
+
+    // A full range of 64-bit or wider values counts as zero, and has every
+    // rank
+    count_type total = cardinality();
+    if (total == 0) return this->cbegin()->first + static_cast<BOUND>(rank);
+    if (rank >= total) throw numeric_range_error();
+
+    if constexpr (is_map_storage<STORAGE>::value)
+    {
+	// The last interval with no more than rank values before it
+	auto iter = std::upper_bound(mCounts.cbegin(), mCounts.cend() - 1,
+	                             rank);
+	std::size_t index =
+	    static_cast<std::size_t>(iter - mCounts.cbegin()) - 1;
+	return mIndex[index].first + static_cast<BOUND>(rank - mCounts[index]);
+    }
+    else
+    {
+	return STORAGE::select(rank);
+    }
+}
+
+template<typename BOUND, BOUND BMAX, typename STORAGE>
+void NumList<BOUND,BMAX,STORAGE>::verify() const
 {
     auto iter = this->cbegin();
     if (iter == this->cend()) return;
@@ -299,9 +949,9 @@ void NumList<BOUND,BMAX>::verify() const
     }
 }
 
-template<typename BOUND, BOUND BMAX>
-void NumList<BOUND,BMAX>::subtract_sub1(
-    typename std::map<BOUND, BOUND>::iterator & check_iter,
+template<typename BOUND, BOUND BMAX, typename STORAGE>
+void NumList<BOUND,BMAX,STORAGE>::subtract_sub1(
+    typename STORAGE::iterator & check_iter,
     BOUND new_key, BOUND new_upper)
 {
     // This method is only valid
@@ -327,9 +977,10 @@ void NumList<BOUND,BMAX>::subtract_sub1(
 	//           result:      ***     **
 	replacement_lower = new_upper; ++replacement_lower;
 	replacement_upper = check_iter->second;
-	check_iter->second = new_key; --(check_iter->second);
+	BOUND below = new_key; --below;
+	set_upper(check_iter, below);
 	auto pr = std::make_pair(replacement_lower, replacement_upper);
-	check_iter = std::map<BOUND,BOUND>::insert(std::next(check_iter), pr);
+	check_iter = STORAGE::insert(std::next(check_iter), pr);
 	++check_iter;
 	++mNumOperations;
     }
@@ -339,15 +990,16 @@ void NumList<BOUND,BMAX>::subtract_sub1(
 	//            minus:         *******
 	//            minus:         *************
 	//           result:      ***
-	check_iter->second = new_key; --(check_iter->second);
+	BOUND below = new_key; --below;
+	set_upper(check_iter, below);
 	++check_iter;
 	++mNumOperations;
     }
 }
 
-template<typename BOUND, BOUND BMAX>
-void NumList<BOUND,BMAX>::subtract_sub2(
-    typename std::map<BOUND, BOUND>::iterator & check_iter,
+template<typename BOUND, BOUND BMAX, typename STORAGE>
+void NumList<BOUND,BMAX,STORAGE>::subtract_sub2(
+    typename STORAGE::iterator & check_iter,
     BOUND new_upper)
 {
     // This method is only valid
@@ -363,7 +1015,7 @@ void NumList<BOUND,BMAX>::subtract_sub2(
 	//           result:                **********
 
 	// Indicate completion
-	check_iter = std::map<BOUND,BOUND>::end();
+	check_iter = STORAGE::end();
 	return;
     }
 
@@ -377,9 +1029,9 @@ void NumList<BOUND,BMAX>::subtract_sub2(
 	//           result:           *****
 	replacement_lower = new_upper; ++replacement_lower;
 	replacement_upper = check_iter->second;
-	check_iter = std::map<BOUND,BOUND>::erase(check_iter);
+	check_iter = STORAGE::erase(check_iter);
 	auto pr = std::make_pair(replacement_lower, replacement_upper);
-	check_iter = std::map<BOUND,BOUND>::insert(check_iter, pr);
+	check_iter = STORAGE::insert(check_iter, pr);
 	++check_iter;
 	++mNumOperations;
     }
@@ -389,7 +1041,7 @@ void NumList<BOUND,BMAX>::subtract_sub2(
 	//            minus: ***************
 	//            minus: *******************
 	//           result:
-	check_iter = std::map<BOUND,BOUND>::erase(check_iter);
+	check_iter = STORAGE::erase(check_iter);
 	++mNumOperations;
     }
 }
@@ -0,0 +1,47 @@
+#include <algorithm>
+#include "ipar_pool.h"
+
+namespace IPAR
+{
+
+namespace { // anonymous
+
+// Slots in the first slab, and the most in any slab
+const std::size_t first_slab_slots = 64;
+const std::size_t max_slab_slots = 1 << 16;
+
+} // anonymous namespace
+
+///////////////////////
+// Arena implementation
+///////////////////////
+
+Arena::Arena(std::size_t size, std::size_t alignment)
+ : mSlotSize(0), mAlignment(std::max(alignment, alignof(void*))),
+   mSlabSlots(first_slab_slots), mHeld(0), mSlabs(), mFree(nullptr),
+   mNext(nullptr), mEnd(nullptr)
+{
+    // A free slot holds a pointer to the next one
+    mSlotSize = std::max(size, sizeof(void*));
+    mSlotSize = (mSlotSize + mAlignment - 1) / mAlignment * mAlignment;
+}
+
+Arena::~Arena()
+{
+    for (void* slab : mSlabs)
+	::operator delete(slab, std::align_val_t(mAlignment));
+}
+
+void Arena::grow()
+{
+    std::size_t bytes = mSlabSlots * mSlotSize;
+    mSlabs.reserve(mSlabs.size() + 1);
+    mNext = static_cast<char*>(
+        ::operator new(bytes, std::align_val_t(mAlignment)));
+    mSlabs.push_back(mNext);
+    mEnd = mNext + bytes;
+    mHeld += bytes;
+    mSlabSlots = std::min(mSlabSlots * 2, max_slab_slots);
+}
+
+} // namespace IPAR
@@ -0,0 +1,152 @@
+////////////////////////////////////////////////////////
+// A pool allocator for containers that allocate one
+// node at a time, such as std::map.
+////////////////////////////////////////////////////////
+
+#ifndef IPAR_POOL_H_ // {
+#define IPAR_POOL_H_
+
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace IPAR {
+
+// A pool of slots that are all the same size. Slots are carved out of slabs
+// that grow as the pool does. A freed slot goes on a free list and is handed
+// out again before any new one. Slabs are only released when the pool is
+// destroyed, all at once.
+// Not thread safe.
+class Arena
+{
+public:
+
+    // The automatic methods
+    Arena() = delete;
+    ~Arena();
+    Arena(Arena const& other) = delete;
+    Arena& operator=(Arena const& other) = delete;
+    Arena(Arena&& other) = delete;
+    Arena& operator=(Arena&& other) = delete;
+
+    // Slots of at least the given size and alignment
+    Arena(std::size_t size, std::size_t alignment);
+
+    // Whether slots suit objects of the given size and alignment
+    bool fits (std::size_t size, std::size_t alignment) const
+        { return (size <= mSlotSize) && (mAlignment % alignment == 0); }
+
+    void* allocate()
+    {
+	if (mFree != nullptr)
+	{
+	    void* slot = mFree;
+	    std::memcpy(&mFree, slot, sizeof(void*));
+	    return slot;
+	}
+	if (mNext == mEnd) grow();
+	void* slot = mNext;
+	mNext += mSlotSize;
+	return slot;
+    }
+
+    void deallocate (void* slot) noexcept
+    {
+	std::memcpy(slot, &mFree, sizeof(void*));
+	mFree = slot;
+    }
+
+    // For diagnostic use: bytes held in slabs
+    std::size_t memory_used() const { return mHeld; }
+
+private:
+
+    // Starts a new slab, twice the size of the last one up to a limit
+    void grow();
+
+    std::size_t mSlotSize;
+    std::size_t mAlignment;
+    std::size_t mSlabSlots;         // Slots in the next slab
+    std::size_t mHeld;
+    std::vector<void*> mSlabs;
+    void* mFree;                    // Head of the free list
+    char* mNext;                    // Rest of the newest slab
+    char* mEnd;
+
+}; // class Arena
+
+// An allocator that takes single objects from an Arena, and anything else
+// from operator new. Each container gets an arena of its own: it is made on
+// the first allocation, shared with rebound copies of the allocator, and
+// taken along when the container is moved or swapped. A copy of a container
+// starts a new arena, so two containers never share one.
+template<typename T>
+class PoolAllocator
+{
+public:
+
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::false_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+    using is_always_equal = std::false_type;
+
+    // The automatic methods. Moving leaves the other allocator with no arena.
+    PoolAllocator() noexcept : mArena() { }
+    ~PoolAllocator() = default;
+    PoolAllocator(PoolAllocator const& other) noexcept = default;
+    PoolAllocator& operator=(PoolAllocator const& other) noexcept = default;
+    PoolAllocator(PoolAllocator&& other) noexcept
+     : mArena(std::move(other.mArena)) { }
+    PoolAllocator& operator=(PoolAllocator&& other) noexcept
+    {
+	mArena = std::move(other.mArena);
+	return *this;
+    }
+
+    // Rebinding shares the arena
+    template<typename U>
+    PoolAllocator(const PoolAllocator<U>& other) noexcept
+     : mArena(other.mArena) { }
+
+    PoolAllocator select_on_container_copy_construction() const
+        { return PoolAllocator(); }
+
+    T* allocate (std::size_t count)
+    {
+	if (count == 1)
+	{
+	    if (!mArena)
+		mArena = std::make_shared<Arena>(sizeof(T), alignof(T));
+	    if (mArena->fits(sizeof(T), alignof(T)))
+		return static_cast<T*>(mArena->allocate());
+	}
+	return static_cast<T*>(::operator new(count * sizeof(T)));
+    }
+
+    void deallocate (T* ptr, std::size_t count) noexcept
+    {
+	if ((count == 1) && mArena && mArena->fits(sizeof(T), alignof(T)))
+	    mArena->deallocate(ptr);
+	else
+	    ::operator delete(ptr);
+    }
+
+    template<typename U>
+    bool operator== (const PoolAllocator<U>& other) const noexcept
+        { return mArena == other.mArena; }
+
+private:
+
+    template<typename U> friend class PoolAllocator;
+
+    std::shared_ptr<Arena> mArena;
+
+}; // class PoolAllocator
+
+} // namespace IPAR
+
+#endif // } IPAR_POOL_H_
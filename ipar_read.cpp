@@ -1,70 +1,90 @@
 // Program ipar_read
 // ----------------
 // Reads a list of IP address ranges from standard input.
-// Writes out equivalent list of ranges in one of three formats, to 
+// Writes out equivalent list of ranges in one of five formats, to 
 // standard output:
 //  * standard form.
 //  * intervals, with dashes.
 //  * individual 32-bit numbers, in hex format.
-// The last format is useful for testing.
+//  * a binary snapshot, which all the programs can read back quickly.
+//  * individual 32-bit numbers, raw in host byte order.
+// The hex and raw formats are useful for testing.
+// Input may mix IPv4 and IPv6. IPv6 ranges are written out after the
+// IPv4 ones, in the same format: 128-bit numbers for hex and raw.
+// With -j N, input is parsed on N threads.
 
 #include <iostream>
-#include <iomanip>
 #include <string>
 #include <cstring>
+#include <unistd.h>
 using namespace std;
 #include "ipar_iplist.h"
 #include "ipar_common.h"
+#include "ipar_list6.h"
+#include "ipar_snapshot.h"
 
 int main (int argc, char* argv[])
 {
     // Process arguments
-    IPAR::OutputStyle style;
-    switch (argc)
+    IPAR::OutputStyle style = IPAR::Scidr;
+    unsigned int jobs = 1;
+    bool bStyle = false;
+    for (int iArg = 1 ; iArg < argc ; ++iArg)
     {
-    case 1:
-	style = IPAR::Scidr;
-        break;
-    case 2:
-        style = IPAR::o_style(argv[1]);
-	if (style == IPAR::Sunknown)
+	std::string arg(argv[iArg]);
+	if ((arg == "-j") && (iArg + 1 < argc))
 	{
-	    cerr << "Usage: ipar_read [-cidr|-dashes|-hex]" << endl;
-	    cerr << "(no other arguments)" << endl;
-	    return 1;
+	    jobs = IPAR::o_jobs(argv[++iArg]);
+	    if (jobs != 0) continue;
 	}
-        break;
-    default:
-        cerr << "Usage: ipar_read [-cidr|-dashes|-hex]" << endl;
+	else if (!bStyle)
+	{
+	    style = IPAR::o_style(arg);
+	    bStyle = true;
+	    if (style != IPAR::Sunknown) continue;
+	}
+	cerr << "Usage: ipar_read [-j N] [-cidr|-dashes|-hex|-binary|-raw]" << endl;
 	cerr << "(no other arguments)" << endl;
 	return 1;
     }
 
     IPAR::List iplist;
-    if (int retval = IPAR::common_read (cin, iplist) != 0) return retval;
+    IPAR::List6 iplist6;
+    if (int retval = IPAR::common_read (STDIN_FILENO, iplist, iplist6, jobs)
+        != 0)
+        return retval;
 
     // Report
-    cerr << iplist.num_operations() << " operations applied, ";
+    cerr << iplist.num_operations() + iplist6.num_operations()
+         << " operations applied, ";
     auto numLines = iplist.num_output();
+    if (style == IPAR::Sbinary)
+    {
+	IPAR::write_snapshot(cout, iplist, iplist6);
+	cerr << iplist.size() + iplist6.size() << " intervals written" << endl;
+	return 0;
+    }
+    IPAR::Writer out(STDOUT_FILENO);
     if (style == IPAR::Shex)
     {
 	iplist.verify();
-	cout << hex << setfill('0');
-        for (auto iter = iplist.cbegin() ; iter != iplist.cend() ; ++iter)
-	{
-	    uint32_t lower = iter->first;
-	    while (lower <= iter->second)
-	    {
-		cout << setw(8) << lower++ << endl;
-	    }
-	}
+	iplist6.verify();
+	iplist.expand(out, IPAR::Ehex);
+	iplist6.expand(out, IPAR::Ehex);
+    }
+    else if (style == IPAR::Sraw)
+    {
+	iplist.expand(out, IPAR::Eraw);
+	iplist6.expand(out, IPAR::Eraw);
     }
     else
     {
-	// TODO: write a manipulator for iplist.
-	iplist.print(cout, (style == IPAR::Sdashes));
+	iplist.print(out, (style == IPAR::Sdashes), jobs);
+	iplist6.print(out, (style == IPAR::Sdashes));
     }
-    cerr << iplist.num_output() - numLines << " lines output" << endl;
+    out.flush();
+    cerr << iplist.num_output() - numLines + iplist6.num_output()
+         << " lines output" << endl;
 
     return 0;
 }
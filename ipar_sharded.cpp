@@ -0,0 +1,353 @@
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include "ipar_sharded.h"
+#include "ipar_threads.h"
+
+namespace IPAR
+{
+
+namespace { // anonymous
+
+// Starting size of each print buffer. A size_t, so that the Writer keeps its
+// output in memory rather than taking this for a file descriptor.
+const std::size_t buffer_size = 1 << 16;
+
+} // namespace anonymous
+
+const char* shard_error::what() const noexcept
+{
+    return "Could not process shards";
+}
+
+/////////////////////////////
+// ShardedList implementation
+/////////////////////////////
+
+ShardedList::ShardedList(unsigned int bits, unsigned int jobs)
+ : mBits(bits), mJobs(jobs), mShards(), mNumOutput(0)
+{
+    if (mBits > max_bits) throw shard_error();
+    mShards.resize(static_cast<std::size_t>(1) << mBits);
+}
+
+ShardedList::ShardedList(const List& list, unsigned int bits,
+                         unsigned int jobs)
+ : ShardedList(bits, jobs)
+{
+    parallel_for (mJobs, mShards.size(), [&](std::size_t shard)
+    {
+	std::vector<value_type> part = part_of(list, shard);
+	mShards[shard].add_sorted(part.data(), part.data() + part.size());
+    });
+}
+
+ShardedList::const_iterator ShardedList::cbegin() const
+{
+    return const_iterator(this, 0, mShards[0].cbegin());
+}
+
+ShardedList::const_iterator ShardedList::cend() const
+{
+    return const_iterator(this, mShards.size(), mShards.back().cend());
+}
+
+void ShardedList::add (const Range& range)
+{
+    uint32_t lower = range.get().first;
+    uint32_t upper = range.get().second;
+    for (std::size_t shard = shard_of(lower) ; shard <= shard_of(upper) ;
+         ++shard)
+    {
+	mShards[shard].add(Range(std::max(lower, shard_lower(shard)),
+	                         std::min(upper, shard_upper(shard))));
+    }
+}
+
+void ShardedList::subtract (const Range& range)
+{
+    uint32_t lower = range.get().first;
+    uint32_t upper = range.get().second;
+    for (std::size_t shard = shard_of(lower) ; shard <= shard_of(upper) ;
+         ++shard)
+    {
+	mShards[shard].subtract(Range(std::max(lower, shard_lower(shard)),
+	                              std::min(upper, shard_upper(shard))));
+    }
+}
+
+void ShardedList::add_batch (std::vector<value_type>& batch)
+{
+    std::vector<std::vector<value_type>> parts(mShards.size());
+    for (const auto& pr : batch)
+    {
+	if (pr.first > pr.second) throw numeric_range_error();
+	for (std::size_t shard = shard_of(pr.first) ;
+	     shard <= shard_of(pr.second) ; ++shard)
+	{
+	    parts[shard].push_back(
+	        value_type(std::max(pr.first, shard_lower(shard)),
+	                   std::min(pr.second, shard_upper(shard))));
+	}
+    }
+    batch.clear();
+
+    parallel_for (mJobs, mShards.size(), [&](std::size_t shard)
+    {
+	mShards[shard].add_batch(parts[shard]);
+    });
+}
+
+void ShardedList::add_list (const List& other)
+{
+    parallel_for (mJobs, mShards.size(), [&](std::size_t shard)
+    {
+	std::vector<value_type> part = part_of(other, shard);
+	mShards[shard].add_batch(part);
+    });
+}
+
+void ShardedList::set_union (const ShardedList& other)
+{
+    check_shards(other);
+    parallel_for (mJobs, mShards.size(), [&](std::size_t shard)
+    {
+	mShards[shard].set_union(other.mShards[shard]);
+    });
+}
+
+void ShardedList::set_intersection (const ShardedList& other)
+{
+    check_shards(other);
+    parallel_for (mJobs, mShards.size(), [&](std::size_t shard)
+    {
+	mShards[shard].set_intersection(other.mShards[shard]);
+    });
+}
+
+void ShardedList::set_difference (const ShardedList& other)
+{
+    check_shards(other);
+    parallel_for (mJobs, mShards.size(), [&](std::size_t shard)
+    {
+	mShards[shard].set_difference(other.mShards[shard]);
+    });
+}
+
+void ShardedList::set_symmetric_difference (const ShardedList& other)
+{
+    check_shards(other);
+    parallel_for (mJobs, mShards.size(), [&](std::size_t shard)
+    {
+	mShards[shard].set_symmetric_difference(other.mShards[shard]);
+    });
+}
+
+bool ShardedList::contains (uint32_t address) const
+{
+    const List& list = mShards[shard_of(address)];
+    auto iter = list.upper_bound(address);
+    return (iter != list.cbegin()) && (address <= (--iter)->second);
+}
+
+std::size_t ShardedList::size() const
+{
+    std::size_t total = 0;
+    for (std::size_t shard = 0 ; shard < mShards.size() ; ++shard)
+    {
+	total += mShards[shard].size();
+	if (joins_next(shard)) --total;
+    }
+    return total;
+}
+
+bool ShardedList::empty() const
+{
+    return std::all_of(mShards.cbegin(), mShards.cend(),
+        [](const List& list) { return list.empty(); });
+}
+
+uint64_t ShardedList::cardinality() const
+{
+    uint64_t total = 0;
+    for (const auto& list : mShards) total += list.cardinality();
+    return total;
+}
+
+List ShardedList::to_list() const
+{
+    std::vector<value_type> intervals;
+    intervals.reserve(size());
+    for (auto iter = cbegin() ; iter != cend() ; ++iter)
+	intervals.push_back(*iter);
+    List list;
+    list.add_sorted(intervals.data(), intervals.data() + intervals.size());
+    return list;
+}
+
+void ShardedList::print(Writer& out, bool dashes) const
+{
+    for (auto iter = cbegin() ; iter != cend() ; ++iter)
+	mNumOutput += print_interval(out, dashes, iter->first, iter->second);
+}
+
+void ShardedList::print(Writer& out, bool dashes, unsigned int jobs) const
+{
+    if ((jobs <= 1) || (mShards.size() == 1))
+    {
+	print(out, dashes);
+	return;
+    }
+
+    // Work in rounds of a few shards per thread, as List::print does. Each
+    // shard prints the intervals that start in it, joined with whatever
+    // follows in later shards.
+    std::size_t shards_per_round = static_cast<std::size_t>(jobs) * 2;
+    std::vector<std::unique_ptr<Writer>> buffers;
+    for (std::size_t slot = 0 ; slot < shards_per_round ; ++slot)
+	buffers.emplace_back(new Writer(buffer_size));
+    std::vector<unsigned long> lines(shards_per_round);
+
+    for (std::size_t first = 0 ; first < mShards.size() ;
+         first += shards_per_round)
+    {
+	std::size_t count = std::min(shards_per_round, mShards.size() - first);
+	parallel_for(jobs, count, [&](std::size_t slot)
+	{
+	    std::size_t shard = first + slot;
+	    Writer& buffer = *buffers[slot];
+	    buffer.clear();
+	    lines[slot] = 0;
+
+	    // Skip the continuation of an interval from an earlier shard
+	    auto start = mShards[shard].cbegin();
+	    if ((shard != 0) && joins_next(shard - 1)) ++start;
+	    if (start == mShards[shard].cend()) return;
+	    for (const_iterator iter(this, shard, start) ;
+	         iter.mShard == shard ; ++iter)
+	    {
+		lines[slot] += print_interval(buffer, dashes, iter->first,
+		                              iter->second);
+	    }
+	});
+
+	// In order
+	for (std::size_t slot = 0 ; slot < count ; ++slot)
+	{
+	    out.put(buffers[slot]->text(), buffers[slot]->size());
+	    mNumOutput += lines[slot];
+	}
+    }
+}
+
+unsigned long ShardedList::num_operations() const
+{
+    unsigned long total = 0;
+    for (const auto& list : mShards) total += list.num_operations();
+    return total;
+}
+
+void ShardedList::verify() const
+{
+    for (std::size_t shard = 0 ; shard < mShards.size() ; ++shard)
+    {
+	const List& list = mShards[shard];
+	list.verify();
+	if (!list.empty() && ((list.cbegin()->first < shard_lower(shard)) ||
+	                      (list.crbegin()->second > shard_upper(shard))))
+	    throw shard_error();
+    }
+}
+
+uint32_t ShardedList::shard_lower (std::size_t shard) const
+{
+    return (mBits == 0) ? 0 : static_cast<uint32_t>(shard << (32 - mBits));
+}
+
+uint32_t ShardedList::shard_upper (std::size_t shard) const
+{
+    if (mBits == 0) return std::numeric_limits<uint32_t>::max();
+    uint32_t mask = (static_cast<uint32_t>(1) << (32 - mBits)) - 1;
+    return shard_lower(shard) | mask;
+}
+
+std::size_t ShardedList::shard_of (uint32_t address) const
+{
+    return (mBits == 0) ? 0 : (address >> (32 - mBits));
+}
+
+bool ShardedList::joins_next (std::size_t shard) const
+{
+    if (shard + 1 >= mShards.size()) return false;
+    const List& list = mShards[shard];
+    const List& next = mShards[shard + 1];
+    return !list.empty() && !next.empty() &&
+	(list.crbegin()->second == shard_upper(shard)) &&
+	(next.cbegin()->first == shard_lower(shard + 1));
+}
+
+std::vector<ShardedList::value_type> ShardedList::part_of (
+    const List& list, std::size_t shard) const
+{
+    uint32_t lower = shard_lower(shard);
+    uint32_t upper = shard_upper(shard);
+
+    // Start with the interval that reaches into the shard from below, if any
+    auto iter = list.upper_bound(lower);
+    if (iter != list.cbegin())
+    {
+	auto before = iter;
+	if ((--before)->second >= lower) iter = before;
+    }
+
+    std::vector<value_type> part;
+    for ( ; (iter != list.cend()) && (iter->first <= upper) ; ++iter)
+    {
+	part.push_back(value_type(std::max(iter->first, lower),
+	                          std::min(iter->second, upper)));
+    }
+    return part;
+}
+
+void ShardedList::check_shards (const ShardedList& other) const
+{
+    if (other.mBits != mBits) throw shard_error();
+}
+
+std::ostream& operator<< (std::ostream& ost, const ShardedList& list)
+{
+    Writer out(ost);
+    list.print(out);
+    return ost;
+}
+
+//////////////////////////////////////////////
+// ShardedList::const_iterator implementation
+//////////////////////////////////////////////
+
+void ShardedList::const_iterator::settle()
+{
+    const std::vector<List>& shards = mList->mShards;
+    while ((mShard < shards.size()) && (mIter == shards[mShard].cend()))
+    {
+	if (++mShard < shards.size()) mIter = shards[mShard].cbegin();
+    }
+    if (mShard == shards.size()) return;
+
+    mValue = value_type(mIter->first, mIter->second);
+    mNextShard = mShard;
+    mNext = mIter;
+    ++mNext;
+
+    // Pieces of the same interval in the shards that follow
+    while ((mNext == shards[mNextShard].cend()) &&
+           mList->joins_next(mNextShard))
+    {
+	++mNextShard;
+	mNext = shards[mNextShard].cbegin();
+	mValue.second = mNext->second;
+	++mNext;
+    }
+}
+
+} // namespace IPAR
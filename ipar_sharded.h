@@ -0,0 +1,200 @@
+////////////////////////////////////////////////////////
+// A List split by address prefix, for set operations
+// on several threads.
+////////////////////////////////////////////////////////
+
+#ifndef IPAR_SHARDED_H_ // {
+#define IPAR_SHARDED_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iterator>
+#include <utility>
+#include <vector>
+#include "ipar_iplist.h"
+
+namespace IPAR {
+
+// An exception that is thrown by this software.
+class shard_error : public std::exception
+{
+public:
+    virtual const char* what() const noexcept;
+};
+
+// The address space split into 2^bits shards of equal size, by prefix, each
+// with a List of its own. An interval that crosses a shard boundary is cut
+// in pieces, one per shard. Since the shards never overlap, a set operation
+// between two sharded lists is the same operation on each pair of shards,
+// and those run on up to "jobs" threads.
+//
+// From the outside it looks like a List. Iteration and print join the pieces
+// that meet at shard boundaries again, so they give exactly what a List with
+// the same content would.
+class ShardedList
+{
+public:
+
+    using value_type = std::pair<uint32_t,uint32_t>;
+
+    // Largest number of shard bits
+    static const unsigned int max_bits = 16;
+
+    // The automatic methods
+    ShardedList() = delete;
+    ~ShardedList() = default;
+    ShardedList(ShardedList const& other) = default;
+    ShardedList& operator=(ShardedList const& other) = default;
+    ShardedList(ShardedList&& other) = default;
+    ShardedList& operator=(ShardedList&& other) = default;
+
+    // An empty list of 2^bits shards. Throws shard_error if bits is above
+    // max_bits.
+    explicit ShardedList(unsigned int bits, unsigned int jobs = 1);
+
+    // A copy of a List. The list is split on up to "jobs" threads.
+    ShardedList(const List& list, unsigned int bits, unsigned int jobs = 1);
+
+    // Iteration in sorted order. Pieces are joined on the fly, so
+    // dereferencing gives a pair by value.
+    class const_iterator
+    {
+    public:
+	using iterator_category = std::forward_iterator_tag;
+	using value_type = std::pair<uint32_t,uint32_t>;
+	using difference_type = std::ptrdiff_t;
+	using pointer = void;
+	using reference = value_type;
+
+	// What operator-> points into
+	struct arrow
+	{
+	    value_type mPair;
+	    const value_type* operator->() const { return &mPair; }
+	};
+
+	value_type operator*() const { return mValue; }
+	arrow operator->() const { return arrow{mValue}; }
+
+	const_iterator& operator++()
+	{
+	    mShard = mNextShard;
+	    mIter = mNext;
+	    settle();
+	    return *this;
+	}
+	const_iterator operator++(int)
+	    { const_iterator old(*this); ++*this; return old; }
+
+	bool operator==(const const_iterator& other) const
+	{
+	    return (mShard == other.mShard) &&
+		((mShard == mList->mShards.size()) || (mIter == other.mIter));
+	}
+
+    private:
+
+	friend class ShardedList;
+
+	const_iterator(const ShardedList* list, std::size_t shard,
+	               ListBase::const_iterator iter)
+	 : mList(list), mShard(shard), mIter(iter), mNextShard(shard),
+	   mNext(iter), mValue()
+	    { settle(); }
+
+	// Moves on to the next interval, if not at one already, and joins
+	// whatever follows it across shard boundaries.
+	void settle();
+
+	const ShardedList* mList;
+	std::size_t mShard;         // Where the interval starts
+	ListBase::const_iterator mIter;
+	std::size_t mNextShard;     // Where the next one starts looking
+	ListBase::const_iterator mNext;
+	value_type mValue;
+
+    }; // class const_iterator
+
+    const_iterator cbegin() const;
+    const_iterator cend() const;
+    const_iterator begin() const { return cbegin(); }
+    const_iterator end() const { return cend(); }
+
+    // Add or remove an interval of IP addresses.
+    void add (const Range& range);
+    void subtract (const Range& range);
+
+    // Add many intervals at once, in any order. Each shard takes its part
+    // with List::add_batch.
+    void add_batch (std::vector<value_type>& batch);
+
+    // Add every interval of a List.
+    void add_list (const List& other);
+
+    // Set algebra, shard by shard. Throws shard_error unless both lists have
+    // the same number of shards.
+    void set_union (const ShardedList& other);
+    void set_intersection (const ShardedList& other);
+    void set_difference (const ShardedList& other);
+    void set_symmetric_difference (const ShardedList& other);
+
+    // Whether an address is in the list
+    bool contains (uint32_t address) const;
+
+    // Number of intervals, with pieces joined, and number of addresses
+    std::size_t size() const;
+    bool empty() const;
+    uint64_t cardinality() const;
+
+    // A List with the same content
+    List to_list() const;
+
+    // Print out everything in the list, as List::print does. With jobs,
+    // shards are formatted on up to that many threads into separate
+    // buffers, then written out in order.
+    void print(Writer& out, bool dashes=false) const;
+    void print(Writer& out, bool dashes, unsigned int jobs) const;
+
+    // The shards, in order
+    unsigned int bits() const { return mBits; }
+    std::size_t num_shards() const { return mShards.size(); }
+    const List& shard (std::size_t index) const { return mShards[index]; }
+
+    // For diagnostic use, as for List. Operations are summed over shards.
+    unsigned long num_operations() const;
+    unsigned long num_output() const { return mNumOutput; }
+
+    // For debugging
+    void verify() const;
+
+private:
+
+    // First and last address of a shard, and the shard of an address
+    uint32_t shard_lower (std::size_t shard) const;
+    uint32_t shard_upper (std::size_t shard) const;
+    std::size_t shard_of (uint32_t address) const;
+
+    // Whether the last interval of a shard and the first of the next one
+    // are pieces of the same interval
+    bool joins_next (std::size_t shard) const;
+
+    // The part of a list that falls in a shard, cut at its boundaries
+    std::vector<value_type> part_of (const List& list,
+                                     std::size_t shard) const;
+
+    // Throws shard_error unless other has the same shards
+    void check_shards (const ShardedList& other) const;
+
+    unsigned int mBits;
+    unsigned int mJobs;
+    std::vector<List> mShards;
+    mutable unsigned long mNumOutput;
+
+}; // class ShardedList
+
+std::ostream& operator<< (std::ostream&, const ShardedList&);
+
+} // namespace IPAR
+
+#endif // } IPAR_SHARDED_H_
@@ -0,0 +1,279 @@
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include "ipar_snapshot.h"
+
+namespace IPAR {
+
+namespace { // anonymous
+
+inline uint64_t rotate (uint64_t val, int bits)
+{
+    return (val << bits) | (val >> (64 - bits));
+}
+
+inline uint64_t mix (uint64_t val)
+{
+    val ^= val >> 33;
+    val *= 0xFF51AFD7ED558CCDULL;
+    val ^= val >> 33;
+    val *= 0xC4CEB9FE1A85EC53ULL;
+    val ^= val >> 33;
+    return val;
+}
+
+// Builds the index described in ipar_snapshot.h, for the intervals from
+// first up to last
+template<typename ITER>
+std::vector<uint32_t> make_index (ITER first, ITER last)
+{
+    std::vector<uint32_t> index(snapshot_index_size);
+    uint32_t position = 0;
+    uint32_t slash8 = 0;
+    for (auto iter = first ; iter != last ; ++iter)
+    {
+	while ((slash8 < 256) && ((iter->second >> 24) >= slash8))
+	    index[slash8++] = position;
+	++position;
+    }
+    while (slash8 < snapshot_index_size) index[slash8++] = position;
+    return index;
+}
+
+// Whether intervals are in the standard form of a List or List6: sorted,
+// never overlapping or adjacent. Careful of numeric overflow at the top.
+template<typename BOUND>
+bool in_order (const std::pair<BOUND,BOUND>& entry)
+{
+    return entry.first <= entry.second;
+}
+
+template<typename BOUND>
+bool in_order (const std::pair<BOUND,BOUND>& prev,
+               const std::pair<BOUND,BOUND>& next)
+{
+    return in_order(next) && (prev.second < next.first) &&
+	(next.first - prev.second > 1);
+}
+
+// One IPv6 interval of a snapshot, which may not be aligned
+std::pair<uint128_t,uint128_t> load_entry6 (const char* entries,
+                                            std::size_t index)
+{
+    SnapshotEntry6 entry;
+    std::memcpy(&entry, entries + index * sizeof(entry), sizeof(entry));
+    return std::make_pair(
+        (static_cast<uint128_t>(entry.mLowerHigh) << 64) | entry.mLowerLow,
+        (static_cast<uint128_t>(entry.mUpperHigh) << 64) | entry.mUpperLow);
+}
+
+} // namespace anonymous
+
+
+///////////////////////////////////////
+// Implementation of exception classes
+///////////////////////////////////////
+
+const char* snapshot_error::what() const noexcept
+{
+    return "Could not load binary snapshot";
+}
+
+
+////////////////////////////////////
+// Implementation of Snapshot class
+////////////////////////////////////
+
+Snapshot::Snapshot(std::string_view bytes)
+ : mEntries(nullptr), mCount(0), mIndex(nullptr), mEntries6(nullptr),
+   mCount6(0)
+{
+    if (!detect(bytes)) throw snapshot_error();
+    SnapshotHeader header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    if ((header.mByteOrder != snapshot_byte_order) ||
+        ((header.mVersion != snapshot_version) &&
+         (header.mVersion != snapshot_version6)))
+	throw snapshot_error();
+
+    // Sizes must agree exactly
+    std::size_t available = bytes.size() - sizeof(header);
+    if (header.mCount > available / sizeof(SnapshotEntry))
+	throw snapshot_error();
+    std::size_t needed = header.mCount * sizeof(SnapshotEntry);
+    if (header.mFlags & snapshot_index)
+	needed += snapshot_index_size * sizeof(uint32_t);
+    const char* body = bytes.data() + sizeof(header);
+    if (header.mVersion == snapshot_version6)
+    {
+	uint64_t count6;
+	if (available - needed < sizeof(count6)) throw snapshot_error();
+	std::memcpy(&count6, body + needed, sizeof(count6));
+	needed += sizeof(count6);
+	if (count6 > (available - needed) / sizeof(SnapshotEntry6))
+	    throw snapshot_error();
+	mEntries6 = body + needed;
+	mCount6 = count6;
+	needed += count6 * sizeof(SnapshotEntry6);
+    }
+    if (needed != available) throw snapshot_error();
+
+    if (hash64(body, available) != header.mChecksum) throw snapshot_error();
+
+    // A good checksum only means the file is what was written. Whatever
+    // wrote it, the content must be in standard form, or every List made
+    // from it would go wrong later without a word.
+    mEntries = reinterpret_cast<const SnapshotEntry*>(body);
+    mCount = header.mCount;
+    for (std::size_t index = 0 ; index < mCount ; ++index)
+    {
+	if ((index == 0) ? !in_order(mEntries[0]) :
+	    !in_order(mEntries[index - 1], mEntries[index]))
+	    throw snapshot_error();
+    }
+    for (std::size_t index = 0 ; index < mCount6 ; ++index)
+    {
+	auto entry = load_entry6(mEntries6, index);
+	if ((index == 0) ? !in_order(entry) :
+	    !in_order(load_entry6(mEntries6, index - 1), entry))
+	    throw snapshot_error();
+    }
+    if (header.mFlags & snapshot_index)
+    {
+	mIndex = reinterpret_cast<const uint32_t*>(
+	    body + mCount * sizeof(SnapshotEntry));
+	std::vector<uint32_t> index = make_index(begin(), end());
+	if (!std::equal(index.cbegin(), index.cend(), mIndex))
+	    throw snapshot_error();
+    }
+}
+
+std::vector<std::pair<uint128_t,uint128_t>> Snapshot::entries6() const
+{
+    std::vector<std::pair<uint128_t,uint128_t>> entries(mCount6);
+    for (std::size_t index = 0 ; index < mCount6 ; ++index)
+	entries[index] = load_entry6(mEntries6, index);
+    return entries;
+}
+
+bool Snapshot::detect(std::string_view bytes)
+{
+    return (bytes.size() >= sizeof(SnapshotHeader)) &&
+	(std::memcmp(bytes.data(), snapshot_magic, sizeof(snapshot_magic))
+	 == 0);
+}
+
+bool Snapshot::contains(uint32_t address) const
+{
+    const SnapshotEntry* first = begin();
+    const SnapshotEntry* last = end();
+    if (mIndex != nullptr)
+    {
+	uint32_t slash8 = address >> 24;
+	first = mEntries + mIndex[slash8];
+	last = mEntries + std::min<std::size_t>(mIndex[slash8 + 1] + 1, mCount);
+    }
+
+    // First entry that ends at or after the address
+    const SnapshotEntry* found = std::lower_bound(first, last, address,
+        [](const SnapshotEntry& entry, uint32_t addr)
+	    { return entry.second < addr; });
+    return (found != last) && (found->first <= address);
+}
+
+
+///////////////////////////////////////////
+// Implementation of stand-alone functions
+///////////////////////////////////////////
+
+void write_snapshot (std::ostream& ost, const List& iplist)
+{
+    write_snapshot(ost, iplist, List6());
+}
+
+void write_snapshot (std::ostream& ost, const List& iplist,
+                     const List6& iplist6)
+{
+    std::vector<SnapshotEntry> entries;
+    entries.reserve(iplist.size());
+    for (auto iter = iplist.cbegin() ; iter != iplist.cend() ; ++iter)
+	entries.push_back(SnapshotEntry { iter->first, iter->second });
+    std::vector<uint32_t> index = make_index(iplist.cbegin(), iplist.cend());
+
+    std::size_t entry_bytes = entries.size() * sizeof(SnapshotEntry);
+    std::size_t index_bytes = index.size() * sizeof(uint32_t);
+    std::vector<char> body(entry_bytes + index_bytes);
+    if (entry_bytes != 0) std::memcpy(body.data(), entries.data(), entry_bytes);
+    std::memcpy(body.data() + entry_bytes, index.data(), index_bytes);
+
+    // IPv6 section, only if needed
+    if (!iplist6.empty())
+    {
+	uint64_t count6 = iplist6.size();
+	const char* bytes = reinterpret_cast<const char*>(&count6);
+	body.insert(body.end(), bytes, bytes + sizeof(count6));
+	for (auto iter = iplist6.cbegin() ; iter != iplist6.cend() ; ++iter)
+	{
+	    SnapshotEntry6 entry {
+		static_cast<uint64_t>(iter->first >> 64),
+		static_cast<uint64_t>(iter->first),
+		static_cast<uint64_t>(iter->second >> 64),
+		static_cast<uint64_t>(iter->second) };
+	    bytes = reinterpret_cast<const char*>(&entry);
+	    body.insert(body.end(), bytes, bytes + sizeof(entry));
+	}
+    }
+
+    SnapshotHeader header;
+    std::memcpy(header.mMagic, snapshot_magic, sizeof(snapshot_magic));
+    header.mByteOrder = snapshot_byte_order;
+    header.mVersion = iplist6.empty() ? snapshot_version : snapshot_version6;
+    header.mFlags = snapshot_index;
+    header.mReserved = 0;
+    header.mCount = entries.size();
+    header.mChecksum = hash64(body.data(), body.size());
+
+    ost.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    ost.write(body.data(), static_cast<std::streamsize>(body.size()));
+    ost.flush();
+}
+
+uint64_t hash64 (const void* data, std::size_t length, uint64_t seed)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint64_t hash = seed ^ (length * 0x9E3779B97F4A7C15ULL);
+
+    // Four independent lanes of eight bytes each
+    uint64_t lanes[4] = { hash, hash + 1, hash + 2, hash + 3 };
+    while (length >= 32)
+    {
+	for (int lane = 0 ; lane < 4 ; ++lane)
+	{
+	    uint64_t word;
+	    std::memcpy(&word, bytes + 8 * lane, 8);
+	    lanes[lane] = rotate(lanes[lane] ^ (word * 0x87C37B91114253D5ULL),
+	                         31) * 0x4CF5AD432745937FULL;
+	}
+	bytes += 32;
+	length -= 32;
+    }
+    hash = mix(lanes[0]) ^ rotate(mix(lanes[1]), 16) ^
+	   rotate(mix(lanes[2]), 32) ^ rotate(mix(lanes[3]), 48);
+
+    // Left-overs
+    while (length >= 8)
+    {
+	uint64_t word;
+	std::memcpy(&word, bytes, 8);
+	hash = rotate(hash ^ mix(word), 27) * 0x9E3779B97F4A7C15ULL;
+	bytes += 8;
+	length -= 8;
+    }
+    uint64_t tail = 0;
+    std::memcpy(&tail, bytes, length);
+    hash ^= mix(tail ^ length);
+
+    return mix(hash);
+}
+
+} // namespace IPAR
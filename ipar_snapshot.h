@@ -0,0 +1,127 @@
+////////////////////////////////////////////////////////
+// Binary snapshots of IPAR lists. A snapshot can be
+// used in place without parsing, typically after
+// mapping it into memory with MappedText.
+////////////////////////////////////////////////////////
+
+#ifndef IPAR_SNAPSHOT_H_ // {
+#define IPAR_SNAPSHOT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <ostream>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "ipar_iplist.h"
+#include "ipar_list6.h"
+
+namespace IPAR {
+
+// An exception that is thrown by this software.
+class snapshot_error : public std::exception
+{
+public:
+    virtual const char* what() const noexcept;
+};
+
+// Layout of a snapshot file, all in host byte order:
+//  * A SnapshotHeader.
+//  * mCount of SnapshotEntry, in sorted order, never overlapping or
+//    adjacent. That is, exactly the content of an IPAR::List.
+//  * If flag snapshot_index is set, 257 of uint32_t. Entry n is the position
+//    of the first SnapshotEntry whose upper bound is n.0.0.0 or above. The
+//    last one is mCount.
+//  * In version 2 only, a uint64_t count of IPv6 intervals, then that many
+//    SnapshotEntry6, in the same standard form as an IPAR::List6.
+// The checksum is hash64 of everything that follows the header. Snapshots
+// without IPv6 content are written as version 1.
+const char snapshot_magic[8] = { 'I', 'P', 'A', 'R', 'S', 'N', 'A', 'P' };
+const uint32_t snapshot_byte_order = 0x01020304;
+const uint32_t snapshot_version = 1;
+const uint32_t snapshot_version6 = 2;
+const uint32_t snapshot_index = 0x1;
+const std::size_t snapshot_index_size = 257;
+
+struct SnapshotHeader
+{
+    char mMagic[8];
+    uint32_t mByteOrder;
+    uint32_t mVersion;
+    uint32_t mFlags;
+    uint32_t mReserved;
+    uint64_t mCount;
+    uint64_t mChecksum;
+};
+
+// One interval: lower and upper bound.
+using SnapshotEntry = std::pair<uint32_t,uint32_t>;
+static_assert(sizeof(SnapshotEntry) == 8, "unexpected padding");
+
+// One IPv6 interval, as high and low halves of lower and upper bound. The
+// entries are only 4-aligned, so they are never used in place.
+struct SnapshotEntry6
+{
+    uint64_t mLowerHigh;
+    uint64_t mLowerLow;
+    uint64_t mUpperHigh;
+    uint64_t mUpperLow;
+};
+static_assert(sizeof(SnapshotEntry6) == 32, "unexpected padding");
+
+// A read-only view of a snapshot in memory. Nothing is copied.
+class Snapshot
+{
+public:
+
+    // The automatic methods
+    Snapshot() = delete;
+    ~Snapshot() = default;
+    Snapshot(Snapshot const& other) = default;
+    Snapshot& operator=(Snapshot const& other) = default;
+    Snapshot(Snapshot&& other) = default;
+    Snapshot& operator=(Snapshot&& other) = default;
+
+    // Checks header, size and checksum, that the intervals are in standard
+    // form, and the index. Throws snapshot_error. The bytes must stay in
+    // place for the life of this object.
+    Snapshot(std::string_view bytes);
+
+    // Whether the bytes start like a snapshot. Cheap, checks nothing else.
+    static bool detect(std::string_view bytes);
+
+    // The only way to access content
+    const SnapshotEntry* begin() const { return mEntries; }
+    const SnapshotEntry* end() const { return mEntries + mCount; }
+    std::size_t size() const { return mCount; }
+
+    // The IPv6 intervals, copied out in sorted order. See List6::add_batch.
+    std::vector<std::pair<uint128_t,uint128_t>> entries6() const;
+    std::size_t size6() const { return mCount6; }
+
+    // Membership test. Uses the index, if there is one.
+    bool contains(uint32_t address) const;
+
+private:
+
+    const SnapshotEntry* mEntries;
+    std::size_t mCount;
+    const uint32_t* mIndex;
+    const char* mEntries6;
+    std::size_t mCount6;
+
+}; // class Snapshot
+
+// Writes out a list as a snapshot, with an index. The second one adds IPv6
+// content, if there is any.
+void write_snapshot (std::ostream& ost, const List& iplist);
+void write_snapshot (std::ostream& ost, const List& iplist,
+                     const List6& iplist6);
+
+// 64-bit hash of a block of memory. Fast, not cryptographic.
+uint64_t hash64 (const void* data, std::size_t length, uint64_t seed = 0);
+
+} // namespace IPAR
+
+#endif //  } IPAR_SNAPSHOT_H_
@@ -5,51 +5,154 @@
 // Logically removes everything in the other lists from the first list.
 // Writes out the result to standard output.
 // None of the inputs have to be sorted.
+// Any of the inputs may be a binary snapshot, see ipar_read -binary.
+// Inputs may mix IPv4 and IPv6. Each kind is subtracted from its own kind,
+// and IPv6 results are written out after the IPv4 ones.
+// With -j N, each input is parsed on N threads, and the files are loaded
+// side by side.
+// With -cache, parsed files are cached, see ipar_cache.h.
+// With -bitmap, the subtraction is done on IPAR::Bitmap. That also happens
+// without -bitmap when the first list is dense enough, see Bitmap::suits.
+// The bitmap is for IPv4 only.
+// With -shards K, the set operations are done on an IPAR::ShardedList of
+// 2^K shards, shard by shard on N threads. K is from 1 to 16. The bitmap,
+// when it suits, takes precedence.
 
+#include <memory>
 #include <string>
+#include <utility>
+#include <vector>
+#include <unistd.h>
 using namespace std;
 #include "ipar_iplist.h"
 #include "ipar_common.h"
+#include "ipar_list6.h"
+#include "ipar_cache.h"
+#include "ipar_bitmap.h"
+#include "ipar_sharded.h"
 
 int main (int argc, char* argv[])
 {
+    // Process options
+    unsigned int jobs = 1;
+    bool bCache = false;
+    bool bBitmap = false;
+    unsigned int shardBits = 0;
+    int iFirst = 1;
+    for ( ; iFirst < argc ; ++iFirst)
+    {
+	std::string arg(argv[iFirst]);
+	if (arg == "-cache")
+	{
+	    bCache = true;
+	}
+	else if (arg == "-bitmap")
+	{
+	    bBitmap = true;
+	}
+	else if (arg == "-j")
+	{
+	    if ((++iFirst == argc) || ((jobs = IPAR::o_jobs(argv[iFirst])) == 0))
+	    {
+		cerr << "Usage: ipar_subtract [-j N] [-cache] [-bitmap]"
+		     << " [-shards K] file ..." << endl;
+		return 1;
+	    }
+	}
+	else if (arg == "-shards")
+	{
+	    if ((++iFirst == argc) ||
+	        ((shardBits = IPAR::o_jobs(argv[iFirst])) == 0) ||
+	        (shardBits > IPAR::ShardedList::max_bits))
+	    {
+		cerr << "Usage: ipar_subtract [-j N] [-cache] [-bitmap]"
+		     << " [-shards K] file ..." << endl;
+		return 1;
+	    }
+	}
+	else
+	{
+	    break;
+	}
+    }
+    IPAR::FileCache cache(bCache);
+
     IPAR::List mainlist;
+    IPAR::List6 mainlist6;
 
     // Loop over lines of input
-    if (int retval = IPAR::common_read (cin, mainlist) != 0) return retval;
+    if (int retval =
+        IPAR::common_read (STDIN_FILENO, mainlist, mainlist6, jobs) != 0)
+        return retval;
 
-    // Loop over input files to subtract
-    for (int iArg = 1 ; iArg < argc ; ++iArg)
+    // Everything in the files to subtract, each loaded on a thread of its
+    // own and then merged, so that it can be subtracted in one go. A lone
+    // snapshot is subtracted in place instead, unless the bitmap or the
+    // shards need a list anyway.
+    IPAR::List others;
+    IPAR::List6 others6;
+    vector<string> filenames(argv + iFirst, argv + argc);
+    bool bUseBitmap = bBitmap || IPAR::Bitmap::suits (mainlist);
+    unique_ptr<IPAR::SnapshotFile> operand;
+    if (!bUseBitmap && (shardBits == 0) && (filenames.size() == 1))
+	operand = make_unique<IPAR::SnapshotFile> (filenames[0]);
+    if (operand && *operand)
+    {
+	auto entries6 = operand->snapshot().entries6();
+	others6.add_batch (entries6);
+    }
+    else if (cache.read_all (filenames, others, others6, jobs) != 0)
     {
-	IPAR::FileReader reader2(argv[iArg]);
-	if (!reader2) return 1;
+	return 1;
+    }
 
-	// Loop over words in the subtract file
-        string word;
-	while (reader2 >> word)
-	{
-	    // Assume the word is a range of IPv4 addresses
-            IPAR::Range iprange;
-	    try {
-		iprange = IPAR::Range(word);
-	    }
-	    catch (const exception& ex) {
-		cerr << "ERROR: " << ex.what() << " at line "
-		     << reader2.line_no()
-		     << " of \"" << argv[iArg] << "\": " << endl;
-		cerr << reader2.current_line() << endl;
-		cerr << "Last input was \"" << word << "\"" << endl;
-		return 1;
-	    }
-            mainlist.subtract(iprange);
-	} // End loop overwords in the subtract file
-    } // End loop over input files to subtract
+    // Only used with -shards. Then mainlist is left empty.
+    IPAR::ShardedList mainsharded (shardBits, jobs);
+
+    if (bUseBitmap)
+    {
+	IPAR::Bitmap mainbitmap (mainlist);
+	mainbitmap.set_difference (IPAR::Bitmap (others));
+	IPAR::List result;
+	mainbitmap.add_to (result);
+
+	// Moved in, so that mainlist keeps its count of operations
+	mainlist = std::move (result);
+    }
+    else if (shardBits != 0)
+    {
+	mainsharded = IPAR::ShardedList (mainlist, shardBits, jobs);
+	mainlist = IPAR::List ();
+	mainsharded.set_difference (
+	    IPAR::ShardedList (others, shardBits, jobs));
+    }
+    else if (operand && *operand)
+    {
+	mainlist.set_difference (operand->snapshot().begin(),
+	                         operand->snapshot().end());
+    }
+    else
+    {
+	mainlist.set_difference (others);
+    }
+    mainlist6.set_difference (others6);
 
     // Report
+    if (bCache)
+    {
+	cerr << cache.hits() << " cache hits, " << cache.misses()
+	     << " cache misses, ";
+    }
     auto numLines = mainlist.num_output();
-    cerr << mainlist.num_operations() << " operations applied, ";
-    cout << mainlist;
-    cerr << mainlist.num_output() - numLines << " lines output" << endl;
+    cerr << mainlist.num_operations() + mainsharded.num_operations() +
+            mainlist6.num_operations() << " operations applied, ";
+    IPAR::Writer out(STDOUT_FILENO);
+    mainlist.print(out, false, jobs);
+    mainsharded.print(out, false, jobs);
+    mainlist6.print(out);
+    out.flush();
+    cerr << mainlist.num_output() - numLines + mainsharded.num_output() +
+            mainlist6.num_output() << " lines output" << endl;
 
     return 0;
 }
@@ -0,0 +1,113 @@
+#include <algorithm>
+#include "ipar_table.h"
+
+namespace IPAR
+{
+
+namespace { // anonymous
+
+// Entries in the first level
+const std::size_t first_size = std::size_t(1) << 24;
+
+// How many addresses ahead the batch lookup prefetches first-level entries.
+// Chunks are prefetched half as far ahead, once their entry has arrived.
+const std::size_t ahead = 32;
+
+} // anonymous namespace
+
+///////////////////////
+// Table implementation
+///////////////////////
+
+Table::~Table()
+{
+}
+
+Table::Table(Table const& other) = default;
+Table& Table::operator=(Table const& other) = default;
+Table::Table(Table&& other) noexcept = default;
+Table& Table::operator=(Table&& other) noexcept = default;
+
+Table::Table(const List& list)
+ : mFirst(first_size, Enone), mChunks()
+{
+    for (auto iter = list.cbegin() ; iter != list.cend() ; ++iter)
+	add(iter->first, iter->second);
+}
+
+Table::Table(const std::pair<uint32_t,uint32_t>* first,
+             const std::pair<uint32_t,uint32_t>* last)
+ : mFirst(first_size, Enone), mChunks()
+{
+    for ( ; first != last ; ++first) add(first->first, first->second);
+}
+
+void Table::add (uint32_t lower, uint32_t upper)
+{
+    uint32_t first_block = lower >> 8;
+    uint32_t last_block = upper >> 8;
+
+    // A partial block at each end, and whole blocks in between
+    if ((lower & 0xFF) != 0)
+    {
+	uint32_t last = (first_block == last_block) ? (upper & 0xFF) : 0xFF;
+	set_partial(first_block, lower & 0xFF, last);
+	if (first_block == last_block) return;
+	++first_block;
+    }
+    if ((upper & 0xFF) != 0xFF)
+    {
+	set_partial(last_block, 0, upper & 0xFF);
+	if (first_block == last_block) return;
+	--last_block;
+    }
+    std::fill(mFirst.begin() + first_block, mFirst.begin() + last_block + 1,
+              uint32_t(Eall));
+}
+
+void Table::set_partial (uint32_t block, unsigned int first,
+                         unsigned int last)
+{
+    if (mFirst[block] == Enone)
+    {
+	mFirst[block] = chunk_base + static_cast<uint32_t>(num_chunks());
+	mChunks.resize(mChunks.size() + 4, 0);
+    }
+    uint64_t* chunk = &mChunks[(mFirst[block] - chunk_base) * 4];
+    for (unsigned int word = first >> 6 ; word <= (last >> 6) ; ++word)
+    {
+	unsigned int low = std::max(first, word * 64) & 63;
+	unsigned int high = std::min(last, word * 64 + 63) & 63;
+	chunk[word] |= (~uint64_t(0) << low) & (~uint64_t(0) >> (63 - high));
+    }
+}
+
+void Table::contains (std::span<const uint32_t> addresses,
+                      std::span<bool> results) const
+{
+    std::size_t count = addresses.size();
+    for (std::size_t index = 0 ; index < count ; ++index)
+    {
+	if (index + ahead < count)
+	    __builtin_prefetch(&mFirst[addresses[index + ahead] >> 8]);
+	if (index + ahead / 2 < count)
+	{
+	    uint32_t address = addresses[index + ahead / 2];
+	    uint32_t entry = mFirst[address >> 8];
+	    if (entry >= chunk_base)
+	    {
+		__builtin_prefetch(
+		    &mChunks[(entry - chunk_base) * 4 + ((address >> 6) & 3)]);
+	    }
+	}
+	results[index] = contains(addresses[index]);
+    }
+}
+
+std::size_t Table::memory_used() const
+{
+    return sizeof(*this) + mFirst.capacity() * sizeof(uint32_t) +
+           mChunks.capacity() * sizeof(uint64_t);
+}
+
+} // namespace IPAR
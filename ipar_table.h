@@ -0,0 +1,84 @@
+////////////////////////////////////////////////////////
+// A membership table compiled from a List, for looking
+// up very many single addresses.
+////////////////////////////////////////////////////////
+
+#ifndef IPAR_TABLE_H_ // {
+#define IPAR_TABLE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+#include "ipar_iplist.h"
+
+namespace IPAR {
+
+// A read-only copy of a List in DIR-24-8 form. The first level has an entry
+// for each of the 2^24 blocks of 256 addresses: either none of the block is
+// in the list, or all of it is, or the entry points to a second-level chunk
+// of 256 bits. A lookup is one memory read, or two for a block that is only
+// partly in the list. The first level takes 64 MB whatever the list holds;
+// each chunk takes 32 bytes more.
+// The table does not follow later changes to the list.
+class Table
+{
+public:
+
+    // The automatic methods
+    Table() = delete;
+    ~Table();
+    Table(Table const& other);
+    Table& operator=(Table const& other);
+    Table(Table&& other) noexcept;
+    Table& operator=(Table&& other) noexcept;
+
+    // Compiles a list
+    explicit Table(const List& list);
+
+    // Compiles intervals in place, such as the entries of a Snapshot
+    Table(const std::pair<uint32_t,uint32_t>* first,
+          const std::pair<uint32_t,uint32_t>* last);
+
+    // Whether an address is in the list
+    bool contains (uint32_t address) const
+    {
+	uint32_t entry = mFirst[address >> 8];
+	if (entry < chunk_base) return entry != Enone;
+	return (mChunks[(entry - chunk_base) * 4 + ((address >> 6) & 3)] >>
+	        (address & 63)) & 1;
+    }
+
+    // The same, for many addresses at once. Memory for addresses further
+    // along is prefetched while earlier ones are looked up, so that the
+    // reads overlap. results must be as long as addresses.
+    void contains (std::span<const uint32_t> addresses,
+                   std::span<bool> results) const;
+
+    // For diagnostic use: bytes held, and second-level chunks.
+    std::size_t memory_used() const;
+    std::size_t num_chunks() const { return mChunks.size() / 4; }
+
+private:
+
+    // Sets the bits of one interval
+    void add (uint32_t lower, uint32_t upper);
+
+    // Sets bits first to last of the chunk for a block, which is made if
+    // the block does not have one yet
+    void set_partial (uint32_t block, unsigned int first, unsigned int last);
+
+    // First-level entries. From chunk_base up, an entry is chunk_base plus
+    // the number of a chunk.
+    enum Entry : uint32_t { Enone = 0, Eall = 1 };
+    static const uint32_t chunk_base = 2;
+
+    std::vector<uint32_t> mFirst;       // 2^24 entries
+    std::vector<uint64_t> mChunks;      // Four words per chunk
+
+}; // class Table
+
+} // namespace IPAR
+
+#endif // } IPAR_TABLE_H_
@@ -0,0 +1,150 @@
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include "ipar_threads.h"
+
+namespace IPAR {
+
+void parallel_for (unsigned int jobs, std::size_t tasks,
+                   const std::function<void(std::size_t)>& work)
+{
+    if (jobs > tasks) jobs = static_cast<unsigned int>(tasks);
+
+    // No need for threads
+    if (jobs <= 1)
+    {
+	for (std::size_t task = 0 ; task < tasks ; ++task) work(task);
+	return;
+    }
+
+    std::atomic<std::size_t> next(0);
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    auto runner = [&]()
+    {
+	std::size_t task;
+	while ((task = next.fetch_add(1)) < tasks)
+	{
+	    try {
+		work(task);
+	    }
+	    catch (...) {
+		std::lock_guard<std::mutex> lock(error_mutex);
+		if (!error) error = std::current_exception();
+	    }
+	}
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(jobs - 1);
+    for (unsigned int job = 1 ; job < jobs ; ++job)
+	threads.emplace_back(runner);
+    runner();
+    for (auto& thr : threads) thr.join();
+
+    if (error) std::rethrow_exception(error);
+}
+
+void parallel_ranges (unsigned int jobs, std::size_t count, std::size_t grain,
+    const std::function<void(unsigned int, std::size_t, std::size_t)>& work)
+{
+    if (grain == 0) grain = 1;
+    std::size_t grains = (count + grain - 1) / grain;
+    if (jobs > grains) jobs = static_cast<unsigned int>(grains);
+
+    // No need for threads
+    if (jobs <= 1)
+    {
+	for (std::size_t begin = 0 ; begin < count ; begin += grain)
+	    work(0, begin, std::min(begin + grain, count));
+	return;
+    }
+
+    // What is left of each thread's share
+    struct Share
+    {
+	std::mutex mMutex;
+	std::size_t mBegin;
+	std::size_t mEnd;
+    };
+    std::vector<Share> shares(jobs);
+    for (unsigned int job = 0 ; job < jobs ; ++job)
+    {
+	shares[job].mBegin = count * job / jobs;
+	shares[job].mEnd = count * (job + 1) / jobs;
+    }
+
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    auto runner = [&](unsigned int job)
+    {
+	Share& own = shares[job];
+	while (true)
+	{
+	    // A grain off the front of the own share
+	    std::size_t begin = 0, end = 0;
+	    {
+		std::lock_guard<std::mutex> lock(own.mMutex);
+		if (own.mBegin != own.mEnd)
+		{
+		    begin = own.mBegin;
+		    end = std::min(begin + grain, own.mEnd);
+		    own.mBegin = end;
+		}
+	    }
+	    if (begin != end)
+	    {
+		try {
+		    work(job, begin, end);
+		}
+		catch (...) {
+		    std::lock_guard<std::mutex> lock(error_mutex);
+		    if (!error) error = std::current_exception();
+		}
+		continue;
+	    }
+
+	    // Otherwise, half of the largest share. Sizes are looked at one
+	    // share at a time, so the victim may have shrunk by the time it
+	    // is locked again; then look again.
+	    unsigned int victim = jobs;
+	    std::size_t largest = 0;
+	    for (unsigned int other = 0 ; other < jobs ; ++other)
+	    {
+		std::lock_guard<std::mutex> lock(shares[other].mMutex);
+		std::size_t left = shares[other].mEnd - shares[other].mBegin;
+		if (left > largest)
+		{
+		    victim = other;
+		    largest = left;
+		}
+	    }
+	    if (victim == jobs) break;
+	    {
+		std::lock_guard<std::mutex> lock(shares[victim].mMutex);
+		Share& share = shares[victim];
+		std::size_t left = share.mEnd - share.mBegin;
+		std::size_t middle = share.mBegin + left / 2;
+		begin = middle;
+		end = share.mEnd;
+		share.mEnd = middle;
+	    }
+	    std::lock_guard<std::mutex> lock(own.mMutex);
+	    own.mBegin = begin;
+	    own.mEnd = end;
+	}
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(jobs - 1);
+    for (unsigned int job = 1 ; job < jobs ; ++job)
+	threads.emplace_back(runner, job);
+    runner(0);
+    for (auto& thr : threads) thr.join();
+
+    if (error) std::rethrow_exception(error);
+}
+
+} // namespace IPAR
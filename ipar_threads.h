@@ -0,0 +1,52 @@
+////////////////////////////////////////////////////////
+// Simple helpers for running work on several threads.
+////////////////////////////////////////////////////////
+
+#ifndef IPAR_THREADS_H_ // {
+#define IPAR_THREADS_H_
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+namespace IPAR {
+
+// Calls work(0) through work(tasks-1), using up to "jobs" threads. The calling
+// thread is one of them. Tasks are handed out in order as threads become
+// free. If any task throws, the first exception is rethrown here after all
+// threads have finished.
+void parallel_for (unsigned int jobs, std::size_t tasks,
+                   const std::function<void(std::size_t)>& work);
+
+// Calls work(thread, begin, end) for pieces [begin, end) of 0 ... count-1,
+// using up to "jobs" threads, numbered from zero. Each thread starts with an
+// equal share and takes it on a grain at a time, front to back, so that a
+// thread sees increasing pieces for as long as it can. One that runs out
+// takes the back half of what is left of the largest share, and carries on
+// with that. Exceptions are handled as for parallel_for.
+void parallel_ranges (unsigned int jobs, std::size_t count, std::size_t grain,
+    const std::function<void(unsigned int, std::size_t, std::size_t)>& work);
+
+// Combines items[0] ... items[n-1] into items[0] by pairwise tree reduction.
+// Each round combines items that are a power of two apart, so the order of
+// the items is respected. Calls combine(into, from) for each pair. Pairs in
+// the same round are combined in parallel.
+template<typename ITEM, typename COMBINE>
+void parallel_reduce (unsigned int jobs, std::vector<ITEM>& items,
+                      COMBINE combine)
+{
+    std::size_t count = items.size();
+    for (std::size_t stride = 1 ; stride < count ; stride *= 2)
+    {
+	std::size_t pairs = (count - stride + (2 * stride) - 1) / (2 * stride);
+	parallel_for (jobs, pairs, [&](std::size_t pair)
+	{
+	    std::size_t into = pair * 2 * stride;
+	    combine (items[into], items[into + stride]);
+	});
+    }
+}
+
+} // namespace IPAR
+
+#endif //  } IPAR_THREADS_H_
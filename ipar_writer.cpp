@@ -0,0 +1,343 @@
+#include <cerrno>
+#include <unistd.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "ipar_writer.h"
+
+namespace IPAR {
+
+namespace { // anonymous
+
+// Size at which output is handed over
+const std::size_t chunk = 1 << 20;
+
+// Each octet as text, padded with zeros to four characters, and its length.
+struct OctetText
+{
+    char mText[4];
+    unsigned char mLength;
+};
+
+struct OctetTable
+{
+    OctetText mEntries[256];
+
+    constexpr OctetTable() : mEntries{}
+    {
+	for (int val = 0 ; val < 256 ; ++val)
+	{
+	    OctetText& entry = mEntries[val];
+	    int len = 0;
+	    if (val >= 100) entry.mText[len++] = static_cast<char>('0' + val / 100);
+	    if (val >= 10)
+		entry.mText[len++] = static_cast<char>('0' + (val / 10) % 10);
+	    entry.mText[len++] = static_cast<char>('0' + val % 10);
+	    entry.mLength = static_cast<unsigned char>(len);
+	}
+    }
+};
+constexpr OctetTable octets;
+const OctetText* const octet_table = octets.mEntries;
+
+constexpr char hex_digits[] = "0123456789abcdef";
+
+// Addresses are expanded in blocks that share their upper 24 bits.
+const unsigned int block_size = 256;
+
+// Text of a block of hex lines xxxxxx00 to xxxxxxff, nine characters each,
+// with the six leading characters of every line left as zero bytes. A full
+// block of output is this template OR'ed with the leading characters.
+struct HexTemplate
+{
+    alignas(16) char mText[block_size * 9];
+
+    constexpr HexTemplate() : mText{}
+    {
+	for (unsigned int low = 0 ; low < block_size ; ++low)
+	{
+	    mText[low * 9 + 6] = hex_digits[low >> 4];
+	    mText[low * 9 + 7] = hex_digits[low & 0xF];
+	    mText[low * 9 + 8] = '\n';
+	}
+    }
+};
+constexpr HexTemplate hex_template;
+
+// Hex lines for "count" addresses starting at lower, which all share their
+// upper 24 bits. Returns the end of the text.
+char* hex_block (char* pos, uint32_t lower, unsigned int count)
+{
+    if (count < block_size)
+    {
+	for (unsigned int line = 0 ; line < count ; ++line)
+	{
+	    uint32_t val = lower + line;
+	    for (int digit = 7 ; digit >= 0 ; --digit)
+	    {
+		pos[digit] = hex_digits[val & 0xF];
+		val >>= 4;
+	    }
+	    pos[8] = '\n';
+	    pos += 9;
+	}
+	return pos;
+    }
+
+    // The leading characters repeat every 16 lines, which is 144 bytes: nine
+    // 16 byte vectors or eighteen 8 byte words.
+    alignas(16) char leading[144] = {};
+    uint32_t high = lower >> 8;
+    for (int digit = 5 ; digit >= 0 ; --digit)
+    {
+	leading[digit] = hex_digits[high & 0xF];
+	high >>= 4;
+    }
+    for (unsigned int line = 1 ; line < 16 ; ++line)
+	std::memcpy(leading + line * 9, leading, 6);
+
+#if defined(__SSE2__)
+    __m128i vectors[9];
+    for (int index = 0 ; index < 9 ; ++index)
+	vectors[index] = _mm_load_si128(
+	    reinterpret_cast<const __m128i*>(leading) + index);
+    const __m128i* src = reinterpret_cast<const __m128i*>(hex_template.mText);
+    __m128i* dst = reinterpret_cast<__m128i*>(pos);
+    for (int group = 0 ; group < 16 ; ++group)
+    {
+	for (int index = 0 ; index < 9 ; ++index)
+	    _mm_storeu_si128(dst++,
+	        _mm_or_si128(_mm_load_si128(src++), vectors[index]));
+    }
+#else
+    uint64_t words[18];
+    std::memcpy(words, leading, sizeof(words));
+    const char* src = hex_template.mText;
+    char* dst = pos;
+    for (int group = 0 ; group < 16 ; ++group)
+    {
+	for (int index = 0 ; index < 18 ; ++index)
+	{
+	    uint64_t word;
+	    std::memcpy(&word, src, 8);
+	    word |= words[index];
+	    std::memcpy(dst, &word, 8);
+	    src += 8;
+	    dst += 8;
+	}
+    }
+#endif
+    return pos + sizeof(hex_template.mText);
+}
+
+// Dotted quad lines, as for hex_block. Lines are copied 16 characters at a
+// time, so up to 16 characters past the end may be overwritten.
+char* quad_block (char* pos, uint32_t lower, unsigned int count)
+{
+    // Everything up to the last octet is the same for the whole block
+    char prefix[16] = {};
+    std::size_t length =
+        static_cast<std::size_t>(format_quad(prefix, lower) - prefix);
+    length -= octet_table[lower & 0xFF].mLength;
+
+    for (unsigned int low = lower & 0xFF ; count > 0 ; ++low, --count)
+    {
+	std::memcpy(pos, prefix, 16);
+	pos += length;
+	const OctetText& entry = octet_table[low];
+	std::memcpy(pos, entry.mText, 4);
+	pos += entry.mLength;
+	*pos++ = '\n';
+    }
+    return pos;
+}
+
+// Raw 32-bit numbers in host byte order, as for hex_block.
+char* raw_block (char* pos, uint32_t lower, unsigned int count)
+{
+#if defined(__SSE2__)
+    __m128i next = _mm_add_epi32(_mm_set1_epi32(static_cast<int>(lower)),
+                                 _mm_set_epi32(3, 2, 1, 0));
+    const __m128i step = _mm_set1_epi32(4);
+    for ( ; count >= 4 ; count -= 4)
+    {
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(pos), next);
+	next = _mm_add_epi32(next, step);
+	pos += 16;
+	lower += 4;
+    }
+#endif
+    for ( ; count > 0 ; --count)
+    {
+	std::memcpy(pos, &lower, 4);
+	++lower;
+	pos += 4;
+    }
+    return pos;
+}
+
+} // namespace anonymous
+
+
+//////////////////////////////////
+// Implementation of Writer class
+//////////////////////////////////
+
+Writer::Writer(int fd)
+ : mFd(fd), mOst(nullptr), mBuffer(chunk + 64), mUsed(0), mOk(true)
+{
+}
+
+Writer::Writer(std::ostream& ost)
+ : mFd(-1), mOst(&ost), mBuffer(chunk + 64), mUsed(0), mOk(true)
+{
+}
+
+Writer::Writer(std::size_t capacity)
+ : mFd(-1), mOst(nullptr), mBuffer(capacity + 64), mUsed(0), mOk(true)
+{
+}
+
+Writer::~Writer()
+{
+    flush();
+}
+
+void Writer::put (const char* text, std::size_t length)
+{
+    // Large pieces skip the buffer
+    if ((length >= chunk) && ((mFd >= 0) || (mOst != nullptr)))
+    {
+	flush();
+	write_out(text, length);
+	return;
+    }
+    std::memcpy(reserve(length), text, length);
+    mUsed += length;
+}
+
+void Writer::quad (uint32_t address)
+{
+    char* pos = format_quad(reserve(16), address);
+    mUsed = static_cast<std::size_t>(pos - mBuffer.data());
+}
+
+void Writer::decimal (uint32_t val)
+{
+    const OctetText& entry = octet_table[val & 0xFF];
+    std::memcpy(reserve(4), entry.mText, 4);
+    mUsed += entry.mLength;
+}
+
+void Writer::hex8 (uint32_t val)
+{
+    char* pos = reserve(8);
+    for (int digit = 7 ; digit >= 0 ; --digit)
+    {
+	pos[digit] = hex_digits[val & 0xF];
+	val >>= 4;
+    }
+    mUsed += 8;
+}
+
+uint64_t Writer::expand (uint32_t lower, uint32_t upper, ExpandStyle style)
+{
+    uint64_t total = static_cast<uint64_t>(upper) - lower + 1;
+    while (true)
+    {
+	uint32_t last = lower | (block_size - 1);
+	if (last > upper) last = upper;
+	unsigned int count = last - lower + 1;
+
+	char* pos = reserve(count * 16 + 16);
+	char* end;
+	switch (style)
+	{
+	case Ehex:
+	    end = hex_block(pos, lower, count);
+	    break;
+	case Equad:
+	    end = quad_block(pos, lower, count);
+	    break;
+	default:
+	    end = raw_block(pos, lower, count);
+	    break;
+	}
+	advance(static_cast<std::size_t>(end - pos));
+
+	// Avoid numeric overflow
+	if (last == upper) break;
+	lower = last + 1;
+    }
+    return total;
+}
+
+void Writer::flush()
+{
+    if ((mFd < 0) && (mOst == nullptr)) return;
+
+    std::size_t length = mUsed;
+    mUsed = 0;
+    write_out(mBuffer.data(), length);
+}
+
+void Writer::write_out (const char* pos, std::size_t left)
+{
+    if (!mOk) return;
+
+    if (mOst != nullptr)
+    {
+	mOst->write(pos, static_cast<std::streamsize>(left));
+	mOst->flush();
+	mOk = bool(*mOst);
+	return;
+    }
+
+    while (left > 0)
+    {
+	ssize_t count = write(mFd, pos, left);
+	if (count < 0)
+	{
+	    if (errno == EINTR) continue;
+	    mOk = false;
+	    return;
+	}
+	pos += count;
+	left -= static_cast<std::size_t>(count);
+    }
+}
+
+void Writer::make_room (std::size_t length)
+{
+    // Hand over what there is, if anyone is listening. Otherwise grow.
+    if ((mFd >= 0) || (mOst != nullptr)) flush();
+    if (mBuffer.size() - mUsed < length)
+	mBuffer.resize(mUsed + length + mBuffer.size());
+}
+
+
+///////////////////////////////////////////
+// Implementation of stand-alone functions
+///////////////////////////////////////////
+
+char* format_quad (char* pos, uint32_t address)
+{
+    const OctetText* entry = &octet_table[address >> 24];
+    std::memcpy(pos, entry->mText, 4);
+    pos += entry->mLength;
+    *pos++ = '.';
+    entry = &octet_table[(address >> 16) & 0xFF];
+    std::memcpy(pos, entry->mText, 4);
+    pos += entry->mLength;
+    *pos++ = '.';
+    entry = &octet_table[(address >> 8) & 0xFF];
+    std::memcpy(pos, entry->mText, 4);
+    pos += entry->mLength;
+    *pos++ = '.';
+    entry = &octet_table[address & 0xFF];
+    std::memcpy(pos, entry->mText, 4);
+    pos += entry->mLength;
+    return pos;
+}
+
+} // namespace IPAR
@@ -0,0 +1,103 @@
+////////////////////////////////////////////////////////
+// Fast buffered text output, for writing out large
+// lists of IP addresses.
+////////////////////////////////////////////////////////
+
+#ifndef IPAR_WRITER_H_ // {
+#define IPAR_WRITER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace IPAR {
+
+// How Writer::expand writes out single addresses
+enum ExpandStyle {
+    Ehex,           // Eight hex digits per line
+    Equad,          // nn.nn.nn.nn per line
+    Eraw            // 32-bit numbers in host byte order, no separators
+};
+
+// Collects text in a large buffer and hands it over in big pieces: directly
+// to a file descriptor with write(2), to an ostream, or to nobody, in which
+// case the text just stays in memory. Numbers are formatted with lookup
+// tables.
+class Writer
+{
+public:
+
+    // The automatic methods
+    Writer() = delete;
+    ~Writer();
+    Writer(Writer const& other) = delete;
+    Writer& operator=(Writer const& other) = delete;
+    Writer(Writer&& other) = delete;
+    Writer& operator=(Writer&& other) = delete;
+
+    // Output goes to a file descriptor, such as STDOUT_FILENO.
+    Writer(int fd);
+
+    // Output goes to an ostream.
+    Writer(std::ostream& ost);
+
+    // Output stays in memory, see text().
+    explicit Writer(std::size_t capacity);
+
+    // Formatting
+    void put (char c) { reserve(1)[0] = c; ++mUsed; }
+    void put (const char* text, std::size_t length);
+    void quad (uint32_t address);         // nn.nn.nn.nn
+    void decimal (uint32_t val);          // Up to three digits, as in /nn
+    void hex8 (uint32_t val);             // Eight lower case hex digits
+
+    // Every single address from lower to upper. Consecutive addresses are
+    // formatted a block at a time. Returns the number of addresses.
+    uint64_t expand (uint32_t lower, uint32_t upper, ExpandStyle style);
+
+    // Hands over everything collected so far. Does nothing for a Writer that
+    // keeps output in memory.
+    void flush();
+
+    // For a Writer that keeps output in memory: everything so far.
+    const char* text() const { return mBuffer.data(); }
+    std::size_t size() const { return mUsed; }
+
+    // Discards everything collected so far.
+    void clear() { mUsed = 0; }
+
+    // False after an output error. Later output is discarded.
+    bool ok() const { return mOk; }
+
+    // Room for at least "length" more characters. Callers that format text
+    // themselves write at the returned position, then call advance().
+    char* reserve (std::size_t length)
+    {
+	if (mBuffer.size() - mUsed < length) make_room(length);
+	return mBuffer.data() + mUsed;
+    }
+    void advance (std::size_t length) { mUsed += length; }
+
+private:
+
+    void make_room (std::size_t length);
+    void write_out (const char* text, std::size_t length);
+
+    int mFd;
+    std::ostream* mOst;
+    std::vector<char> mBuffer;
+    std::size_t mUsed;
+    bool mOk;
+
+}; // class Writer
+
+// Formats an address as nn.nn.nn.nn. There must be room for 16 characters
+// at pos, even though no more than 15 are used. Returns the end of the text.
+char* format_quad (char* pos, uint32_t address);
+
+} // namespace IPAR
+
+#endif //  } IPAR_WRITER_H_
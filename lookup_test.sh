@@ -0,0 +1,33 @@
+#
+
+# Test looking up the addresses in file1 in the content of file2
+
+if [ $# -ne 2 ]
+then
+    echo "Usage: lookup_test.sh address_file list_file" >&2
+    exit 1
+fi
+
+# IPv4 lines of hex are shorter than IPv6 ones, and the programs give all of
+# IPv4 first. Sort every side the same way before comparing.
+export LC_ALL=C
+
+# The result to test.
+./ipar_lookup "$2" < "$1" > test_result.txt
+
+diff \
+    <(comm -12 \
+        <(./ipar_read -hex < "$1" | sort) \
+        <(./ipar_read -hex < "$2" | sort) \
+    ) \
+    <(./ipar_read -hex < test_result.txt | sort)
+
+# The same, for addresses that are not in the list.
+./ipar_lookup -v "$2" < "$1" > test_result.txt
+
+diff \
+    <(comm -23 \
+        <(./ipar_read -hex < "$1" | sort) \
+        <(./ipar_read -hex < "$2" | sort) \
+    ) \
+    <(./ipar_read -hex < test_result.txt | sort)
@@ -0,0 +1,56 @@
+#
+
+# Run the other test scripts on small inputs that mix IPv4 and IPv6
+
+if [ $# -ne 0 ]
+then
+    echo "Usage: mixed_test.sh" >&2
+    exit 1
+fi
+
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+
+cat > "$dir/main.txt" <<'END'
+10.0.0.1
+192.168.0.1
+10.0.0.0/30
+2001:db8::1
+::5
+2001:db8::10-2001:db8::1f
+::ffff:1.2.3.4
+1.2.3.4-1.2.3.6
+END
+
+cat > "$dir/other.txt" <<'END'
+10.0.0.2
+1.2.3.5
+2001:db8::18/125
+::5
+fe80::1
+END
+
+cat > "$dir/addrs.txt" <<'END'
+10.0.0.3
+10.0.0.9
+2001:db8::1b
+2001:db8::2
+::ffff:1.2.3.4
+1.2.3.4
+END
+
+status=0
+for test in \
+    "read_test.sh $dir/main.txt" \
+    "subtract_test.sh $dir/main.txt $dir/other.txt" \
+    "intersect_test.sh $dir/main.txt $dir/other.txt" \
+    "lookup_test.sh $dir/addrs.txt $dir/main.txt"
+do
+    if ! bash $test > /dev/null 2>&1
+    then
+	echo "FAILED: $test" >&2
+	status=1
+    fi
+done
+rm -f test_result.txt
+exit $status